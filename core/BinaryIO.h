@@ -0,0 +1,193 @@
+#ifndef BINARYIO_H
+#define BINARYIO_H
+
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+/**
+ * Writes trivially copyable values, arrays and strings in native byte order.
+ * Arrays and strings are prefixed with their length as a 64 bit integer.
+ */
+class BinaryWriter
+{
+	public:
+	explicit BinaryWriter(std::ostream& os) : os_(os) {}
+
+	template <typename T> void writeValue(const T& value)
+	{
+		static_assert(std::is_trivially_copyable<T>::value,
+		              "Only trivially copyable types can be written");
+		os_.write(reinterpret_cast<const char*>(&value), sizeof(T));
+	}
+
+	template <typename T> void writeArray(const T* values, size_t count)
+	{
+		static_assert(std::is_trivially_copyable<T>::value,
+		              "Only trivially copyable types can be written");
+		writeValue<uint64_t>(count);
+		os_.write(reinterpret_cast<const char*>(values), count * sizeof(T));
+	}
+
+	template <typename T> void writeArray(const std::vector<T>& values)
+	{
+		writeArray(values.data(), values.size());
+	}
+
+	void writeString(const std::string& value)
+	{
+		writeArray(value.data(), value.size());
+	}
+
+	void writeStrings(const std::vector<std::string>& values)
+	{
+		writeValue<uint64_t>(values.size());
+		for(const auto& value : values) {
+			writeString(value);
+		}
+	}
+
+	private:
+	std::ostream& os_;
+};
+
+/**
+ * Reads the output of a BinaryWriter from a block of memory, e.g. a memory
+ * mapped file. Every read is bounds checked, a truncated or corrupted input
+ * results in a std::invalid_argument exception.
+ */
+class BinaryReader
+{
+	public:
+	BinaryReader(const char* data, size_t size)
+	    : data_(data), size_(size), position_(0)
+	{
+	}
+
+	template <typename T> T readValue()
+	{
+		static_assert(std::is_trivially_copyable<T>::value,
+		              "Only trivially copyable types can be read");
+		T value;
+		std::memcpy(&value, advance(sizeof(T)), sizeof(T));
+		return value;
+	}
+
+	template <typename T> std::vector<T> readArray()
+	{
+		static_assert(std::is_trivially_copyable<T>::value,
+		              "Only trivially copyable types can be read");
+		size_t count = readCount(sizeof(T));
+		std::vector<T> values(count);
+		if(count > 0) {
+			std::memcpy(values.data(), advance(count * sizeof(T)),
+			            count * sizeof(T));
+		}
+		return values;
+	}
+
+	std::string readString()
+	{
+		size_t count = readCount(1);
+		return std::string(advance(count), count);
+	}
+
+	std::vector<std::string> readStrings()
+	{
+		size_t count = readCount(1);
+		std::vector<std::string> values;
+		values.reserve(count);
+		for(size_t i = 0; i < count; i++) {
+			values.push_back(readString());
+		}
+		return values;
+	}
+
+	bool atEnd() const { return position_ == size_; }
+
+	private:
+	const char* advance(size_t bytes)
+	{
+		if(bytes > size_ - position_) {
+			throw std::invalid_argument("Unexpected end of binary data");
+		}
+		const char* result = data_ + position_;
+		position_ += bytes;
+		return result;
+	}
+
+	// Reads a length prefix and checks that the elements can still be present
+	size_t readCount(size_t elementSize)
+	{
+		uint64_t count = readValue<uint64_t>();
+		if(count > (size_ - position_) / elementSize) {
+			throw std::invalid_argument("Unexpected end of binary data");
+		}
+		return count;
+	}
+
+	const char* data_;
+	size_t size_;
+	size_t position_;
+};
+
+/**
+ * A file mapped read-only into memory. Several processes mapping the same file
+ * share its pages. Empty files cannot be mapped, they have no data.
+ */
+class MappedFile
+{
+	public:
+	explicit MappedFile(const std::string& filename)
+	{
+		using namespace boost::interprocess;
+		try {
+			mapping_ = file_mapping(filename.c_str(), read_only);
+			std::ifstream input(filename, std::ifstream::binary | std::ifstream::ate);
+			if(input.tellg() > 0) {
+				region_ = mapped_region(mapping_, read_only);
+			}
+		} catch(const interprocess_exception& e) {
+			throw std::invalid_argument("Cannot read '" + filename + "': " +
+			                            e.what());
+		}
+	}
+
+	const char* data() const
+	{
+		return static_cast<const char*>(region_.get_address());
+	}
+
+	size_t size() const { return region_.get_size(); }
+
+	private:
+	boost::interprocess::file_mapping mapping_;
+	boost::interprocess::mapped_region region_;
+};
+
+/**computeChecksum
+ *
+ * @param data, pointer to the first byte
+ * @param size, number of bytes
+ *
+ * @return the 64 bit FNV-1a hash of the given bytes
+ */
+inline uint64_t computeChecksum(const char* data, size_t size)
+{
+	uint64_t hash = 14695981039346656037ull;
+	for(size_t i = 0; i < size; i++) {
+		hash ^= static_cast<unsigned char>(data[i]);
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+
+#endif
@@ -0,0 +1,77 @@
+#include "CompressedObservations.h"
+
+#include <unordered_map>
+
+namespace {
+struct SampleHash
+{
+	size_t operator()(const std::vector<int>& sample) const
+	{
+		size_t hash = 14695981039346656037ull;
+		for(int value : sample) {
+			hash ^= static_cast<size_t>(value + 1);
+			hash *= 1099511628211ull;
+		}
+		return hash;
+	}
+};
+}
+
+CompressedObservations::CompressedObservations(const Matrix<int>& observations)
+{
+	const size_t rowCount = observations.getRowCount();
+	const size_t colCount = observations.getColCount();
+	std::vector<const int*> rows;
+	for(unsigned int row = 0; row < rowCount; row++) {
+		rows.push_back(observations.rowData(row));
+	}
+
+	std::unordered_map<std::vector<int>, unsigned int, SampleHash> distinct;
+	distinct.reserve(colCount);
+	std::vector<unsigned int> firstOccurrence;
+	std::vector<int> sample(rowCount);
+	indices_.reserve(colCount);
+	for(unsigned int col = 0; col < colCount; col++) {
+		for(unsigned int row = 0; row < rowCount; row++) {
+			sample[row] = rows[row][col];
+		}
+		auto result = distinct.emplace(sample, weights_.size());
+		if(result.second) {
+			weights_.push_back(0);
+			firstOccurrence.push_back(col);
+		}
+		weights_[result.first->second]++;
+		indices_.push_back(result.first->second);
+	}
+
+	std::vector<std::string> colNames;
+	const auto& originalColNames = observations.getColNames();
+	for(auto col : firstOccurrence) {
+		colNames.push_back(col < originalColNames.size() ? originalColNames[col]
+		                                                 : std::to_string(col));
+	}
+	samples_ = Matrix<int>(firstOccurrence.size(), rowCount, -1, colNames,
+	                       observations.getRowNames());
+	for(unsigned int row = 0; row < rowCount; row++) {
+		for(unsigned int col = 0; col < firstOccurrence.size(); col++) {
+			samples_.setData(rows[row][firstOccurrence[col]], col, row);
+		}
+	}
+}
+
+Matrix<int>& CompressedObservations::getSamples() { return samples_; }
+
+const Matrix<int>& CompressedObservations::getSamples() const
+{
+	return samples_;
+}
+
+const std::vector<unsigned int>& CompressedObservations::getWeights() const
+{
+	return weights_;
+}
+
+const std::vector<unsigned int>& CompressedObservations::getIndices() const
+{
+	return indices_;
+}
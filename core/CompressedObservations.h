@@ -0,0 +1,61 @@
+#ifndef COMPRESSEDOBSERVATIONS_H
+#define COMPRESSEDOBSERVATIONS_H
+
+#include "Matrix.h"
+
+#include <vector>
+
+/**
+ * Discretised observations in which identical samples, including the
+ * positions of their missing values, are stored once together with their
+ * multiplicity. Counting and EM process every distinct sample once and scale
+ * its contribution by its weight.
+ */
+class CompressedObservations
+{
+	public:
+	/**CompressedObservations
+	 *
+	 * @param observations, the discretised observations, one sample per column
+	 *
+	 * @return CompressedObservations object
+	 *
+	 * The distinct samples keep the order of their first occurrence and the
+	 * column name of that occurrence. The row names are copied.
+	 */
+	explicit CompressedObservations(const Matrix<int>& observations);
+
+	/**getSamples
+	 *
+	 * @return the distinct samples, one per column
+	 */
+	Matrix<int>& getSamples();
+
+	/**getSamples
+	 *
+	 * @return the distinct samples, one per column
+	 */
+	const Matrix<int>& getSamples() const;
+
+	/**getWeights
+	 *
+	 * @return the number of occurrences of every distinct sample
+	 */
+	const std::vector<unsigned int>& getWeights() const;
+
+	/**getIndices
+	 *
+	 * @return for every original sample, the column of its distinct sample
+	 */
+	const std::vector<unsigned int>& getIndices() const;
+
+	private:
+	//The distinct samples
+	Matrix<int> samples_;
+	//Multiplicity of every distinct sample
+	std::vector<unsigned int> weights_;
+	//Distinct sample of every original sample
+	std::vector<unsigned int> indices_;
+};
+
+#endif
@@ -1,11 +1,37 @@
 #include "DataDistribution.h"
 
 DataDistribution::DataDistribution(Network& network, Matrix<int>& observations)
+    : DataDistribution(network, DiscreteObservations(observations))
+{
+}
+
+DataDistribution::DataDistribution(Network& network, Matrix<int>& observations,
+                                   const std::vector<unsigned int>& weights)
+    : DataDistribution(network, DiscreteObservations(observations), weights)
+{
+}
+
+DataDistribution::DataDistribution(Network& network,
+                                   DiscreteObservations observations)
+    : network_(network),
+      observations_(std::move(observations)),
+      observationsMap_(network.getObservationsMap()),
+      observationsMapR_(network.getObservationsMapR())
+{
+}
+
+DataDistribution::DataDistribution(Network& network,
+                                   DiscreteObservations observations,
+                                   const std::vector<unsigned int>& weights)
     : network_(network),
-      observations_(observations),
+      observations_(std::move(observations)),
+      weights_(weights),
       observationsMap_(network.getObservationsMap()),
       observationsMapR_(network.getObservationsMapR())
 {
+	if(weights_.size() != observations_.getColCount()) {
+		throw std::invalid_argument("Number of weights does not match the number of samples");
+	}
 }
 
 int
@@ -31,7 +57,7 @@ void DataDistribution::assignObservationsToNodes()
 		n.setUniqueValues(
 		    observations_.getUniqueRowValues(n.getObservationRow()));
 		n.setUniqueValuesExcludingNA(
-		    observations_.getUniqueRowValues(n.getObservationRow(), -1));
+		    observations_.getUniqueRowValues(n.getObservationRow(), false));
 	}
 
 	for(auto& n : network_.getNodes()) {
@@ -103,52 +129,58 @@ void DataDistribution::assignParentNames(Node& n)
 	}
 }
 
-int DataDistribution::getObservationColIndex(unsigned int sample, const Node& n)
+template <typename Code>
+void DataDistribution::countObservations(Matrix<int>& obsMatrix, Node& n,
+                                         const std::vector<unsigned int>& samples,
+                                         const std::vector<int>& weights)
 {
-	if(n.getNumberOfUniqueValues() != n.getNumberOfUniqueValuesExcludingNA()) {
-		return observations_(sample, n.getObservationRow()) + 1;
-	} else {
-		return observations_(sample, n.getObservationRow());
-	}
-}
+	network_.computeFactor(n);
+	const Code* values = observations_.rowData<Code>(n.getObservationRow());
+	const uint64_t* missing = observations_.missingData(n.getObservationRow());
+	// NA occupies the first column if the node has missing values
+	const int offset =
+	    n.getNumberOfUniqueValues() != n.getNumberOfUniqueValuesExcludingNA() ? 1 : 0;
 
-int DataDistribution::getObservationRowIndex(unsigned int sample, Node& n)
-{
-	if(n.getParents().empty()) {
-		return 0;
+	std::vector<const Code*> parentValues;
+	std::vector<const uint64_t*> parentMissing;
+	for(auto id : n.getParents()) {
+		unsigned int row = network_.getNode(id).getObservationRow();
+		parentValues.push_back(observations_.rowData<Code>(row));
+		parentMissing.push_back(observations_.missingData(row));
 	}
-	int index = 0;
-	const auto& parentID = n.getParents();
-	for(unsigned int i = 0; i< parentID.size(); i++) {
-		Node& pn = network_.getNode(parentID[i]);
-		int value = observations_(sample, pn.getObservationRow());
-		if(value == -1) {
-			return -1;
-		}
-		index += n.getFactor(i) * value;
-	}
-	return index;
-}
 
-void DataDistribution::countObservations(Matrix<int>& obsMatrix, Node& n)
-{
-	for(unsigned int sample = 0; sample < observations_.getColCount();
-	    sample++) {
+	for(size_t i = 0; i < samples.size(); i++) {
+		unsigned int sample = samples[i];
+		int column = DiscreteObservations::isSet(missing, sample)
+		                 ? DiscreteObservations::NA + offset
+		                 : values[sample] + offset;
 
-		int column = getObservationColIndex(sample, n);
-		
-		network_.computeFactor(n);
-	
-		int row = getObservationRowIndex(sample, n);
+		int row = 0;
+		bool complete = true;
+		for(unsigned int p = 0; p < parentValues.size(); p++) {
+			if(DiscreteObservations::isSet(parentMissing[p], sample)) {
+				complete = false;
+				break;
+			}
+			row += n.getFactor(p) * parentValues[p][sample];
+		}
 
-		if(row != -1) {
-			obsMatrix(column, row)++;
+		if(complete) {
+			obsMatrix(column, row) += weights[i];
 		}
 	}
 }
 
 void DataDistribution::distributeObservations()
 {
+	std::vector<unsigned int> samples(observations_.getColCount());
+	std::vector<int> weights(observations_.getColCount(), 1);
+	for(unsigned int sample = 0; sample < samples.size(); sample++) {
+		samples[sample] = sample;
+		if(!weights_.empty()) {
+			weights[sample] = weights_[sample];
+		}
+	}
 	// Generating matrices
 	for(auto& n : network_.getNodes()) {
 		// Generating suitable matrices
@@ -157,7 +189,11 @@ void DataDistribution::distributeObservations()
 		Matrix<float> probMatrix =
 		    Matrix<float>(n.getValueNamesProb(), n.getParentValueNames(), 0.0f);
 		// Count observations
-		countObservations(obsMatrix, n);
+		if(observations_.getCodeSize() == sizeof(uint8_t)) {
+			countObservations<uint8_t>(obsMatrix, n, samples, weights);
+		} else {
+			countObservations<uint16_t>(obsMatrix, n, samples, weights);
+		}
 		// Store matrices
 		n.setObservations(obsMatrix);
 		n.setObservationBackup(obsMatrix);
@@ -167,3 +203,33 @@ void DataDistribution::distributeObservations()
 		n.createBackup();
 	}
 }
+
+void DataDistribution::updateObservations(const std::vector<int>& changes)
+{
+	if(changes.size() != observations_.getColCount()) {
+		throw std::invalid_argument("Number of weight changes does not match the number of samples");
+	}
+	// Only the changed samples are visited
+	std::vector<unsigned int> samples;
+	std::vector<int> weights;
+	for(unsigned int sample = 0; sample < changes.size(); sample++) {
+		if(changes[sample] != 0) {
+			samples.push_back(sample);
+			weights.push_back(changes[sample]);
+		}
+	}
+	if(samples.empty()) {
+		return;
+	}
+	for(auto& n : network_.getNodes()) {
+		Matrix<int> obsMatrix = n.getObservationMatrix();
+		if(observations_.getCodeSize() == sizeof(uint8_t)) {
+			countObservations<uint8_t>(obsMatrix, n, samples, weights);
+		} else {
+			countObservations<uint16_t>(obsMatrix, n, samples, weights);
+		}
+		n.setObservations(obsMatrix);
+		n.setObservationBackup(obsMatrix);
+		n.createBackup();
+	}
+}
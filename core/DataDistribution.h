@@ -3,6 +3,7 @@
 
 #include"Network.h"
 #include"Combinations.h"
+#include"DiscreteObservations.h"
 #include<map>
 
 class DataDistribution{
@@ -17,6 +18,40 @@ class DataDistribution{
 	 */
 	DataDistribution(Network& network, Matrix<int>& observations);
 
+	/**DataDistribution
+	 *
+	 * @param network, A reference to a network
+	 * @param observations, A reference to a Matrix of typ int containing distinct discretised samples
+	 * @param weights, The number of occurrences of every sample, see CompressedObservations
+	 *
+	 * @return DataDistribution object
+	 *
+	 */
+	DataDistribution(Network& network, Matrix<int>& observations,
+	                 const std::vector<unsigned int>& weights);
+
+	/**DataDistribution
+	 *
+	 * @param network, A reference to a network
+	 * @param observations, The discretised observations in compact storage
+	 *
+	 * @return DataDistribution object
+	 *
+	 */
+	DataDistribution(Network& network, DiscreteObservations observations);
+
+	/**DataDistribution
+	 *
+	 * @param network, A reference to a network
+	 * @param observations, Distinct discretised samples in compact storage
+	 * @param weights, The number of occurrences of every sample, see CompressedObservations
+	 *
+	 * @return DataDistribution object
+	 *
+	 */
+	DataDistribution(Network& network, DiscreteObservations observations,
+	                 const std::vector<unsigned int>& weights);
+
 	DataDistribution& operator=(const DataDistribution&) = delete;
 	DataDistribution& operator=(DataDistribution&&) = delete;
 
@@ -35,6 +70,17 @@ class DataDistribution{
 	 * CPT.
 	 */
 	void distributeObservations();
+
+	/**updateObservations
+	 *
+	 * @param changes, The change of the weight of every sample
+	 *
+	 * Adds the observations of the samples with a positive change to the counts
+	 * of the nodes and subtracts those of the samples with a negative change,
+	 * instead of counting all samples again. The counts have to stem from
+	 * distributeObservations on the same samples and network structure.
+	 */
+	void updateObservations(const std::vector<int>& changes);
 	private:
 
 	/**computeParentCombinations
@@ -56,27 +102,6 @@ class DataDistribution{
 	 */
 	void assignValueNames(Node& n);
 
-	/**getObservationColIndex
-	 *
-	 * @param sample, value of interest
-	 * @param n, A reference to a node
-	 *
-	 * @return The Index of the given value in the value list of the node
-	 *
-	 */
-	int getObservationColIndex(unsigned int sample, const Node& n);
-
-	/**getObservationRowIndex
-	 *
-	 * @param sample, 
-	 * @param n, A reference to a node
-	 * @param obsMatrix, A const reference to th observation matrix
-	 *
-	 * @return The index of the given value in the parent value list of the node
- 	 *
-	 */
-	int getObservationRowIndex(unsigned int sample, Node& n);
-
 	/**assignParentNames
 	 *
 	 * @param n, A reference to the node in question
@@ -89,16 +114,24 @@ class DataDistribution{
 
 	/**countObservations
 	 *
-	 * @param obsMatrix, A reference to a Matrix of typ int, containing the discretised observations
+	 * @param obsMatrix, A reference to the matrix receiving the counts of the node
 	 * @param n, A reference to a Node
+	 * @param samples, The samples to count
+	 * @param weights, The weight of every sample in samples
 	 *
- 	 * This fills the observation matrix for a node, by iterating over the discretised samples
+ 	 * This fills the observation matrix for a node, by iterating over the discretised samples.
+	 * Code is the type of the stored observations, see DiscreteObservations::getCodeSize.
 	 */
-	void countObservations(Matrix<int>& obsMatrix, Node& n);
+	template <typename Code>
+	void countObservations(Matrix<int>& obsMatrix, Node& n,
+	                       const std::vector<unsigned int>& samples,
+	                       const std::vector<int>& weights);
 	// A reference to the network
 	Network& network_;	
-	// A reference to the observation matrix
-	Matrix<int>& observations_;
+	// The discretised observations
+	DiscreteObservations observations_;
+	// Multiplicity of every sample, empty if every sample occurs once
+	std::vector<unsigned int> weights_;
 	// A map from the original value names to the internal integer representation
 	std::unordered_map<std::string,int>& observationsMap_;
 	// A map from the internal integer representation (using the observationRow entry in the Node class) to the original string representation
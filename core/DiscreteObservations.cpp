@@ -0,0 +1,202 @@
+#include "DiscreteObservations.h"
+
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+
+const int DiscreteObservations::NA = -1;
+const size_t DiscreteObservations::SAMPLE_BLOCK_SIZE = 1024;
+
+DiscreteObservations::DiscreteObservations()
+    : rowCount_(0), colCount_(0), wordCount_(0), incompleteCount_(0)
+{
+}
+
+DiscreteObservations::DiscreteObservations(const Matrix<int>& observations)
+    : rowNames_(observations.getRowNames()),
+      colNames_(observations.getColNames()),
+      rowCount_(observations.getRowCount()),
+      colCount_(observations.getColCount()),
+      wordCount_((observations.getColCount() + 63) / 64),
+      incompleteCount_(0)
+{
+	int maximum = 0;
+	for(unsigned int row = 0; row < rowCount_; row++) {
+		const int* values = observations.rowData(row);
+		for(size_t col = 0; col < colCount_; col++) {
+			if(values[col] < NA) {
+				throw std::invalid_argument(
+				    "Discretised observations must not be smaller than -1");
+			}
+			maximum = std::max(maximum, values[col]);
+		}
+	}
+	if(maximum > std::numeric_limits<uint16_t>::max()) {
+		throw std::invalid_argument(
+		    "Discretised observations must not exceed 65535");
+	}
+
+	const bool narrow = maximum <= std::numeric_limits<uint8_t>::max();
+	if(narrow) {
+		narrowCodes_.resize(rowCount_ * colCount_);
+	} else {
+		wideCodes_.resize(rowCount_ * colCount_);
+	}
+	missing_.assign(rowCount_ * wordCount_, 0);
+	for(unsigned int row = 0; row < rowCount_; row++) {
+		const int* values = observations.rowData(row);
+		uint64_t* missing = missing_.data() + row * wordCount_;
+		for(size_t col = 0; col < colCount_; col++) {
+			int value = values[col];
+			if(value == NA) {
+				missing[col / 64] |= uint64_t(1) << (col % 64);
+				value = 0;
+			}
+			if(narrow) {
+				narrowCodes_[row * colCount_ + col] = static_cast<uint8_t>(value);
+			} else {
+				wideCodes_[row * colCount_ + col] = static_cast<uint16_t>(value);
+			}
+		}
+	}
+
+	missingCounts_.assign(rowCount_, 0);
+	incompleteSamples_.assign(wordCount_, 0);
+	for(unsigned int row = 0; row < rowCount_; row++) {
+		const uint64_t* missing = missingData(row);
+		for(size_t word = 0; word < wordCount_; word++) {
+			missingCounts_[row] += popcount(missing[word]);
+			incompleteSamples_[word] |= missing[word];
+		}
+	}
+	for(auto word : incompleteSamples_) {
+		incompleteCount_ += popcount(word);
+	}
+}
+
+size_t DiscreteObservations::getRowCount() const { return rowCount_; }
+
+size_t DiscreteObservations::getColCount() const { return colCount_; }
+
+const std::vector<std::string>& DiscreteObservations::getRowNames() const
+{
+	return rowNames_;
+}
+
+const std::vector<std::string>& DiscreteObservations::getColNames() const
+{
+	return colNames_;
+}
+
+int DiscreteObservations::findRow(const std::string& name) const
+{
+	auto it = std::find(rowNames_.begin(), rowNames_.end(), name);
+	return it == rowNames_.end() ? -1 : it - rowNames_.begin();
+}
+
+unsigned int DiscreteObservations::getCodeSize() const
+{
+	return wideCodes_.empty() ? sizeof(uint8_t) : sizeof(uint16_t);
+}
+
+int DiscreteObservations::operator()(unsigned int col, unsigned int row) const
+{
+	if(isMissing(col, row)) {
+		return NA;
+	}
+	return wideCodes_.empty() ? narrowCodes_[row * colCount_ + col]
+	                          : wideCodes_[row * colCount_ + col];
+}
+
+bool DiscreteObservations::isMissing(unsigned int col, unsigned int row) const
+{
+	return isSet(missingData(row), col);
+}
+
+bool DiscreteObservations::containsMissing() const
+{
+	return incompleteCount_ > 0;
+}
+
+size_t DiscreteObservations::countMissing(unsigned int row) const
+{
+	return missingCounts_[row];
+}
+
+size_t DiscreteObservations::countIncompleteSamples() const
+{
+	return incompleteCount_;
+}
+
+const uint64_t* DiscreteObservations::getIncompleteSamples() const
+{
+	return incompleteSamples_.data();
+}
+
+unsigned int DiscreteObservations::popcount(uint64_t word)
+{
+#if defined(__GNUC__) || defined(__clang__)
+	return __builtin_popcountll(word);
+#else
+	word = word - ((word >> 1) & 0x5555555555555555ull);
+	word = (word & 0x3333333333333333ull) + ((word >> 2) & 0x3333333333333333ull);
+	word = (word + (word >> 4)) & 0x0f0f0f0f0f0f0f0full;
+	return (word * 0x0101010101010101ull) >> 56;
+#endif
+}
+
+std::vector<int>
+DiscreteObservations::getUniqueRowValues(unsigned int row,
+                                         bool includeMissing) const
+{
+	std::vector<bool> present(getCodeSize() == sizeof(uint8_t) ? 256 : 65536,
+	                          false);
+	const bool missing = countMissing(row) > 0;
+	for(unsigned int col = 0; col < colCount_; col++) {
+		if(!missing || !isMissing(col, row)) {
+			present[(*this)(col, row)] = true;
+		}
+	}
+	std::vector<int> values;
+	if(missing && includeMissing) {
+		values.push_back(NA);
+	}
+	for(size_t value = 0; value < present.size(); value++) {
+		if(present[value]) {
+			values.push_back(value);
+		}
+	}
+	return values;
+}
+
+template <>
+const uint8_t* DiscreteObservations::rowData<uint8_t>(unsigned int row) const
+{
+	if(getCodeSize() != sizeof(uint8_t)) {
+		throw std::invalid_argument("The observations are not stored as uint8_t");
+	}
+	return narrowCodes_.data() + row * colCount_;
+}
+
+template <>
+const uint16_t* DiscreteObservations::rowData<uint16_t>(unsigned int row) const
+{
+	if(getCodeSize() != sizeof(uint16_t)) {
+		throw std::invalid_argument("The observations are not stored as uint16_t");
+	}
+	return wideCodes_.data() + row * colCount_;
+}
+
+const uint64_t* DiscreteObservations::missingData(unsigned int row) const
+{
+	return missing_.data() + row * wordCount_;
+}
+
+size_t DiscreteObservations::getWordCount() const { return wordCount_; }
+
+size_t DiscreteObservations::getMemoryUsage() const
+{
+	return narrowCodes_.size() * sizeof(uint8_t) +
+	       wideCodes_.size() * sizeof(uint16_t) +
+	       (missing_.size() + incompleteSamples_.size()) * sizeof(uint64_t);
+}
@@ -0,0 +1,267 @@
+#ifndef DISCRETEOBSERVATIONS_H
+#define DISCRETEOBSERVATIONS_H
+
+#include "Matrix.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * Discretised observations, one feature per row and one sample per column,
+ * stored as compact codes instead of ints.
+ *
+ * All values are stored as uint8_t if every value fits into it, as uint16_t
+ * otherwise. Missing values are not encoded in the codes but in a separate
+ * bitmap per row, where bit col % 64 of word col / 64 is set if the value of
+ * sample col is missing. The code of a missing value is 0. A bitmap of the
+ * samples with any missing value and the number of missing values of every
+ * row are kept as well, so missingness checks never scan the values.
+ *
+ * Consumers read the codes of a row with rowData<Code>() after checking the
+ * code size, so their inner loops are instantiated for the stored width.
+ * Consumers scanning sample by sample use transpose() to obtain a
+ * sample-major copy of a block of samples instead.
+ */
+class DiscreteObservations
+{
+	public:
+	//Value of a missing observation, as used by Matrix<int> observations
+	static const int NA;
+	//Number of samples per block scanned by per-sample consumers, a multiple
+	//of 64 such that blocks start at a bitmap word
+	static const size_t SAMPLE_BLOCK_SIZE;
+
+	/**DiscreteObservations
+	 *
+	 * @return DiscreteObservations object without any samples
+	 */
+	DiscreteObservations();
+
+	/**DiscreteObservations
+	 *
+	 * @param observations, the discretised observations, -1 marks missing
+	 * values
+	 *
+	 * @return DiscreteObservations object holding the same data. Values below
+	 * -1 or above 65535 are rejected with a std::invalid_argument exception.
+	 */
+	explicit DiscreteObservations(const Matrix<int>& observations);
+
+	/**getRowCount
+	 *
+	 * @return the number of features
+	 */
+	size_t getRowCount() const;
+
+	/**getColCount
+	 *
+	 * @return the number of samples
+	 */
+	size_t getColCount() const;
+
+	/**getRowNames
+	 *
+	 * @return the names of the features
+	 */
+	const std::vector<std::string>& getRowNames() const;
+
+	/**getColNames
+	 *
+	 * @return the names of the samples
+	 */
+	const std::vector<std::string>& getColNames() const;
+
+	/**findRow
+	 *
+	 * @param name, name of a feature
+	 *
+	 * @return the index of the feature, -1 if there is none
+	 */
+	int findRow(const std::string& name) const;
+
+	/**getCodeSize
+	 *
+	 * @return the number of bytes of a stored code, 1 or 2
+	 */
+	unsigned int getCodeSize() const;
+
+	/**operator()
+	 *
+	 * @param col, index of the sample
+	 * @param row, index of the feature
+	 *
+	 * @return the value of the cell, NA if it is missing
+	 */
+	int operator()(unsigned int col, unsigned int row) const;
+
+	/**isMissing
+	 *
+	 * @param col, index of the sample
+	 * @param row, index of the feature
+	 *
+	 * @return true, if the value is missing
+	 */
+	bool isMissing(unsigned int col, unsigned int row) const;
+
+	/**containsMissing
+	 *
+	 * @return true, if any value is missing
+	 */
+	bool containsMissing() const;
+
+	/**countMissing
+	 *
+	 * @param row, index of the feature
+	 *
+	 * @return the number of missing values of the feature
+	 */
+	size_t countMissing(unsigned int row) const;
+
+	/**countIncompleteSamples
+	 *
+	 * @return the number of samples with at least one missing value
+	 */
+	size_t countIncompleteSamples() const;
+
+	/**getIncompleteSamples
+	 *
+	 * @return a bitmap with getWordCount() words, in which the bit of every
+	 * sample with at least one missing value is set
+	 */
+	const uint64_t* getIncompleteSamples() const;
+
+	/**getUniqueRowValues
+	 *
+	 * @param row, index of the feature
+	 * @param includeMissing, true if NA should be reported for missing values
+	 *
+	 * @return the sorted distinct values of the feature
+	 */
+	std::vector<int> getUniqueRowValues(unsigned int row,
+	                                    bool includeMissing = true) const;
+
+	/**rowData
+	 *
+	 * @param row, index of the feature
+	 *
+	 * @return the codes of the feature. Code has to match getCodeSize(),
+	 * otherwise a std::invalid_argument exception is thrown.
+	 */
+	template <typename Code> const Code* rowData(unsigned int row) const;
+
+	/**missingData
+	 *
+	 * @param row, index of the feature
+	 *
+	 * @return the missingness bitmap of the feature, getWordCount() words
+	 */
+	const uint64_t* missingData(unsigned int row) const;
+
+	/**isSet
+	 *
+	 * @param bitmap, a missingness bitmap, see missingData
+	 * @param col, index of the sample
+	 *
+	 * @return true, if the bit of the sample is set
+	 */
+	static bool isSet(const uint64_t* bitmap, size_t col)
+	{
+		return (bitmap[col / 64] >> (col % 64)) & 1;
+	}
+
+	/**transpose
+	 *
+	 * @param rows, the features to copy, in the order they should be stored
+	 * @param sampleIndices, the samples to copy are sampleIndices[begin, end),
+	 * the samples [begin, end) if it is a nullptr
+	 * @param begin, first position of the range
+	 * @param end, one past the last position of the range
+	 * @param codes, receives the codes of the i-th feature of the s-th sample
+	 * of the range at codes[s * rows.size() + i], 0 for missing values
+	 * @param incomplete, receives a bitmap in which bit s is set if any
+	 * selected feature of the s-th sample of the range is missing
+	 *
+	 * Copies a block of samples into sample-major order, so per-sample scans
+	 * read every sample contiguously instead of one element per row.
+	 */
+	template <typename Code>
+	void transpose(const std::vector<unsigned int>& rows,
+	               const unsigned int* sampleIndices, size_t begin, size_t end,
+	               std::vector<Code>& codes,
+	               std::vector<uint64_t>& incomplete) const;
+
+	/**popcount
+	 *
+	 * @param word, a bitmap word
+	 *
+	 * @return the number of set bits
+	 */
+	static unsigned int popcount(uint64_t word);
+
+	/**getWordCount
+	 *
+	 * @return the number of bitmap words of every row
+	 */
+	size_t getWordCount() const;
+
+	/**getMemoryUsage
+	 *
+	 * @return the number of bytes occupied by codes and bitmaps
+	 */
+	size_t getMemoryUsage() const;
+
+	private:
+	std::vector<std::string> rowNames_;
+	std::vector<std::string> colNames_;
+	size_t rowCount_;
+	size_t colCount_;
+	size_t wordCount_;
+	//Codes of all rows one after another, only one of them is used
+	std::vector<uint8_t> narrowCodes_;
+	std::vector<uint16_t> wideCodes_;
+	//Missingness bitmaps of all rows one after another
+	std::vector<uint64_t> missing_;
+	//Number of missing values of every row
+	std::vector<size_t> missingCounts_;
+	//Samples with at least one missing value
+	std::vector<uint64_t> incompleteSamples_;
+	size_t incompleteCount_;
+};
+
+template <>
+const uint8_t* DiscreteObservations::rowData<uint8_t>(unsigned int row) const;
+
+template <>
+const uint16_t* DiscreteObservations::rowData<uint16_t>(unsigned int row) const;
+
+template <typename Code>
+void DiscreteObservations::transpose(const std::vector<unsigned int>& rows,
+                                     const unsigned int* sampleIndices,
+                                     size_t begin, size_t end,
+                                     std::vector<Code>& codes,
+                                     std::vector<uint64_t>& incomplete) const
+{
+	const size_t count = end - begin;
+	const size_t stride = rows.size();
+	codes.resize(count * stride);
+	incomplete.assign((count + 63) / 64, 0);
+	// Tiles of 64 samples keep the written samples in cache while the rows
+	// are read one after another
+	for(size_t tile = 0; tile < count; tile += 64) {
+		const size_t tileEnd = std::min(count, tile + 64);
+		for(size_t i = 0; i < stride; i++) {
+			const Code* values = rowData<Code>(rows[i]);
+			const uint64_t* missing = missingData(rows[i]);
+			for(size_t s = tile; s < tileEnd; s++) {
+				size_t sample = sampleIndices == nullptr ? begin + s
+				                                         : sampleIndices[begin + s];
+				codes[s * stride + i] = values[sample];
+				incomplete[s / 64] |= uint64_t(isSet(missing, sample)) << (s % 64);
+			}
+		}
+	}
+}
+
+#endif
@@ -0,0 +1,354 @@
+#include "DiscretisationCache.h"
+
+#include "BinaryIO.h"
+#include "DiscreteObservations.h"
+
+#include <boost/property_tree/json_parser.hpp>
+
+#include <algorithm>
+#include <cstdio>
+#include <iomanip>
+#include <memory>
+#include <sstream>
+
+namespace {
+const char CACHE_MAGIC[8] = {'C', 'T', 'D', 'I', 'S', 'C', 'R', 'T'};
+const uint32_t CACHE_VERSION = 2;
+// Written in native byte order to detect caches of a different endianness
+const uint32_t CACHE_BYTE_ORDER = 0x01020304;
+
+// Everything a background write needs, copied while the caller waits
+struct CacheContent
+{
+	DiscreteObservations observations;
+	std::vector<Discretiser::FeatureNames> featureNames;
+};
+
+template <typename Code>
+void writeCodes(BinaryWriter& writer, const DiscreteObservations& observations)
+{
+	for(unsigned int row = 0; row < observations.getRowCount(); row++) {
+		writer.writeArray(observations.rowData<Code>(row),
+		                  observations.getColCount());
+		writer.writeArray(observations.missingData(row),
+		                  observations.getWordCount());
+	}
+}
+
+template <typename Code>
+void readCodes(BinaryReader& reader, Matrix<int>& obsMatrix)
+{
+	const size_t words = (obsMatrix.getColCount() + 63) / 64;
+	for(unsigned int row = 0; row < obsMatrix.getRowCount(); row++) {
+		std::vector<Code> codes = reader.readArray<Code>();
+		std::vector<uint64_t> missing = reader.readArray<uint64_t>();
+		if(codes.size() != obsMatrix.getColCount() || missing.size() != words) {
+			throw std::invalid_argument("Invalid dimensions in discretisation cache");
+		}
+		for(unsigned int col = 0; col < codes.size(); col++) {
+			obsMatrix(col, row) = DiscreteObservations::isSet(missing.data(), col)
+			                          ? DiscreteObservations::NA
+			                          : codes[col];
+		}
+	}
+}
+}
+
+DiscretisationCache::DiscretisationCache(const std::string& directory)
+    : directory_(directory)
+{
+}
+
+DiscretisationCache::~DiscretisationCache()
+{
+	try {
+		wait();
+	} catch(const std::invalid_argument&) {
+		// A cache that could not be written is simply missing next time
+	}
+}
+
+uint64_t
+DiscretisationCache::computeSettingsHash(const DiscretisationSettings& settings)
+{
+	// Every feature is serialised on its own and the features are sorted by
+	// name, so the hash does not depend on the order of the json document
+	std::vector<std::pair<std::string, std::string>> features;
+	for(const auto& feature : settings.getPropertyTree()) {
+		std::ostringstream json;
+		boost::property_tree::write_json(json, feature.second, false);
+		features.emplace_back(feature.first, json.str());
+	}
+	std::sort(features.begin(), features.end());
+	std::string text;
+	for(const auto& feature : features) {
+		text += feature.first;
+		text += '\0';
+		text += feature.second;
+		text += '\0';
+	}
+	return computeChecksum(text.data(), text.size());
+}
+
+bool DiscretisationCache::computeContentHash(const std::string& datafile,
+                                             uint64_t& hash, uint64_t& size)
+{
+	std::ifstream exists(datafile);
+	if(!exists.good()) {
+		return false;
+	}
+	try {
+		MappedFile file(datafile);
+		hash = computeChecksum(file.data(), file.size());
+		size = file.size();
+	} catch(const std::invalid_argument&) {
+		return false;
+	}
+	return true;
+}
+
+DiscretisationCache::Key
+DiscretisationCache::createKey(const DiscretisationSettings& settings,
+                               const std::vector<unsigned int>& deletedSamples)
+{
+	Key key;
+	key.fileSize = 0;
+	key.contentHash = 0;
+	key.settingsHash = computeSettingsHash(settings);
+	// Deleting a sample twice deletes it once
+	key.deletedSamples = deletedSamples;
+	std::sort(key.deletedSamples.begin(), key.deletedSamples.end());
+	key.deletedSamples.erase(
+	    std::unique(key.deletedSamples.begin(), key.deletedSamples.end()),
+	    key.deletedSamples.end());
+	return key;
+}
+
+std::string DiscretisationCache::getCacheFile(const Key& key) const
+{
+	const uint64_t selection = computeChecksum(
+	    reinterpret_cast<const char*>(key.deletedSamples.data()),
+	    key.deletedSamples.size() * sizeof(unsigned int));
+	std::ostringstream name;
+	name << directory_ << "/" << std::hex << std::setfill('0') << std::setw(16)
+	     << key.contentHash << "-" << std::setw(16) << key.settingsHash << "-"
+	     << std::setw(16) << selection << ".cache";
+	return name.str();
+}
+
+std::string DiscretisationCache::getCacheFile(
+    const std::string& datafile, const DiscretisationSettings& settings,
+    const std::vector<unsigned int>& deletedSamples) const
+{
+	Key key = createKey(settings, deletedSamples);
+	if(!computeContentHash(datafile, key.contentHash, key.fileSize)) {
+		return "";
+	}
+	return getCacheFile(key);
+}
+
+bool DiscretisationCache::load(const std::string& datafile,
+                               const DiscretisationSettings& settings,
+                               const std::vector<unsigned int>& deletedSamples,
+                               Matrix<int>& obsMatrix, Network& network)
+{
+	uint64_t contentHash = 0;
+	uint64_t fileSize = 0;
+	if(!computeContentHash(datafile, contentHash, fileSize)) {
+		return false;
+	}
+	return load(contentHash, fileSize, settings, deletedSamples, obsMatrix,
+	            network);
+}
+
+bool DiscretisationCache::load(uint64_t contentHash, uint64_t fileSize,
+                               const DiscretisationSettings& settings,
+                               const std::vector<unsigned int>& deletedSamples,
+                               Matrix<int>& obsMatrix, Network& network)
+{
+	Key key = createKey(settings, deletedSamples);
+	key.contentHash = contentHash;
+	key.fileSize = fileSize;
+	// A cache that is still being written would be read incompletely
+	try {
+		wait();
+	} catch(const std::invalid_argument&) {
+		return false;
+	}
+	return read(key, obsMatrix, network);
+}
+
+bool DiscretisationCache::read(const Key& key, Matrix<int>& obsMatrix,
+                               Network& network) const
+{
+	const std::string filename = getCacheFile(key);
+	std::ifstream exists(filename);
+	if(!exists.good()) {
+		return false;
+	}
+	try {
+		MappedFile file(filename);
+		const size_t offset = sizeof(CACHE_MAGIC) + 2 * sizeof(uint32_t) +
+		                      2 * sizeof(uint64_t);
+		if(file.size() < offset ||
+		   std::memcmp(file.data(), CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0) {
+			return false;
+		}
+		BinaryReader header(file.data() + sizeof(CACHE_MAGIC),
+		                    offset - sizeof(CACHE_MAGIC));
+		if(header.readValue<uint32_t>() != CACHE_VERSION ||
+		   header.readValue<uint32_t>() != CACHE_BYTE_ORDER) {
+			return false;
+		}
+		uint64_t size = header.readValue<uint64_t>();
+		uint64_t checksum = header.readValue<uint64_t>();
+		if(size != file.size() - offset ||
+		   checksum != computeChecksum(file.data() + offset, size)) {
+			return false;
+		}
+
+		BinaryReader reader(file.data() + offset, size);
+		if(reader.readValue<uint64_t>() != key.fileSize ||
+		   reader.readValue<uint64_t>() != key.contentHash ||
+		   reader.readValue<uint64_t>() != key.settingsHash ||
+		   reader.readArray<unsigned int>() != key.deletedSamples) {
+			return false;
+		}
+
+		const uint64_t rows = reader.readValue<uint64_t>();
+		const uint64_t cols = reader.readValue<uint64_t>();
+		Matrix<int> observations(cols, rows, -1);
+		observations.setRowNames(reader.readStrings());
+		observations.setColNames(reader.readStrings());
+		if(reader.readValue<uint32_t>() == sizeof(uint8_t)) {
+			readCodes<uint8_t>(reader, observations);
+		} else {
+			readCodes<uint16_t>(reader, observations);
+		}
+
+		std::vector<Discretiser::FeatureNames> featureNames(rows);
+		for(auto& names : featureNames) {
+			uint64_t count = reader.readValue<uint64_t>();
+			for(uint64_t i = 0; i < count; i++) {
+				std::string name = reader.readString();
+				names.map[name] = reader.readValue<int32_t>();
+			}
+			count = reader.readValue<uint64_t>();
+			for(uint64_t i = 0; i < count; i++) {
+				int value = reader.readValue<int32_t>();
+				int row = reader.readValue<int32_t>();
+				names.revMap[std::make_pair(value, row)] = reader.readString();
+			}
+		}
+
+		// Nothing is changed before the whole cache has been read
+		obsMatrix = std::move(observations);
+		auto& map = network.getObservationsMap();
+		auto& revMap = network.getObservationsMapR();
+		for(const auto& names : featureNames) {
+			for(const auto& entry : names.map) {
+				map[entry.first] = entry.second;
+			}
+			for(const auto& entry : names.revMap) {
+				revMap[entry.first] = entry.second;
+			}
+		}
+	} catch(const std::invalid_argument&) {
+		return false;
+	}
+	return true;
+}
+
+void DiscretisationCache::store(const std::string& datafile,
+                                uint64_t contentHash, uint64_t fileSize,
+                                const DiscretisationSettings& settings,
+                                const std::vector<unsigned int>& deletedSamples,
+                                const Matrix<int>& obsMatrix,
+                                const Discretiser& discretiser)
+{
+	try {
+		wait();
+	} catch(const std::invalid_argument&) {
+		// The failed write is replaced by this one
+	}
+	Key key = createKey(settings, deletedSamples);
+	key.contentHash = contentHash;
+	key.fileSize = fileSize;
+	auto content = std::make_shared<CacheContent>();
+	try {
+		content->observations = DiscreteObservations(obsMatrix);
+	} catch(const std::invalid_argument&) {
+		// Values without a compact code are not cached
+		return;
+	}
+	for(unsigned int row = 0; row < obsMatrix.getRowCount(); row++) {
+		content->featureNames.push_back(discretiser.getFeatureNames(row));
+	}
+
+	pending_ = std::async(std::launch::async, [this, datafile, key, content]() {
+		uint64_t contentHash = 0;
+		uint64_t fileSize = 0;
+		if(!computeContentHash(datafile, contentHash, fileSize) ||
+		   contentHash != key.contentHash || fileSize != key.fileSize) {
+			return;
+		}
+		const std::string filename = getCacheFile(key);
+		const DiscreteObservations& observations = content->observations;
+		std::ostringstream payload;
+		BinaryWriter writer(payload);
+		writer.writeValue(key.fileSize);
+		writer.writeValue(key.contentHash);
+		writer.writeValue(key.settingsHash);
+		writer.writeArray(key.deletedSamples);
+
+		writer.writeValue<uint64_t>(observations.getRowCount());
+		writer.writeValue<uint64_t>(observations.getColCount());
+		writer.writeStrings(observations.getRowNames());
+		writer.writeStrings(observations.getColNames());
+		writer.writeValue<uint32_t>(observations.getCodeSize());
+		if(observations.getCodeSize() == sizeof(uint8_t)) {
+			writeCodes<uint8_t>(writer, observations);
+		} else {
+			writeCodes<uint16_t>(writer, observations);
+		}
+
+		for(const auto& names : content->featureNames) {
+			writer.writeValue<uint64_t>(names.map.size());
+			for(const auto& entry : names.map) {
+				writer.writeString(entry.first);
+				writer.writeValue<int32_t>(entry.second);
+			}
+			writer.writeValue<uint64_t>(names.revMap.size());
+			for(const auto& entry : names.revMap) {
+				writer.writeValue<int32_t>(entry.first.first);
+				writer.writeValue<int32_t>(entry.first.second);
+				writer.writeString(entry.second);
+			}
+		}
+		const std::string data = payload.str();
+
+		// Write to a temporary file first, readers never see a partial cache
+		const std::string temporary = filename + ".tmp";
+		std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+		BinaryWriter header(file);
+		file.write(CACHE_MAGIC, sizeof(CACHE_MAGIC));
+		header.writeValue(CACHE_VERSION);
+		header.writeValue(CACHE_BYTE_ORDER);
+		header.writeValue<uint64_t>(data.size());
+		header.writeValue(computeChecksum(data.data(), data.size()));
+		file.write(data.data(), data.size());
+		file.close();
+		if(!file.good() || std::rename(temporary.c_str(), filename.c_str()) != 0) {
+			std::remove(temporary.c_str());
+			throw std::invalid_argument("Cannot write discretisation cache '" +
+			                            filename + "'");
+		}
+	});
+}
+
+void DiscretisationCache::wait()
+{
+	if(pending_.valid()) {
+		pending_.get();
+	}
+}
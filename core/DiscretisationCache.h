@@ -0,0 +1,183 @@
+#ifndef DISCRETISATIONCACHE_H
+#define DISCRETISATIONCACHE_H
+
+#include "DiscretisationSettings.h"
+#include "Discretiser.h"
+#include "Matrix.h"
+#include "Network.h"
+
+#include <cstdint>
+#include <future>
+#include <string>
+#include <vector>
+
+/**
+ * A directory of binary files holding discretised observations together with
+ * the value names of every feature, so a data file can be loaded again
+ * without parsing and discretising it.
+ *
+ * The files are content addressed: the name of a file is derived from a hash
+ * of the contents of the data file, a hash of the settings of every feature
+ * and the deleted samples. Different data files, settings and sample
+ * selections therefore have their own files, and renaming or touching a data
+ * file does not invalidate its cache. Every file records its complete key and
+ * is only used if it matches.
+ *
+ * Every feature is stored as one block of compact codes followed by its
+ * missingness bitmap, the layout of DiscreteObservations. Writing happens in
+ * the background, so loading observations does not wait for the disk.
+ */
+class DiscretisationCache
+{
+	public:
+	/**DiscretisationCache
+	 *
+	 * @param directory, an existing directory holding the cache files
+	 *
+	 * @return DiscretisationCache object
+	 */
+	explicit DiscretisationCache(const std::string& directory);
+
+	DiscretisationCache(const DiscretisationCache&) = delete;
+	DiscretisationCache& operator=(const DiscretisationCache&) = delete;
+
+	/**~DiscretisationCache
+	 *
+	 * Waits for a pending write
+	 */
+	~DiscretisationCache();
+
+	/**load
+	 *
+	 * @param datafile, name of the file containing the raw sample data
+	 * @param settings, the discretisation settings for each node
+	 * @param deletedSamples, zero based indices of samples that should not be
+	 * read
+	 * @param obsMatrix, receives the discretised data
+	 * @param network, receives the value names of the features
+	 *
+	 * @return true, if the cache holds the discretisation of the contents of
+	 * the datafile with the given settings. Otherwise, e.g. if there is no
+	 * cache file or it is damaged, nothing is changed.
+	 */
+	bool load(const std::string& datafile, const DiscretisationSettings& settings,
+	          const std::vector<unsigned int>& deletedSamples,
+	          Matrix<int>& obsMatrix, Network& network);
+
+	/**load
+	 *
+	 * @param contentHash, hash of the raw sample data, see computeContentHash
+	 * @param fileSize, size of the raw sample data
+	 * @param settings, the discretisation settings for each node
+	 * @param deletedSamples, zero based indices of samples that should not be
+	 * read
+	 * @param obsMatrix, receives the discretised data
+	 * @param network, receives the value names of the features
+	 *
+	 * @return true, if the cache holds the discretisation of the given
+	 * contents, see above
+	 */
+	bool load(uint64_t contentHash, uint64_t fileSize,
+	          const DiscretisationSettings& settings,
+	          const std::vector<unsigned int>& deletedSamples,
+	          Matrix<int>& obsMatrix, Network& network);
+
+	/**store
+	 *
+	 * @param datafile, name of the file that has been discretised
+	 * @param contentHash, hash of the datafile computed before it was
+	 * discretised, see computeContentHash
+	 * @param fileSize, size of the datafile computed with the hash
+	 * @param settings, the discretisation settings for each node
+	 * @param deletedSamples, zero based indices of samples that were not read
+	 * @param obsMatrix, the discretised data
+	 * @param discretiser, the discretiser that produced obsMatrix
+	 *
+	 * Copies the data and writes the cache file in the background. A write
+	 * that is still pending is finished first. The datafile is hashed again
+	 * before writing. If it no longer matches contentHash and fileSize, it
+	 * may have changed while it was discretised and nothing is stored.
+	 */
+	void store(const std::string& datafile, uint64_t contentHash,
+	           uint64_t fileSize,
+	           const DiscretisationSettings& settings,
+	           const std::vector<unsigned int>& deletedSamples,
+	           const Matrix<int>& obsMatrix, const Discretiser& discretiser);
+
+	/**wait
+	 *
+	 * Blocks until a pending write has finished. A failed write is reported
+	 * with a std::invalid_argument exception.
+	 */
+	void wait();
+
+	/**getCacheFile
+	 *
+	 * @param datafile, name of the file containing the raw sample data
+	 * @param settings, the discretisation settings for each node
+	 * @param deletedSamples, zero based indices of samples that are not read
+	 *
+	 * @return the name of the cache file of the given input, empty if the
+	 * datafile cannot be read
+	 */
+	std::string getCacheFile(const std::string& datafile,
+	                         const DiscretisationSettings& settings,
+	                         const std::vector<unsigned int>& deletedSamples) const;
+
+	/**computeSettingsHash
+	 *
+	 * @param settings, the discretisation settings for each node
+	 *
+	 * @return a hash of the settings of all features. The order in which the
+	 * features are listed does not matter.
+	 */
+	static uint64_t computeSettingsHash(const DiscretisationSettings& settings);
+
+	/**computeContentHash
+	 *
+	 * @param datafile, name of a file
+	 * @param hash, receives the hash of the contents of the file
+	 * @param size, receives the size of the file
+	 *
+	 * @return false, if the file cannot be read
+	 */
+	static bool computeContentHash(const std::string& datafile, uint64_t& hash,
+	                               uint64_t& size);
+
+	private:
+	// Identifies the input a cache file was created from
+	struct Key
+	{
+		uint64_t fileSize;
+		uint64_t contentHash;
+		uint64_t settingsHash;
+		//Sorted without duplicates
+		std::vector<unsigned int> deletedSamples;
+	};
+
+	/**createKey
+	 *
+	 * @return the key of the input without the content of the datafile
+	 */
+	static Key createKey(const DiscretisationSettings& settings,
+	                     const std::vector<unsigned int>& deletedSamples);
+
+	/**getCacheFile
+	 *
+	 * @return the name of the cache file of a complete key
+	 */
+	std::string getCacheFile(const Key& key) const;
+
+	/**read
+	 *
+	 * Restores the cache file of key if it matches, see load
+	 */
+	bool read(const Key& key, Matrix<int>& obsMatrix, Network& network) const;
+
+	// Directory of the cache files
+	std::string directory_;
+	// The write running in the background
+	std::future<void> pending_;
+};
+
+#endif
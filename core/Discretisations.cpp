@@ -1,5 +1,7 @@
 #include "Discretisations.h"
-#include "sstream"
+
+#include <algorithm>
+#include <stdexcept>
 
 const int Discretisations::NA = -1;
 
@@ -7,15 +9,7 @@ boost::optional<float> Discretisations::getNumber(const Observations& obs,
                                                   unsigned int col,
                                                   unsigned int row)
 {
-	const auto& temp = obs(col, row);
-	if(temp == "NA") {
-		return boost::none;
-	}
-	std::stringstream ss(temp);
-	float f;
-	ss >> f;
-	return f;
-	//return std::stof(temp);
+	return obs.getNumber(col, row);
 }
 
 void Discretisations::createNameEntry(ObservationMap& obs,
@@ -27,19 +21,45 @@ void Discretisations::createNameEntry(ObservationMap& obs,
 	obsR[std::make_pair(value, row)] = svalue;
 }
 
-std::vector<float> Discretisations::createSortedVector(const Observations& obs,
-                                                       unsigned int row)
+std::vector<float> Discretisations::collectNumbers(const Observations& obs,
+                                                   unsigned int row)
 {
-	std::vector<float> templist;
-	templist.reserve(obs.getColCount()-obs.countElement(1,row,"NA"));
+	std::vector<float> numbers;
+	numbers.reserve(obs.getColCount() - obs.countNA(row));
 	for(unsigned int col = 0; col < obs.getColCount(); col++) {
 		auto value = getNumber(obs, col, row);
 		if(value) {
-			templist.push_back(value.get());
+			numbers.push_back(value.get());
 		}
 	}
-	std::sort(templist.begin(), templist.end());
-	return templist;
+	return numbers;
+}
+
+std::vector<float>
+Discretisations::selectOrderStatistics(std::vector<float>& values,
+                                       const std::vector<size_t>& ranks)
+{
+	std::vector<size_t> order(ranks.size());
+	for(size_t i = 0; i < order.size(); i++) {
+		order[i] = i;
+		if(ranks[i] >= values.size()) {
+			throw std::invalid_argument(
+			    "Cannot compute quantiles of a feature without enough values");
+		}
+	}
+	std::sort(order.begin(), order.end(),
+	          [&ranks](size_t a, size_t b) { return ranks[a] < ranks[b]; });
+
+	// After selecting a rank, all larger ranks lie behind it
+	std::vector<float> result(ranks.size());
+	size_t begin = 0;
+	for(auto i : order) {
+		std::nth_element(values.begin() + begin, values.begin() + ranks[i],
+		                 values.end());
+		result[i] = values[ranks[i]];
+		begin = ranks[i];
+	}
+	return result;
 }
 
 void Discretisations::convertToDenseNumbers(
@@ -1,6 +1,7 @@
 #ifndef DISCRETISATIONS_H
 #define DISCRETISATIONS_H
 
+#include "EncodedObservations.h"
 #include "Matrix.h"
 
 #include <map>
@@ -14,7 +15,7 @@
 class Discretisations
 {
 	public:
-	using Observations = Matrix<std::string>;
+	using Observations = EncodedObservations;
 	using DiscObservations = Matrix<int>;
 	using ObservationMap = std::unordered_map<std::string, int>;
 	using RevObservationMap = std::map<std::pair<int, int>, std::string>;
@@ -48,6 +49,13 @@ class Discretisations
 	 **/
 	virtual void apply(unsigned int row, Data& data) = 0;
 
+	/**usesTokens
+	 *
+	 * @return true, if the values are named after the original tokens, which
+	 * therefore have to be kept even for numeric features
+	 */
+	virtual bool usesTokens() const { return false; }
+
 	protected:
 	boost::optional<float> getNumber(const Observations& obs, unsigned int col,
 	                                 unsigned int row);
@@ -55,8 +63,30 @@ class Discretisations
 	void createNameEntry(ObservationMap& obs, RevObservationMap& obsR,
 	                     int value, unsigned int row);
 
-	std::vector<float> createSortedVector(const Observations&,
-	                                      unsigned int row);
+	/**collectNumbers
+	 *
+	 * @param obs, the raw sample data
+	 * @param row, index of the feature
+	 *
+	 * @return the numeric values of the feature without the missing ones, in
+	 * the order of the samples
+	 */
+	std::vector<float> collectNumbers(const Observations& obs,
+	                                  unsigned int row);
+
+	/**selectOrderStatistics
+	 *
+	 * @param values, the values of a feature, they are reordered
+	 * @param ranks, zero based positions in the sorted values
+	 *
+	 * @return the values that would be at the given positions if values were
+	 * sorted, in the order of ranks. The ranks are selected in increasing
+	 * order with nth_element, each within the values that can still hold it,
+	 * so the values are never sorted completely. Ranks beyond the values are
+	 * rejected with a std::invalid_argument exception.
+	 */
+	static std::vector<float> selectOrderStatistics(std::vector<float>& values,
+	                                                const std::vector<size_t>& ranks);
 
 	void
 	convertToDenseNumbers(const std::vector<boost::optional<int>>& discretized,
@@ -7,15 +7,13 @@ DiscretiseBracketMedians::DiscretiseBracketMedians(unsigned int buckets)
 
 void DiscretiseBracketMedians::apply(unsigned int row, Data& data)
 {
-	const auto& templist = createSortedVector(data.input, row);
-	std::vector<float> borderValues;
-	borderValues.reserve(buckets_ + 1);
+	std::vector<float> numbers = collectNumbers(data.input, row);
 	// Calculate borders
-	borderValues.push_back(templist[0]);
+	std::vector<size_t> ranks {0};
 	for(unsigned int i = 1; i < buckets_; i++) {
-		float borderValue=templist[templist.size() / buckets_ * i];
-		borderValues.push_back(borderValue);
+		ranks.push_back(numbers.size() / buckets_ * i);
 	}
+	std::vector<float> borderValues = selectOrderStatistics(numbers, ranks);
 	borderValues.push_back(std::numeric_limits<float>::max());
 
 	// Fill intervals
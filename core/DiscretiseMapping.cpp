@@ -15,7 +15,26 @@ void DiscretiseMapping::apply(unsigned int row, Data& data)
 		data.revMap[std::make_pair(result, row)] = value;
 	}
 
+	if(data.input.isNumeric(row)) {
+		for(unsigned int col = 0; col < data.input.getColCount(); col++) {
+			data.output.setData(data.map[data.input.getValue(col, row)], col,
+			                    row);
+		}
+		return;
+	}
+
+	// Translate every dictionary entry once instead of every cell
+	std::vector<int> translation;
+	for(const auto& value : data.input.getDictionary(row)) {
+		translation.push_back(data.map[value]);
+	}
+	const auto& codes = data.input.getCodes(row);
 	for(unsigned int col = 0; col < data.input.getColCount(); col++) {
-		data.output.setData(data.map[data.input(col, row)], col, row);
+		int result = codes[col] == EncodedObservations::NA_CODE
+		                 ? NA
+		                 : translation[codes[col]];
+		data.output.setData(result, col, row);
 	}
 }
+
+bool DiscretiseMapping::usesTokens() const { return true; }
@@ -21,6 +21,11 @@ class DiscretiseMapping : public Discretisations
 	 *
 	 */
 	void apply(unsigned int row, Data& data) override;
+
+	/**
+	 * @return true, the values are named after the tokens
+	 */
+	bool usesTokens() const override;
 };
 
 #endif
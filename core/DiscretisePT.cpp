@@ -2,12 +2,13 @@
 
 void DiscretisePT::apply(unsigned int row, Data& data)
 {
-	const std::vector<float>& templist = createSortedVector(data.input, row);
+	std::vector<float> numbers = collectNumbers(data.input, row);
+	// Calculate borders: Constants are defined by the method
+	const std::vector<float> quantiles = selectOrderStatistics(
+	    numbers, {static_cast<size_t>(ceil(0.185 * numbers.size())) - 1,
+	              static_cast<size_t>(ceil(0.815 * numbers.size())) - 1});
 	const std::vector<float> borderValues = {
-	    // Calculate borders: Constants are defined by the method
-	    std::numeric_limits<float>::min(),
-	    templist[ceil(0.185 * templist.size())-1],
-	    templist[ceil(0.815 * templist.size())-1],
+	    std::numeric_limits<float>::min(), quantiles[0], quantiles[1],
 	    std::numeric_limits<float>::max()};
 	// Fill intervals
 	for(unsigned int col = 0; col < data.input.getColCount(); col++) {
@@ -21,14 +21,14 @@ void DiscretiseThresholdBased::apply_(unsigned int row,
 
 void DiscretiseMedian::apply(unsigned int row, Data& data)
 {
-	const std::vector<float>& templist = createSortedVector(data.input, row);
+	std::vector<float> numbers = collectNumbers(data.input, row);
 	float median;
-	if(templist.size() % 2 != 0) {
-		median = templist[std::ceil(templist.size() / 2)];
+	if(numbers.size() % 2 != 0) {
+		median = selectOrderStatistics(numbers, {numbers.size() / 2})[0];
 	} else {
-		median = (templist[(templist.size() / 2) - 1] +
-		          templist[templist.size() / 2]) /
-		         2.0f;
+		const std::vector<float> middle = selectOrderStatistics(
+		    numbers, {numbers.size() / 2 - 1, numbers.size() / 2});
+		median = (middle[0] + middle[1]) / 2.0f;
 	}
 
 	apply_(row, data, median);
@@ -1,85 +1,171 @@
 #include "Discretiser.h"
 #include "DiscretisationFactory.h"
+#include "Parallel.h"
 #include <algorithm>
 #include "math.h"
 
 Discretiser::Discretiser(const Matrix<std::string>& originalObservations,
                          Matrix<int>& obsMatrix, Network& network)
-    : originalObservations_(originalObservations),
+    : Discretiser(EncodedObservations(originalObservations), obsMatrix, network)
+{
+}
+
+Discretiser::Discretiser(const Matrix<std::string>& originalObservations,
+                         const std::string& filename, Matrix<int>& obsMatrix,
+                         Network& network)
+    : Discretiser(EncodedObservations(originalObservations), filename,
+                  obsMatrix, network)
+{
+}
+
+Discretiser::Discretiser(EncodedObservations originalObservations,
+                         Matrix<int>& obsMatrix, Network& network)
+    : originalObservations_(std::move(originalObservations)),
       observations_(obsMatrix),
       network_(network)
 {
-	adaptFormat();
-	observations_.resize(originalObservations.getColCount(),
-	                     originalObservations.getRowCount(), -1);
-	observations_.setRowNames(originalObservations.getRowNames());
-	observations_.setColNames(originalObservations.getColNames());
+	initialiseObservations(originalObservations_);
 }
 
-Discretiser::Discretiser(const Matrix<std::string>& originalObservations,
+Discretiser::Discretiser(EncodedObservations originalObservations,
                          const std::string& filename, Matrix<int>& obsMatrix,
                          Network& network)
-    : originalObservations_(originalObservations),
+    : originalObservations_(std::move(originalObservations)),
       observations_(obsMatrix),
       network_(network)
 {
-	adaptFormat();
-	observations_.resize(originalObservations.getColCount(),
-	                     originalObservations.getRowCount(), -1);
-	observations_.setRowNames(originalObservations.getRowNames());
-	observations_.setColNames(originalObservations.getColNames());
+	initialiseObservations(originalObservations_);
 	discretise(filename);
 }
 
+Discretiser::Discretiser(const std::string& datafile,
+                         const DiscretisationSettings& settings,
+                         Matrix<int>& obsMatrix, Network& network,
+                         const std::vector<unsigned int>& deletedSamples,
+                         unsigned int threads)
+    : jsonTree_(settings), observations_(obsMatrix), network_(network)
+{
+	stream(datafile, deletedSamples, threads);
+}
+
+Discretiser::Discretiser(const std::string& datafile,
+                         const std::string& controlFile, Matrix<int>& obsMatrix,
+                         Network& network,
+                         const std::vector<unsigned int>& deletedSamples,
+                         unsigned int threads)
+    : controlFile_(controlFile), observations_(obsMatrix), network_(network)
+{
+	stream(datafile, deletedSamples, threads);
+}
+
+void Discretiser::stream(const std::string& datafile,
+                         const std::vector<unsigned int>& deletedSamples,
+                         unsigned int threads)
+{
+	originalObservations_ =
+	    EncodedObservations(datafile, *this, deletedSamples, threads);
+	factory_.reset();
+	observations_.setRowNames(originalObservations_.getRowNames());
+	mergeFeatureNames();
+}
+
 void Discretiser::setJsonTree(const DiscretisationSettings& jsonTree)
 {
 	jsonTree_ = jsonTree;
 }
 
-void Discretiser::discretise(const std::string& controlFile)
+void Discretiser::discretise(const std::string& controlFile,
+                             unsigned int threads)
 {
 	jsonTree_ = DiscretisationSettings(controlFile);
 
-	discretise();
+	discretise(threads);
 }
 
-void Discretiser::discretise()
+void Discretiser::discretise(unsigned int threads)
 {
+	factory_ = std::make_unique<DiscretisationFactory>(jsonTree_);
+	discretisations_.clear();
+	discretisations_.resize(originalObservations_.getRowCount());
+	featureNames_.clear();
+	featureNames_.resize(originalObservations_.getRowCount());
 
-	DiscretisationFactory dF(jsonTree_);
-	// Create Discretisations Objects
-	for(unsigned int i = 0; i < observations_.getRowCount(); i++) {
-		discretisations_.push_back(dF.create(observations_.getRowNames()[i]));
-	}
-	
-	Discretisations::Data data(originalObservations_, observations_,
-	                           network_.getObservationsMap(),
-	                           network_.getObservationsMapR());
-
-	// Apply Discretisation;
-	unsigned int row = 0;
-	for(auto& ptr : discretisations_) {
-		ptr->apply(row, data);
-		++row;
+	// Every feature collects its value names on its own, they are merged in
+	// the order of the features afterwards
+	forEachShard(originalObservations_.getRowCount(), threads,
+	             [this](size_t row) {
+		             discretiseFeature(originalObservations_, row);
+	             });
+	factory_.reset();
+	mergeFeatureNames();
+}
+
+void Discretiser::initialiseObservations(
+    const EncodedObservations& originalObservations)
+{
+	observations_.resize(originalObservations.getColCount(),
+	                     originalObservations.getRowCount(), -1);
+	observations_.setRowNames(originalObservations.getRowNames());
+	observations_.setColNames(originalObservations.getColNames());
+}
+
+void Discretiser::initialise(const EncodedObservations& originalObservations)
+{
+	if(!controlFile_.empty()) {
+		jsonTree_ = DiscretisationSettings(controlFile_);
 	}
+	factory_ = std::make_unique<DiscretisationFactory>(jsonTree_);
+	initialiseObservations(originalObservations);
+	discretisations_.resize(originalObservations.getRowCount());
+	featureNames_.resize(originalObservations.getRowCount());
 }
 
-void Discretiser::adaptFormat()
+bool Discretiser::needsTokens(const EncodedObservations& originalObservations,
+                              unsigned int row)
 {
-	static const std::string na1 = "na";
-	static const std::string na2 = "-";
-	static const std::string na3 = "/";
+	discretisations_[row] =
+	    factory_->create(originalObservations.getRowNames()[row]);
+	return discretisations_[row]->usesTokens();
+}
 
-	static const std::string canonical_na("NA");
+void Discretiser::process(const EncodedObservations& originalObservations,
+                          unsigned int row)
+{
+	discretiseFeature(originalObservations, row);
+}
 
-	for(unsigned int col = 0; col < originalObservations_.getColCount();
-	    col++) {
-		for(unsigned int row = 0; row < originalObservations_.getRowCount();
-		    row++) {
-			std::string& value = originalObservations_(col, row);
-			if(value == na1 || value == na2 || value == na3) {
-				value = canonical_na;
-			}
+void Discretiser::discretiseFeature(
+    const EncodedObservations& originalObservations, unsigned int row)
+{
+	if(!discretisations_[row]) {
+		discretisations_[row] =
+		    factory_->create(originalObservations.getRowNames()[row]);
+	}
+
+	// Every feature writes to its own row of the discretised observations
+	Discretisations::Data data(originalObservations, observations_,
+	                           featureNames_[row].map, featureNames_[row].revMap);
+	discretisations_[row]->apply(row, data);
+}
+
+void Discretiser::mergeFeatureNames()
+{
+	auto& map = network_.getObservationsMap();
+	auto& revMap = network_.getObservationsMapR();
+	// Later features overwrite the names of earlier ones, like a sequential
+	// discretisation does
+	for(auto& names : featureNames_) {
+		for(const auto& entry : names.map) {
+			map[entry.first] = entry.second;
+		}
+		for(const auto& entry : names.revMap) {
+			revMap[entry.first] = entry.second;
 		}
 	}
 }
+
+const Discretiser::FeatureNames&
+Discretiser::getFeatureNames(unsigned int row) const
+{
+	return featureNames_[row];
+}
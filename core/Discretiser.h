@@ -1,13 +1,14 @@
 #ifndef DISCRETISER_H
 #define DISCRETISER_H
 
+#include "DiscretisationFactory.h"
 #include "Discretisations.h"
 #include "DiscretisationSettings.h"
 #include "Network.h"
 #include "float.h"
 #include <map>
 
-class Discretiser
+class Discretiser : private EncodedObservations::FeatureHandler
 {
 	public:
 	/**Discretiser
@@ -23,6 +24,18 @@ class Discretiser
 	Discretiser(const Matrix<std::string>& originalObservations,
 	            Matrix<int>& obsMatrix, Network& network);
 
+	/**Discretiser
+	 *
+	 * @param originalObservations, the dictionary encoded raw sample data
+	 * @param obsMatrix, a reference to the new observation matrix that shall
+	 * contain the discretised data
+	 * @param network, a reference to the network
+	 *
+	 * @return Discretiser Object
+	 */
+	Discretiser(EncodedObservations originalObservations,
+	            Matrix<int>& obsMatrix, Network& network);
+
 	/**Discretiser
 	 *
 	 * @param originalObservations, a const reference to the matrix containing
@@ -43,6 +56,69 @@ class Discretiser
 	            const std::string& filename, Matrix<int>& obsMatrix,
 	            Network& network);
 
+	/**Discretiser
+	 *
+	 * @param originalObservations, the dictionary encoded raw sample data
+	 * @param filename, name of a "controlFile" that regulates the
+	 * discretisation for each node
+	 * @param obsMatrix, a reference to the new observation matrix that shall
+	 * contain the discretised data
+	 * @param network, a reference to the network
+	 *
+	 * @return Discretiser Object
+	 */
+	Discretiser(EncodedObservations originalObservations,
+	            const std::string& filename, Matrix<int>& obsMatrix,
+	            Network& network);
+
+	/**Discretiser
+	 *
+	 * @param datafile, name of the file containing the raw sample data
+	 * @param settings, the discretisation settings for each node
+	 * @param obsMatrix, a reference to the new observation matrix that shall
+	 * contain the discretised data
+	 * @param network, a reference to the network
+	 * @param deletedSamples, zero based indices of samples that should not be
+	 * read
+	 * @param threads, number of threads used for parsing and discretising, 0
+	 * to use all cores
+	 *
+	 * @return Discretiser Object
+	 *
+	 * Discretises every feature as soon as it has been parsed and releases
+	 * its raw values afterwards, so the raw sample data is never held in
+	 * memory as a whole. The result equals loading the file first and
+	 * discretising it with the same settings.
+	 */
+	Discretiser(const std::string& datafile,
+	            const DiscretisationSettings& settings, Matrix<int>& obsMatrix,
+	            Network& network,
+	            const std::vector<unsigned int>& deletedSamples = {},
+	            unsigned int threads = 0);
+
+	/**Discretiser
+	 *
+	 * @param datafile, name of the file containing the raw sample data
+	 * @param controlFile, name of a "controlFile" that regulates the
+	 * discretisation for each node
+	 * @param obsMatrix, a reference to the new observation matrix that shall
+	 * contain the discretised data
+	 * @param network, a reference to the network
+	 * @param deletedSamples, zero based indices of samples that should not be
+	 * read
+	 * @param threads, number of threads used for parsing and discretising, 0
+	 * to use all cores
+	 *
+	 * @return Discretiser Object
+	 *
+	 * Like the constructor above. The controlFile is read after the datafile
+	 * has been opened.
+	 */
+	Discretiser(const std::string& datafile, const std::string& controlFile,
+	            Matrix<int>& obsMatrix, Network& network,
+	            const std::vector<unsigned int>& deletedSamples = {},
+	            unsigned int threads = 0);
+
 	/**setJsonTree
 	 *
 	 * @param A reference to a DiscretisationSettings Object
@@ -51,6 +127,13 @@ class Discretiser
 	 */
 	void setJsonTree(const DiscretisationSettings&);
 
+	// The value names assigned while discretising a single feature
+	struct FeatureNames
+	{
+		Discretisations::ObservationMap map;
+		Discretisations::RevObservationMap revMap;
+	};
+
 	Discretiser& operator=(const Discretiser&) = delete;
 
 	Discretiser& operator=(Discretiser&&) = delete;
@@ -59,18 +142,33 @@ class Discretiser
 	 *
 	 * @param const std::string& controlFile name of the json file 
 	 * containing the discretisation information
+	 * @param threads, number of threads used for discretising, 0 to use all
+	 * cores
 	 *
 	 * Extracts the discretisation information from the controlFile
 	 * and calls discretise() subsequently 
 	 */
-	void discretise(const std::string& controlFile);
+	void discretise(const std::string& controlFile, unsigned int threads = 0);
 
 	/**discretise
-	 * 
+	 *
+	 * @param threads, number of threads used for discretising, 0 to use all
+	 * cores
+	 *
 	 * Calls the apply function of all Discretisations objects stored in 
-	 * discretisations_
+	 * discretisations_. The features are discretised concurrently, the result
+	 * does not depend on the number of threads.
 	 */
-	void discretise();
+	void discretise(unsigned int threads = 0);
+
+	/**getFeatureNames
+	 *
+	 * @param row, index of a discretised feature
+	 *
+	 * @return the value names assigned while discretising the feature, which
+	 * have been added to the maps of the network
+	 */
+	const FeatureNames& getFeatureNames(unsigned int row) const;
 
 	private:
 	/**createDiscretisaionClasses
@@ -81,19 +179,89 @@ class Discretiser
 	 */
 	void createDiscretisationClasses(const std::string& controlFile);
 
-	/**adaptFormat
+	/**stream
+	 *
+	 * @param datafile, name of the file containing the raw sample data
+	 * @param deletedSamples, zero based indices of samples that should not be
+	 * read
+	 * @param threads, number of threads used for parsing and discretising
+	 *
+	 * Discretises the features of the datafile while parsing it
+	 */
+	void stream(const std::string& datafile,
+	            const std::vector<unsigned int>& deletedSamples,
+	            unsigned int threads);
+
+	/**initialiseObservations
+	 *
+	 * @param originalObservations, the raw sample data
+	 *
+	 * Sizes the discretised observation matrix like the raw sample data
+	 */
+	void initialiseObservations(const EncodedObservations& originalObservations);
+
+	/**initialise
+	 *
+	 * @param originalObservations, the raw sample data being parsed
+	 *
+	 * Prepares the discretisation of a streamed file
+	 */
+	void initialise(const EncodedObservations& originalObservations) override;
+
+	/**needsTokens
+	 *
+	 * @param originalObservations, the raw sample data being parsed
+	 * @param row, index of the feature that is about to be encoded
 	 *
-	 * Replaces various kinds of NA representations by a unqiue version
+	 * @return true, if the discretisation of the feature names its values
+	 * after the tokens. The discretisation is created here already.
 	 */
-	void adaptFormat();
+	bool needsTokens(const EncodedObservations& originalObservations,
+	                 unsigned int row) override;
+
+	/**process
+	 *
+	 * @param originalObservations, the raw sample data being parsed
+	 * @param row, index of the feature that has just been parsed
+	 *
+	 * Discretises a single feature of a streamed file
+	 */
+	void process(const EncodedObservations& originalObservations,
+	             unsigned int row) override;
+
+	/**discretiseFeature
+	 *
+	 * @param originalObservations, the raw sample data
+	 * @param row, index of the feature
+	 *
+	 * Applies the discretisation of a single feature, which is created unless
+	 * needsTokens did so already. Value names are collected per feature, so
+	 * different features can be discretised concurrently.
+	 */
+	void discretiseFeature(const EncodedObservations& originalObservations,
+	                       unsigned int row);
+
+	/**mergeFeatureNames
+	 *
+	 * Adds the value names of all features to the maps of the network in
+	 * the order of the features
+	 */
+	void mergeFeatureNames();
+
 	// Json Tree
 	DiscretisationSettings jsonTree_;
-	// Matrix containing the original raw sample data
-	Matrix<std::string> originalObservations_;
+	// Control file that is read once a streamed datafile has been opened
+	std::string controlFile_;
+	// The original raw sample data, NA representations are already unified
+	EncodedObservations originalObservations_;
 	// Matrix containing the discretised data
 	Matrix<int>& observations_;
 	// Vector of unique pointers, pointing to discretisation objects
 	std::vector<std::unique_ptr<Discretisations>> discretisations_;
+	// Factory for the discretisation objects, only valid while discretising
+	std::unique_ptr<DiscretisationFactory> factory_;
+	// Value names of every feature
+	std::vector<FeatureNames> featureNames_;
 	// Network
 	Network& network_;
 };
@@ -1,209 +1,806 @@
 #include "EM.h"
+#include "BinaryIO.h"
+#include "OnlineEM.h"
+#include "Parallel.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <limits>
+#include <numeric>
+#include <random>
+#include <sstream>
+
+EM::Run::Run(const Network& network, unsigned int method)
+    : method(method),
+      polynomial(network),
+      parameters(polynomial.getParameters()),
+      logLikelihood(-std::numeric_limits<double>::infinity()),
+      improvement(std::numeric_limits<double>::infinity()),
+      previousImprovement(std::numeric_limits<double>::infinity()),
+      difference(std::numeric_limits<float>::infinity()),
+      iterations(0),
+      acceptedExtrapolations(0),
+      rejectedExtrapolations(0),
+      converged(false),
+      abandoned(false),
+      eTimeInMicroSeconds(0.0),
+      mTimeInMicroSeconds(0.0)
+{
+}
+
+constexpr unsigned int EM::WARM_START;
+
+// Weight of the uniform distribution mixed into warm start parameters
+static const double WARM_START_SMOOTHING = 0.001;
+
+static const char CHECKPOINT_MAGIC[8] = {'C', 'T', 'E', 'M', 'C', 'K', 'P', 'T'};
+static const uint32_t CHECKPOINT_VERSION = 3;
+static const uint32_t CHECKPOINT_BYTE_ORDER = 0x01020304;
 
 EM::EM(Network& network, Matrix<int>& observations, float difference,
-       unsigned int runs)
+       unsigned int runs, const EMSettings& settings,
+       const std::vector<unsigned int>& weights)
+    : EM(network, DiscreteObservations(observations),
+         NetworkPolynomial::Parameters(), difference, runs, settings, weights)
+{
+}
+
+EM::EM(Network& network, Matrix<int>& observations,
+       const NetworkPolynomial::Parameters& initialParameters, float difference,
+       unsigned int runs, const EMSettings& settings,
+       const std::vector<unsigned int>& weights)
+    : EM(network, DiscreteObservations(observations), initialParameters,
+         difference, runs, settings, weights)
+{
+}
+
+EM::EM(Network& network, DiscreteObservations observations,
+       const NetworkPolynomial::Parameters& initialParameters, float difference,
+       unsigned int runs, const EMSettings& settings,
+       const std::vector<unsigned int>& weights)
     : network_(network),
-      observations_(observations),
+      method_(0),
+      observations_(std::move(observations)),
       probHandler_(network),
+      settings_(settings),
+      initialParameters_(initialParameters),
+      weights_(weights),
+      expectation_(network),
+      cardinalities_(expectation_.getCardinalities()),
       differenceThreshold_(difference),
-      maxRuns_(runs)
+      maxRuns_(runs),
+      neededRuns_(0),
+      abandonedRuns_(0),
+      acceptedExtrapolations_(0),
+      rejectedExtrapolations_(0),
+      resumedIterations_(0),
+      iterationsSaved_(0),
+      statisticsUpdates_(0),
+      finalDifference_(0.0f),
+      logLikelihood_(0.0)
 {
+	if(!weights_.empty() && weights_.size() != observations_.getColCount()) {
+		throw std::invalid_argument("Number of weights does not match the number of samples");
+	}
+	expectation_.setWeights(weights_);
 	performEM();
 }
 
 void EM::performEM()
 {
 	start = std::chrono::system_clock::now();
+	if(settings_.batchSize > 0) {
+		miniBatchEM();
+		end = std::chrono::system_clock::now();
+		return;
+	}
+
+	std::vector<Run> runs;
+	std::vector<unsigned int> resumed;
 	// Check completness of the data
-	if(observations_.contains(-1)) {
-		// Determine the best initialization method
-		method_ = getMaxMethod_();
-		// Perform another EM run with the best method.
-		std::tie(finalDifference_, neededRuns_) = runEMIterations_();
+	if(observations_.containsMissing()) {
+		if(!initialParameters_.empty()) {
+			runs.emplace_back(network_, WARM_START);
+			initalise(runs.back());
+		} else {
+			// Uniform, observed distribution and random restarts
+			for(unsigned int method = 0; method < 2 + settings_.randomRestarts;
+			    method++) {
+				runs.emplace_back(network_, method);
+				initalise(runs.back());
+			}
+		}
+		if(!settings_.checkpointFile.empty() && readCheckpoint(runs)) {
+			for(const auto& run : runs) {
+				resumed.push_back(run.iterations);
+			}
+		}
+		runConcurrently(runs);
+		if(!settings_.checkpointFile.empty()) {
+			// Runs stopped by the iteration limit can be continued later
+			bool finished = std::all_of(runs.begin(), runs.end(), [](const Run& run) {
+				return run.converged || run.abandoned;
+			});
+			if(finished) {
+				std::remove(settings_.checkpointFile.c_str());
+			} else {
+				writeCheckpoint(runs);
+			}
+		}
 	} else {
 		// Calculate parameters directly
-		finalDifference_ = mPhase();
-		neededRuns_ = 1;
+		runs.emplace_back(network_, initialParameters_.empty() ? 0 : WARM_START);
+		initalise(runs.back());
+		plainStep(runs.back(), settings_.threads);
+	}
+
+	// Keep the parameters of the best run that has not been abandoned
+	unsigned int best = 0;
+	abandonedRuns_ = 0;
+	for(unsigned int i = 0; i < runs.size(); i++) {
+		if(runs[i].abandoned) {
+			abandonedRuns_++;
+		} else if(runs[best].abandoned ||
+		          runs[i].logLikelihood > runs[best].logLikelihood) {
+			best = i;
+		}
+	}
+	Run& winner = runs[best];
+	method_ = winner.method;
+	neededRuns_ = winner.iterations;
+	finalDifference_ = winner.difference;
+	logLikelihood_ = winner.logLikelihood;
+	acceptedExtrapolations_ = winner.acceptedExtrapolations;
+	rejectedExtrapolations_ = winner.rejectedExtrapolations;
+	resumedIterations_ = resumed.empty() ? 0 : resumed[best];
+	trace_.clear();
+	for(const auto& run : runs) {
+		trace_.insert(trace_.end(), run.trace.begin(), run.trace.end());
+	}
+	storeParameters(winner.parameters);
+
+	// Runs restored from a finished checkpoint have no statistics yet
+	if(winner.statistics.getNumberOfNodes() == 0) {
+		ePhase(winner, settings_.threads);
+	}
+	double samples = observations_.getColCount();
+	if(!weights_.empty()) {
+		samples = std::accumulate(weights_.begin(), weights_.end(), 0.0);
+	}
+	statistics_.clear();
+	for(unsigned int id = 0; id < winner.statistics.getNumberOfNodes(); id++) {
+		const double* counts = winner.statistics.data(id);
+		statistics_.emplace_back(counts, counts + winner.statistics.size(id));
+		for(auto& value : statistics_.back()) {
+			value /= samples;
+		}
 	}
+	statisticsUpdates_ = samples;
 	end = std::chrono::system_clock::now();
+
+	// Not part of the training time
+	iterationsSaved_ = 0;
+	if(settings_.accelerate && settings_.measureIterationsSaved &&
+	   observations_.containsMissing()) {
+		iterationsSaved_ = measureIterationsSaved(winner);
+	}
 }
 
-unsigned int EM::getMaxMethod_()
+void EM::miniBatchEM()
 {
-	float maxprob = 0.0f;
-	unsigned int maxmethod = 0;
+	if(observations_.getColCount() == 0) {
+		throw std::invalid_argument("No samples provided");
+	}
+	// Every distinct sample is drawn as often as it occurs
+	std::vector<unsigned int> order;
+	for(unsigned int col = 0; col < observations_.getColCount(); col++) {
+		order.insert(order.end(), weights_.empty() ? 1 : weights_[col], col);
+	}
+	const size_t samples = order.size();
+
+	// Start from the distribution of the observed values or the given parameters
+	Run run(network_, initialParameters_.empty() ? 1 : WARM_START);
+	initalise(run);
+	storeParameters(run.parameters);
+	OnlineEM onlineEM(network_, settings_);
 
-	for(unsigned int method = 0; method < 2; method++) {
-		// Initialize and iterate E/M-Phase
-		method_ = method;
-		runEMIterations_();
-		float prob = calculateLikelihoodOfTheData();
-		if(prob > maxprob) {
-			maxprob = prob;
-			maxmethod = method;
+	size_t batchSize = std::min<size_t>(settings_.batchSize, samples);
+	size_t batches = std::max<size_t>(
+	    1, std::ceil(settings_.epochs * samples / batchSize));
+	std::mt19937 generator(settings_.seed);
+
+	// The log-likelihood is estimated from the batches of the current epoch
+	double logLikelihood = 0.0;
+	size_t scored = 0;
+	size_t position = samples;
+	for(size_t batch = 0; batch < batches; batch++) {
+		if(position >= samples) {
+			std::shuffle(order.begin(), order.end(), generator);
+			position = 0;
+			logLikelihood = 0.0;
+			scored = 0;
 		}
+		size_t last = std::min(samples, position + batchSize);
+		std::vector<unsigned int> indices(order.begin() + position,
+		                                  order.begin() + last);
+		logLikelihood += onlineEM.update(observations_, indices);
+		scored += indices.size();
+		position = last;
 	}
 
-	return maxmethod;
+	method_ = run.method;
+	neededRuns_ = batches;
+	finalDifference_ = onlineEM.getDifference();
+	logLikelihood_ = logLikelihood * samples / scored;
+	statistics_ = onlineEM.getStatistics();
+	statisticsUpdates_ = onlineEM.getNumberOfUpdates();
 }
 
-std::pair<float, unsigned int> EM::runEMIterations_()
+bool EM::isActive(const Run& run) const
 {
-	unsigned int runs = 0;
-	float difference = std::numeric_limits<float>::infinity();
+	return !run.abandoned && !run.converged && run.iterations < maxRuns_;
+}
 
-	initalise();
-	while(difference > differenceThreshold_ && runs < maxRuns_) {
-		ePhase();
-		difference = mPhase();
-		runs++;
+void EM::iterate(Run& run, unsigned int threads)
+{
+	// An extrapolation cycle passes over the data four times
+	if(settings_.accelerate && run.iterations + 4 <= maxRuns_) {
+		squaremStep(run, threads);
+	} else {
+		plainStep(run, threads);
 	}
+	checkConvergence(run);
+}
 
-	return std::make_pair(difference, runs);
+void EM::checkConvergence(Run& run) const
+{
+	run.converged = run.difference <= differenceThreshold_;
+	if(settings_.likelihoodTolerance > 0.0 && run.iterations > 1 &&
+	   std::fabs(run.improvement) <=
+	       settings_.likelihoodTolerance * std::fabs(run.logLikelihood)) {
+		run.converged = true;
+	}
+}
+
+int EM::measureIterationsSaved(const Run& run)
+{
+	Run plain(network_, run.method);
+	initalise(plain);
+	while(isActive(plain)) {
+		plainStep(plain, settings_.threads);
+		checkConvergence(plain);
+	}
+	return static_cast<int>(plain.iterations) - static_cast<int>(run.iterations);
+}
+
+void EM::updateLikelihood(Run& run, double logLikelihood)
+{
+	run.previousImprovement = run.improvement;
+	run.improvement = logLikelihood - run.logLikelihood;
+	run.logLikelihood = logLikelihood;
+}
+
+void EM::plainStep(Run& run, unsigned int threads)
+{
+	const double eTime = run.eTimeInMicroSeconds;
+	const double mTime = run.mTimeInMicroSeconds;
+	updateLikelihood(run, ePhase(run, threads));
+	run.difference = mPhase(run, threads);
+	run.iterations++;
+	recordStep(run, false, eTime, mTime);
+}
+
+void EM::recordStep(Run& run, bool accelerated, double eTime, double mTime)
+{
+	EMIteration step;
+	step.method = run.method;
+	step.iteration = run.iterations;
+	step.accelerated = accelerated;
+	step.eTimeInMicroSeconds = run.eTimeInMicroSeconds - eTime;
+	step.mTimeInMicroSeconds = run.mTimeInMicroSeconds - mTime;
+	step.difference = run.difference;
+	step.logLikelihood = run.logLikelihood;
+	run.trace.push_back(step);
 }
 
-float EM::calculateProbabilityEM(Node& n, unsigned int col, unsigned int row)
+void EM::squaremStep(Run& run, unsigned int threads)
 {
-	// get Parents
-	auto ParentIDs = n.getParents();
-	const Matrix<float>& probMatrix = n.getProbabilityMatrix();
+	const double eTime = run.eTimeInMicroSeconds;
+	const double mTime = run.mTimeInMicroSeconds;
+	// Two plain EM steps: theta0 -> theta1 -> theta2
+	const NetworkPolynomial::Parameters theta0 = run.parameters;
+	ePhase(run, threads);
+	mPhase(run, threads);
+	const NetworkPolynomial::Parameters theta1 = run.parameters;
+	ePhase(run, threads);
+	mPhase(run, threads);
+	const NetworkPolynomial::Parameters theta2 = run.parameters;
+	// The statistics at theta2 continue the plain iteration if the
+	// extrapolation is not used
+	double logLikelihood2 = ePhase(run, threads);
+	run.iterations += 3;
 
-	// compute TotProbParentsRec
-	float totProbParents = 1.0f;
-	for(unsigned int key = 0; key < n.getNumberOfParents(); key++) {
-		totProbParents *= probHandler_.computeTotalProbability(
-		    ParentIDs[key], network_.reverseFactor(n, key,row));
+	// Step length of the squared extrapolation (SqS3)
+	double normR = 0.0;
+	double normV = 0.0;
+	for(unsigned int id = 0; id < theta0.size(); id++) {
+		for(unsigned int k = 0; k < theta0[id].size(); k++) {
+			double r = theta1[id][k] - theta0[id][k];
+			double v = theta2[id][k] - 2.0 * theta1[id][k] + theta0[id][k];
+			normR += r * r;
+			normV += v * v;
+		}
+	}
+	if(normV <= 0.0) {
+		// Already at a fixed point
+		updateLikelihood(run, logLikelihood2);
+		run.difference = mPhase(run, threads);
+		recordStep(run, true, eTime, mTime);
+		return;
 	}
+	double alpha = std::min(-1.0, -std::sqrt(normR / normV));
 
-	// computeNormalizingProb
-	float denominator = 0.0f;
-	for(unsigned int col = 0; col < probMatrix.getColCount(); col++) {
-		denominator += probMatrix(col, row) * totProbParents;
+	// Extrapolate and project every CPT row back onto the simplex
+	const SufficientStatistics statistics2 = run.statistics;
+	for(unsigned int id = 0; id < theta0.size(); id++) {
+		auto& parameter = run.parameters[id];
+		unsigned int cardinality = cardinalities_[id];
+		for(unsigned int k = 0; k < parameter.size(); k++) {
+			double r = theta1[id][k] - theta0[id][k];
+			double v = theta2[id][k] - 2.0 * theta1[id][k] + theta0[id][k];
+			parameter[k] = std::max(
+			    0.0, theta0[id][k] - 2.0 * alpha * r + alpha * alpha * v);
+		}
+		for(size_t row = 0; row < parameter.size() / cardinality; row++) {
+			double rowsum = 0.0;
+			for(unsigned int col = 0; col < cardinality; col++) {
+				rowsum += parameter[col + row * cardinality];
+			}
+			for(unsigned int col = 0; col < cardinality; col++) {
+				parameter[col + row * cardinality] =
+				    rowsum > 0.0 ? parameter[col + row * cardinality] / rowsum
+				                 : theta2[id][col + row * cardinality];
+			}
+		}
 	}
+	run.polynomial.setParameters(run.parameters);
 
-	// return result
-	float nominator = probMatrix(col - 1, row) * totProbParents;
-	return nominator / denominator;
+	// Stabilising EM step from the extrapolated point
+	double logLikelihood = ePhase(run, threads);
+	run.iterations++;
+	if(logLikelihood >= logLikelihood2) {
+		updateLikelihood(run, logLikelihood);
+		run.acceptedExtrapolations++;
+	} else {
+		// Monotonicity violated: continue the plain EM iteration from theta2
+		run.parameters = theta2;
+		run.polynomial.setParameters(run.parameters);
+		run.statistics = statistics2;
+		updateLikelihood(run, logLikelihood2);
+		run.rejectedExtrapolations++;
+	}
+	run.difference = mPhase(run, threads);
+	recordStep(run, true, eTime, mTime);
 }
 
-void EM::calculateExpectedValue(unsigned int row, Node& n)
+void EM::runConcurrently(std::vector<Run>& runs)
 {
-	Matrix<int>& obMatrix = n.getObservationMatrix();	
-	if(obMatrix.hasNACol()) {
-		for(unsigned int col = 1; col < obMatrix.getColCount(); col++) {
-			float value =
-			    obMatrix(col, row) +
-			    calculateProbabilityEM(n, col, row) * obMatrix(0, row);
-			obMatrix.setData(value, col, row);
+	const unsigned int threads = getNumberOfThreads(settings_.threads);
+	std::vector<Run*> active;
+	for(auto& run : runs) {
+		// Runs restored from a checkpoint may have finished already
+		if(isActive(run)) {
+			active.push_back(&run);
+		}
+	}
+	const unsigned int interval = std::max(1u, settings_.checkpointInterval);
+	unsigned int rounds = 0;
+	while(!active.empty()) {
+		// Spread the threads over the active runs
+		unsigned int inner = std::max(1u, threads / static_cast<unsigned int>(active.size()));
+		forEachShard(active.size(), threads, [&](size_t i) {
+			iterate(*active[i], inner);
+		});
+		abandonLosingRuns(runs);
+		if(!settings_.checkpointFile.empty() && ++rounds % interval == 0) {
+			writeCheckpoint(runs);
+		}
+		active.clear();
+		for(auto& run : runs) {
+			if(isActive(run)) {
+				active.push_back(&run);
+			}
 		}
 	}
 }
 
-void EM::ePhase()
+void EM::writeCheckpoint(const std::vector<Run>& runs) const
 {
-	for(auto& n : network_.getNodes()) {
-		for(unsigned int row = 0; row < n.getNumberOfParentValues(); row++) {
-			calculateExpectedValue(row, n);
+	std::ostringstream payload;
+	BinaryWriter writer(payload);
+	writer.writeValue<uint64_t>(observations_.getColCount());
+	writer.writeValue<uint64_t>(observations_.getRowCount());
+	writer.writeValue(computeDataChecksum());
+	writer.writeValue<uint64_t>(runs.size());
+	for(const auto& run : runs) {
+		writer.writeValue<uint32_t>(run.method);
+		writer.writeValue<uint32_t>(run.iterations);
+		writer.writeValue(run.logLikelihood);
+		writer.writeValue(run.improvement);
+		writer.writeValue(run.previousImprovement);
+		writer.writeValue(run.difference);
+		writer.writeValue<uint32_t>(run.acceptedExtrapolations);
+		writer.writeValue<uint32_t>(run.rejectedExtrapolations);
+		writer.writeValue<uint8_t>(run.converged);
+		writer.writeValue<uint8_t>(run.abandoned);
+		writer.writeValue<uint64_t>(run.parameters.size());
+		for(const auto& parameter : run.parameters) {
+			writer.writeArray(parameter);
 		}
 	}
+	const std::string data = payload.str();
+
+	const std::string temporary = settings_.checkpointFile + ".tmp";
+	std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+	BinaryWriter header(file);
+	file.write(CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC));
+	header.writeValue(CHECKPOINT_VERSION);
+	header.writeValue(CHECKPOINT_BYTE_ORDER);
+	header.writeValue<uint64_t>(data.size());
+	header.writeValue(computeChecksum(data.data(), data.size()));
+	file.write(data.data(), data.size());
+	file.close();
+	if(!file.good() ||
+	   std::rename(temporary.c_str(), settings_.checkpointFile.c_str()) != 0) {
+		std::remove(temporary.c_str());
+		throw std::invalid_argument("Cannot write checkpoint '" +
+		                            settings_.checkpointFile + "'");
+	}
 }
 
-void EM::calculateMaximumLikelihood(unsigned int row, unsigned int& counter,
-                                    float& difference, Node& n,
-                                    const Matrix<int>& obMatrix)
+bool EM::readCheckpoint(std::vector<Run>& runs)
 {
-	float rowsum = obMatrix.calculateRowSum(row);
-	if(obMatrix.hasNACol()){
-			for(unsigned int col = 1; col < obMatrix.getColCount(); col++) {
-				float probability = 0.0f;
-				if ((rowsum-obMatrix(0,row)) > 0.0){
-					probability = obMatrix(col, row) /
-			    	                (rowsum - obMatrix(0, row));
-					difference += fabs(n.getProbability(col - 1, row) - probability);
-				}
-				n.setProbability(probability, col - 1, row);
-				counter++;
-				}
+	std::ifstream exists(settings_.checkpointFile);
+	if(!exists.good()) {
+		return false;
+	}
+	exists.close();
+
+	// Any inconsistency means the checkpoint is unusable, EM then starts over
+	try {
+		MappedFile file(settings_.checkpointFile);
+		if(file.size() < sizeof(CHECKPOINT_MAGIC) ||
+		   std::memcmp(file.data(), CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC)) != 0) {
+			return false;
+		}
+		BinaryReader header(file.data() + sizeof(CHECKPOINT_MAGIC),
+		                    file.size() - sizeof(CHECKPOINT_MAGIC));
+		if(header.readValue<uint32_t>() != CHECKPOINT_VERSION ||
+		   header.readValue<uint32_t>() != CHECKPOINT_BYTE_ORDER) {
+			return false;
+		}
+		uint64_t size = header.readValue<uint64_t>();
+		uint64_t checksum = header.readValue<uint64_t>();
+		const size_t offset = sizeof(CHECKPOINT_MAGIC) + 2 * sizeof(uint32_t) +
+		                      2 * sizeof(uint64_t);
+		if(size != file.size() - offset ||
+		   checksum != computeChecksum(file.data() + offset, size)) {
+			return false;
+		}
+
+		BinaryReader reader(file.data() + offset, size);
+		if(reader.readValue<uint64_t>() != observations_.getColCount() ||
+		   reader.readValue<uint64_t>() != observations_.getRowCount() ||
+		   reader.readValue<uint64_t>() != computeDataChecksum() ||
+		   reader.readValue<uint64_t>() != runs.size()) {
+			return false;
+		}
+		std::vector<Run> restored = runs;
+		for(auto& run : restored) {
+			if(reader.readValue<uint32_t>() != run.method) {
+				return false;
+			}
+			run.iterations = reader.readValue<uint32_t>();
+			run.logLikelihood = reader.readValue<double>();
+			run.improvement = reader.readValue<double>();
+			run.previousImprovement = reader.readValue<double>();
+			run.difference = reader.readValue<float>();
+			run.acceptedExtrapolations = reader.readValue<uint32_t>();
+			run.rejectedExtrapolations = reader.readValue<uint32_t>();
+			run.converged = reader.readValue<uint8_t>() != 0;
+			run.abandoned = reader.readValue<uint8_t>() != 0;
+			if(reader.readValue<uint64_t>() != run.parameters.size()) {
+				return false;
 			}
-	else {
-			for(unsigned int col = 0; col < obMatrix.getColCount(); col++) {
-				float probability =  0.0f;
-				if (rowsum != 0){
-					probability = obMatrix(col, row) / rowsum;
-					difference += fabs(n.getProbability(col, row) - probability);
+			for(auto& parameter : run.parameters) {
+				std::vector<double> values = reader.readArray<double>();
+				if(values.size() != parameter.size()) {
+					return false;
 				}
-				n.setProbability(probability, col, row);
-				counter++;
+				parameter = std::move(values);
 			}
+		}
+		if(!reader.atEnd()) {
+			return false;
+		}
+		for(auto& run : restored) {
+			run.polynomial.setParameters(run.parameters);
+		}
+		runs = std::move(restored);
+		return true;
+	} catch(const std::invalid_argument&) {
+		return false;
+	}
+}
+
+uint64_t EM::computeDataChecksum() const
+{
+	uint64_t checksum = 0;
+	const bool narrow = observations_.getCodeSize() == sizeof(uint8_t);
+	for(unsigned int row = 0; row < observations_.getRowCount(); row++) {
+		const char* codes =
+		    narrow ? reinterpret_cast<const char*>(
+		                 observations_.rowData<uint8_t>(row))
+		           : reinterpret_cast<const char*>(
+		                 observations_.rowData<uint16_t>(row));
+		checksum ^= computeChecksum(codes, observations_.getColCount() *
+		                                       observations_.getCodeSize()) + row;
+		checksum *= 1099511628211ull;
+		checksum ^= computeChecksum(
+		    reinterpret_cast<const char*>(observations_.missingData(row)),
+		    observations_.getWordCount() * sizeof(uint64_t));
+		checksum *= 1099511628211ull;
+	}
+	checksum ^= computeChecksum(reinterpret_cast<const char*>(weights_.data()),
+	                            weights_.size() * sizeof(unsigned int));
+	return checksum;
+}
+
+void EM::abandonLosingRuns(std::vector<Run>& runs)
+{
+	double best = -std::numeric_limits<double>::infinity();
+	for(const auto& run : runs) {
+		if(!run.abandoned && run.iterations < settings_.minimumIterations &&
+		   isActive(run)) {
+			// Wait until all runs have a meaningful trajectory
+			return;
+		}
+		if(!run.abandoned) {
+			best = std::max(best, run.logLikelihood);
+		}
+	}
+	for(auto& run : runs) {
+		if(!isActive(run) || run.logLikelihood >= best) {
+			continue;
+		}
+		// Geometric extrapolation of the remaining log-likelihood gain
+		// Without a previous gain, e.g. after a rejected extrapolation, the
+		// rate is unknown and the run is kept
+		double remaining = std::numeric_limits<double>::infinity();
+		if(run.improvement <= 0.0) {
+			remaining = 0.0;
+		} else if(run.previousImprovement > 0.0) {
+			double rate = run.improvement / run.previousImprovement;
+			if(rate < 1.0) {
+				remaining = run.improvement * rate / (1.0 - rate);
+			}
+		}
+		if(run.logLikelihood + settings_.abandonFactor * remaining < best) {
+			run.abandoned = true;
+		}
 	}
 }
 
-float EM::mPhase()
+double EM::ePhase(Run& run, unsigned int threads)
+{
+	auto begin = std::chrono::steady_clock::now();
+	double logLikelihood = expectation_.compute(
+	    run.polynomial, observations_, settings_, threads, run.statistics);
+	run.eTimeInMicroSeconds += std::chrono::duration<double, std::micro>(
+	    std::chrono::steady_clock::now() - begin).count();
+	return logLikelihood;
+}
+
+float EM::mPhase(Run& run, unsigned int threads)
 {
-	float difference = 0.0f;
+	auto begin = std::chrono::steady_clock::now();
+	const size_t nodes = run.parameters.size();
+	std::vector<double> differences(nodes, 0.0);
+	std::vector<unsigned int> counters(nodes, 0);
+
+	forEachShard(nodes, threads, [&](size_t id) {
+		differences[id] = run.statistics.maximise(id, run.parameters[id]);
+		counters[id] = run.parameters[id].size();
+	});
+	run.polynomial.setParameters(run.parameters);
+
+	double difference = 0.0;
 	unsigned int counter = 0;
-	for(auto& n : network_.getNodes()) {
-		const Matrix<int>& obMatrix = n.getObservationMatrix();
-		for(unsigned int row = 0; row < obMatrix.getRowCount(); row++)
-			calculateMaximumLikelihood(row, counter, difference, n, obMatrix);
-		n.loadBackup();
+	for(size_t id = 0; id < nodes; id++) {
+		difference += differences[id];
+		counter += counters[id];
 	}
+	run.mTimeInMicroSeconds += std::chrono::duration<double, std::micro>(
+	    std::chrono::steady_clock::now() - begin).count();
 	return difference / counter;
 }
 
 
-void EM::initalise()
+void EM::initalise(Run& run)
 {
-	switch(method_) {
+	switch(run.method) {
 		case 0:
-			initaliseAssumingUniformDistribution();
+			initaliseAssumingUniformDistribution(run.parameters);
 			break;
 		case 1:
-			initaliseAccordingToInitialDistribution();
+			initaliseAccordingToInitialDistribution(run.parameters);
+			break;
+		case WARM_START:
+			initaliseFromInitialParameters(run.parameters);
+			break;
+		default:
+			initaliseRandomly(run.parameters, settings_.seed + run.method - 2);
 			break;
 	}
+	run.polynomial.setParameters(run.parameters);
 }
 
-void EM::initaliseAssumingUniformDistribution()
+void EM::initaliseAssumingUniformDistribution(
+    NetworkPolynomial::Parameters& parameters)
 {
-	for(auto& n : network_.getNodes()) {
-		const Matrix<float>& probMatrix = n.getProbabilityMatrix();
-		for(unsigned int row = 0; row < probMatrix.getRowCount(); row++) {
-			for(unsigned int col = 0; col < probMatrix.getColCount(); col++) {
-				n.setProbability(1.0f / n.getNumberOfUniqueValuesExcludingNA(),
-				                 col, row);
+	for(unsigned int id = 0; id < parameters.size(); id++) {
+		std::fill(parameters[id].begin(), parameters[id].end(),
+		          1.0 / cardinalities_[id]);
+	}
+}
+
+void EM::initaliseRandomly(NetworkPolynomial::Parameters& parameters,
+                           unsigned int seed)
+{
+	std::mt19937 generator(seed);
+	// Uniform over the probability simplex of every CPT row
+	std::exponential_distribution<double> distribution(1.0);
+	for(unsigned int id = 0; id < parameters.size(); id++) {
+		auto& parameter = parameters[id];
+		unsigned int cardinality = cardinalities_[id];
+		for(size_t row = 0; row < parameter.size() / cardinality; row++) {
+			double rowsum = 0.0;
+			for(unsigned int col = 0; col < cardinality; col++) {
+				parameter[col + row * cardinality] = distribution(generator);
+				rowsum += parameter[col + row * cardinality];
+			}
+			for(unsigned int col = 0; col < cardinality; col++) {
+				parameter[col + row * cardinality] /= rowsum;
 			}
 		}
 	}
 }
 
-void EM::initaliseAccordingToInitialDistribution()
+void EM::initaliseAccordingToInitialDistribution(
+    NetworkPolynomial::Parameters& parameters)
 {
 	for(auto& n : network_.getNodes()) {
 		const Matrix<int>& obMatrix = n.getObservationMatrix();
-		const Matrix<float>& probMatrix = n.getProbabilityMatrix();
-		for(unsigned int row = 0; row < probMatrix.getRowCount(); row++) {
-			float rowsum = obMatrix.calculateRowSum(row);
-			for(unsigned int col = 0; col < probMatrix.getColCount(); col++) {
-				if(obMatrix.hasNACol()) {
-					n.setProbability(
-					    n.getObservationMatrix()(col + 1, row) /
-					        (rowsum - n.getObservationMatrix()(0, row)),
-					    col, row);
-				} else {
-					n.setProbability(
-					    n.getObservationMatrix()(col, row) / rowsum, col, row);
-				}
+		auto& parameter = parameters[n.getID()];
+		unsigned int cardinality = cardinalities_[n.getID()];
+		// The NA column is the first column of the observation matrix if the
+		// node has missing values
+		unsigned int offset = n.getNumberOfUniqueValues() !=
+		                              n.getNumberOfUniqueValuesExcludingNA()
+		                          ? 1
+		                          : 0;
+		for(unsigned int row = 0; row < obMatrix.getRowCount(); row++) {
+			double rowsum = 0.0;
+			for(unsigned int col = 0; col < cardinality; col++) {
+				rowsum += obMatrix(col + offset, row);
+			}
+			for(unsigned int col = 0; col < cardinality; col++) {
+				parameter[col + row * cardinality] =
+				    rowsum > 0.0 ? obMatrix(col + offset, row) / rowsum
+				                 : 1.0 / cardinality;
+			}
+		}
+	}
+}
+
+void EM::initaliseFromInitialParameters(
+    NetworkPolynomial::Parameters& parameters)
+{
+	if(initialParameters_.size() != parameters.size()) {
+		throw std::invalid_argument("The initial parameters do not match the network");
+	}
+	for(unsigned int id = 0; id < parameters.size(); id++) {
+		auto& parameter = parameters[id];
+		const auto& initial = initialParameters_[id];
+		unsigned int cardinality = cardinalities_[id];
+		if(initial.size() != parameter.size()) {
+			throw std::invalid_argument("The initial parameters do not match the network");
+		}
+		for(size_t row = 0; row < parameter.size() / cardinality; row++) {
+			double rowsum = 0.0;
+			for(unsigned int col = 0; col < cardinality; col++) {
+				rowsum += std::max(0.0, initial[col + row * cardinality]);
 			}
+			for(unsigned int col = 0; col < cardinality; col++) {
+				double value =
+				    rowsum > 0.0
+				        ? std::max(0.0, initial[col + row * cardinality]) / rowsum
+				        : 1.0 / cardinality;
+				parameter[col + row * cardinality] =
+				    (1.0 - WARM_START_SMOOTHING) * value +
+				    WARM_START_SMOOTHING / cardinality;
+			}
+		}
+	}
+}
+
+void EM::storeParameters(const NetworkPolynomial::Parameters& parameters)
+{
+	for(auto& n : network_.getNodes()) {
+		const auto& parameter = parameters[n.getID()];
+		unsigned int cardinality = cardinalities_[n.getID()];
+		for(unsigned int index = 0; index < parameter.size(); index++) {
+			n.setProbability(parameter[index], index % cardinality,
+			                 index / cardinality);
 		}
 	}
 }
 
 float EM::calculateLikelihoodOfTheData()
 {
-	return probHandler_.calculateLikelihoodOfTheData(observations_);
+	return probHandler_.calculateLikelihoodOfTheData(observations_, weights_);
+}
+
+double EM::getLogLikelihood() const
+{
+	return logLikelihood_;
+}
+
+unsigned int EM::getSelectedMethod() const
+{
+	return method_;
+}
+
+const EMTrace& EM::getTrace() const
+{
+	return trace_;
+}
+
+unsigned int EM::getResumedIterations() const
+{
+	return resumedIterations_;
+}
+
+int EM::getIterationsSaved() const
+{
+	return iterationsSaved_;
+}
+
+const NetworkPolynomial::Parameters& EM::getStatistics() const
+{
+	return statistics_;
+}
+
+unsigned int EM::getNumberOfStatisticsUpdates() const
+{
+	return statisticsUpdates_;
+}
+
+unsigned int EM::getNumberOfAbandonedRuns() const
+{
+	return abandonedRuns_;
+}
+
+unsigned int EM::getNumberOfAcceptedExtrapolations() const
+{
+	return acceptedExtrapolations_;
 }
 
+unsigned int EM::getNumberOfRejectedExtrapolations() const
+{
+	return rejectedExtrapolations_;
+}
 
 int EM::getNumberOfRuns(){
 	return neededRuns_;
@@ -217,4 +814,4 @@ float EM::getDifference(){
 int EM::getTimeInMicroSeconds(){
 	return std::chrono::duration_cast<std::chrono::microseconds>
                              (end-start).count();
-}	
+}
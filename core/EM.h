@@ -1,26 +1,91 @@
 #ifndef EM_H
 #define EM_H
 
+#include "EMSettings.h"
+#include "EMTrace.h"
+#include "ExpectationStep.h"
+#include "NetworkPolynomial.h"
 #include "ProbabilityHandler.h"
 
 #include <cmath>
 #include <chrono>
+#include <limits>
 
 class EM{
 	public:
 	/**
 	 * This class performs the EM algorithm as described in Probablistic Graphical Models by
 	 * Koller & Friedmann.
-	 * The network is fitted given the data using 2 different initialisation techniques. According to
-	 * the log-likelihood, the most probable parameters are chosen.
+	 * The network is fitted given the data using several initialisations: a uniform distribution,
+	 * the distribution of the observed values and a configurable number of random restarts. The
+	 * runs are iterated concurrently in lockstep. Runs whose log-likelihood trajectory can not
+	 * reach the best run are abandoned early. The parameters of the
+	 * run with the highest log-likelihood are kept.
+	 *
+	 * The expected sufficient statistics are accumulated over shards of samples in parallel and
+	 * reduced afterwards. Samples containing missing values contribute their posterior expected
+	 * counts, computed from the derivatives of the network polynomial. The M-step is executed in
+	 * parallel across nodes.
+	 *
+	 * If a batch size is set, the parameters are instead estimated from randomly drawn
+	 * mini-batches using stepwise EM, see OnlineEM.
+	 *
+	 * @param network A reference to the network
+	 * @param observations_ A matrix of type int containing the discretised sample data
+	 * @param differenceThreshold_ The threshold for convergence of the EM algorithm (default is 0.0001)
+	 * @param maxRuns_ The allowed number of iterations for the EM algorithm (default is 10000)
+	 * @param settings Runtime options such as the number of threads and restarts
+	 * @param weights The multiplicity of every sample column, see CompressedObservations. Empty
+	 * if every column is a single sample.
+	 *
+	 */
+	EM(Network& network, Matrix<int>& observations_,float differenceThreshold_ = 0.0001f, unsigned int maxRuns_=10000,
+	   const EMSettings& settings = EMSettings(),
+	   const std::vector<unsigned int>& weights = std::vector<unsigned int>());
+
+	/**
+	 * Warm start: a single run is started from previously learned parameters, e.g. the
+	 * CPTs of the network before the data changed, instead of the default initialisations.
+	 * The parameters are slightly smoothed towards a uniform distribution such that values
+	 * that were impossible before can still be learned.
 	 *
 	 * @param network A reference to the network
 	 * @param observations_ A matrix of type int containing the discretised sample data
+	 * @param initialParameters The parameters to start from, one CPT per node in the layout of
+	 * NetworkPolynomial. If empty, the default initialisations are used.
 	 * @param differenceThreshold_ The threshold for convergence of the EM algorithm (default is 0.0001)
 	 * @param maxRuns_ The allowed number of iterations for the EM algorithm (default is 10000)
+	 * @param settings Runtime options such as the number of threads
+	 * @param weights The multiplicity of every sample column, empty if every column is a single sample
 	 *
 	 */
-	EM(Network& network, Matrix<int>& observations_,float differenceThreshold_ = 0.0001f, unsigned int maxRuns_=10000);	
+	EM(Network& network, Matrix<int>& observations_,
+	   const NetworkPolynomial::Parameters& initialParameters,
+	   float differenceThreshold_ = 0.0001f, unsigned int maxRuns_ = 10000,
+	   const EMSettings& settings = EMSettings(),
+	   const std::vector<unsigned int>& weights = std::vector<unsigned int>());
+
+	/**
+	 * Like the constructors above, for discretised sample data in compact storage.
+	 * The E-step reads the compact codes directly.
+	 *
+	 * @param network A reference to the network
+	 * @param observations The discretised sample data
+	 * @param initialParameters The parameters to start from, empty for the default initialisations
+	 * @param differenceThreshold_ The threshold for convergence of the EM algorithm
+	 * @param maxRuns_ The allowed number of iterations for the EM algorithm
+	 * @param settings Runtime options such as the number of threads and restarts
+	 * @param weights The multiplicity of every sample column, empty if every column is a single sample
+	 *
+	 */
+	EM(Network& network, DiscreteObservations observations,
+	   const NetworkPolynomial::Parameters& initialParameters,
+	   float differenceThreshold_ = 0.0001f, unsigned int maxRuns_ = 10000,
+	   const EMSettings& settings = EMSettings(),
+	   const std::vector<unsigned int>& weights = std::vector<unsigned int>());
+
+	//The method of a run started from given parameters
+	static constexpr unsigned int WARM_START = std::numeric_limits<unsigned int>::max();
 
 	EM& operator=(const EM&) = delete;
 	EM& operator=(EM&&) = delete;
@@ -36,7 +101,14 @@ class EM{
 	float calculateLikelihoodOfTheData();
 
 	/**
-	 * @return The number of executed EM-iterations
+	 * @return The log-likelihood of all samples, including those with missing values,
+	 * computed during the last E-step of the selected run
+	 */
+	double getLogLikelihood() const;
+
+	/**
+	 * @return The number of executed EM-iterations of the selected run, i.e. its
+	 * passes over the data
 	 */
 	int getNumberOfRuns();
 
@@ -50,83 +122,290 @@ class EM{
 	 */
 	int getTimeInMicroSeconds();
 
+	/**
+	 * @return The initialisation of the selected run: 0 uniform, 1 observed distribution,
+	 * 2 and above random restarts, WARM_START for given initial parameters
+	 */
+	unsigned int getSelectedMethod() const;
+
+	/**
+	 * @return The number of runs that have been abandoned early
+	 */
+	unsigned int getNumberOfAbandonedRuns() const;
+
+	/**
+	 * @return The number of accepted SQUAREM extrapolations of the selected run
+	 */
+	unsigned int getNumberOfAcceptedExtrapolations() const;
+
+	/**
+	 * @return The number of SQUAREM extrapolations of the selected run that were
+	 * rejected because they decreased the log-likelihood
+	 */
+	unsigned int getNumberOfRejectedExtrapolations() const;
+
+	/**
+	 * @return The number of EM-iterations of the selected run restored from a
+	 * checkpoint, 0 if the training started from scratch
+	 */
+	unsigned int getResumedIterations() const;
+
+	/**
+	 * @return The EM-iterations of a plain EM run with the initialisation of the
+	 * selected run minus those of the selected run, 0 unless measured, see
+	 * EMSettings::measureIterationsSaved
+	 */
+	int getIterationsSaved() const;
+
+	/**
+	 * @return The steps of all runs, grouped by run in the order of their
+	 * initialisation methods. Iterations restored from a checkpoint and
+	 * mini-batch updates are not part of the trace.
+	 */
+	const EMTrace& getTrace() const;
+
+	/**
+	 * @return The expected sufficient statistics per sample of the selected run,
+	 * computed in its last E-step, or the running statistics of mini-batch EM.
+	 * OnlineEM continues from them.
+	 */
+	const NetworkPolynomial::Parameters& getStatistics() const;
+
+	/**
+	 * @return The number of online updates the statistics correspond to: the
+	 * number of samples after full EM, where every sample contributed a step of
+	 * 1/t, and the number of batches after mini-batch EM
+	 */
+	unsigned int getNumberOfStatisticsUpdates() const;
+
 	private:
+	// State of a single EM run started from one initialisation
+	struct Run
+	{
+		Run(const Network& network, unsigned int method);
+
+		unsigned int method;
+		NetworkPolynomial polynomial;
+		NetworkPolynomial::Parameters parameters;
+		SufficientStatistics statistics;
+		double logLikelihood;
+		double improvement;
+		double previousImprovement;
+		float difference;
+		unsigned int iterations;
+		unsigned int acceptedExtrapolations;
+		unsigned int rejectedExtrapolations;
+		bool converged;
+		bool abandoned;
+		double eTimeInMicroSeconds;
+		double mTimeInMicroSeconds;
+		EMTrace trace;
+	};
+
+	/**
+	 * Executes the ePhase of the EM algorithm. The expected sufficient statistics are
+	 * stored in the statistics of the run.
+	 *
+	 * @param run The run whose parameters are used
+	 * @param threads Number of threads to use
+	 *
+	 * @return The log-likelihood of the data given the current parameters
+	 */
+	double ePhase(Run& run, unsigned int threads);
+
 	/**
-	 * @param n A cost reference to the Node in question
-	 * @param col column of the CPT
-	 * @param row row of the CPT
+	 * Executes the mPhase of the EM algorithm.
 	 *
-	 * @return The probability at the specified position of the CPT
-	 * in the specified node
+	 * @param run The run whose parameters are updated
+	 * @param threads Number of threads to use
+	 *
+	 * @return Difference of the parameters between the current and the previous state
+	 */
+	float mPhase(Run& run, unsigned int threads);
+
+	/**
+	 * Mini-batch EM: the samples are shuffled every epoch and processed in batches
+	 * by stepwise online EM with decaying step sizes.
 	 */
-	float calculateProbabilityEM(Node& n, unsigned int col, unsigned int row);
+	void miniBatchEM();
 
 	/**
-	 * Calculates the expected values for the given row and node. The expected value is
-	 * the expected number of occurrences of certain observations. This is needed in the ePhase
-	 * of the EM algorithm
+	 * Advances the given run by one plain or accelerated step and checks for convergence.
 	 *
-	 * @param row row of the CPT
-	 * @param n A reference to a node
+	 * @param run The run to advance
+	 * @param threads Number of threads to use
 	 */
-	void calculateExpectedValue(unsigned int row, Node& n);
+	void iterate(Run& run, unsigned int threads);
 
 	/**
-	 * Executes the ePhase of the EM algorithm
+	 * Marks the given run as converged if its parameter difference or its relative
+	 * log-likelihood improvement is small enough.
 	 */
-	void ePhase();
+	void checkConvergence(Run& run) const;
 
 	/**
-	 * Performs maximum likelihood estimation for the given node
+	 * Repeats the given run with plain EM steps from the same initialisation.
 	 *
-	 * @param row row of interest
-	 * @param counter a counter for the calculated parameters
-	 * @param difference a reference to the parameter difference
-	 * @param n a reference to the node of interest
-	 * @param obMatrix a const reference to the observation matrix
+	 * @param run The accelerated run to compare with
+	 *
+	 * @return The EM-iterations of the plain run minus those of the given run
 	 */
-	void calculateMaximumLikelihood(unsigned int row, unsigned int& counter, float& difference, Node& n, const Matrix<int> & obMatrix);
+	int measureIterationsSaved(const Run& run);
 
 	/**
-	 * Executes the mPhase of the EM algorithm.
+	 * Performs one E- and M-step for the given run.
 	 *
-	 * @return Difference of the parameters between the current and the previous state
+	 * @param run The run to advance
+	 * @param threads Number of threads to use
+	 */
+	void plainStep(Run& run, unsigned int threads);
+
+	/**
+	 * Performs one SQUAREM cycle (Varadhan & Roland, 2008): two EM steps, a squared
+	 * extrapolation projected onto the probability simplex and a stabilising EM step.
+	 * The extrapolated point is accepted if its log-likelihood is at least the one of
+	 * the second plain EM iterate, otherwise the run continues with a plain EM step
+	 * from that iterate. Every pass over the data counts as one EM-iteration, so a
+	 * cycle takes three iterations at a fixed point and four otherwise.
+	 *
+	 * @param run The run to advance
+	 * @param threads Number of threads to use
+	 */
+	void squaremStep(Run& run, unsigned int threads);
+
+	/**
+	 * Appends a step to the trace of the run.
+	 *
+	 * @param run The run in question
+	 * @param accelerated Whether the step was a SQUAREM cycle
+	 * @param eTime Time spent in the E-phases of the run before the step
+	 * @param mTime Time spent in the M-phases of the run before the step
+	 */
+	void recordStep(Run& run, bool accelerated, double eTime, double mTime);
+
+	/**
+	 * Records a new log-likelihood and the improvement over the previous one.
+	 *
+	 * @param run The run in question
+	 * @param logLikelihood The new log-likelihood
+	 */
+	void updateLikelihood(Run& run, double logLikelihood);
+
+	/**
+	 * @param run The run in question
+	 *
+	 * @return true if the run has neither converged, nor reached the iteration limit,
+	 * nor been abandoned
+	 */
+	bool isActive(const Run& run) const;
+
+	/**
+	 * Marks runs as abandoned if their log-likelihood, extrapolated from the
+	 * last two improvements, can not reach the best run.
+	 *
+	 * @param runs All runs
+	 */
+	void abandonLosingRuns(std::vector<Run>& runs);
+
+	/**
+	 * Iterates all runs in lockstep until every run is finished or abandoned.
+	 *
+	 * @param runs The runs to execute
+	 */
+	void runConcurrently(std::vector<Run>& runs);
+
+	/**
+	 * Writes the state of all runs to the checkpoint file. The file is replaced
+	 * atomically, thus an interrupted write keeps the previous checkpoint.
+	 */
+	void writeCheckpoint(const std::vector<Run>& runs) const;
+
+	/**
+	 * Restores the state of the runs from the checkpoint file.
+	 *
+	 * @return true if a valid checkpoint for the same data and runs was found
 	 */
-	float mPhase();
+	bool readCheckpoint(std::vector<Run>& runs);
+
+	/**
+	 * @return A hash of the observations, used to match checkpoints to their data
+	 */
+	uint64_t computeDataChecksum() const;
 
 	/**
 	 * Calls different initialisation methods.
+	 *
+	 * @param run The run to initialise according to its method
 	 */
-	void initalise();
+	void initalise(Run& run);
 
 	/**
 	 * Initialises all parameters assuming an equal distribution.
 	 */
-	void initaliseAssumingUniformDistribution();
+	void initaliseAssumingUniformDistribution(NetworkPolynomial::Parameters& parameters);
 
 	/**
 	 * Initialises all parameters using MLE for the observed values.
 	 */
-	void initaliseAccordingToInitialDistribution();
+	void initaliseAccordingToInitialDistribution(NetworkPolynomial::Parameters& parameters);
 
-	std::pair<float, unsigned int> runEMIterations_();
-	unsigned int getMaxMethod_();
+	/**
+	 * Initialises all parameters with random distributions.
+	 *
+	 * @param seed Seed of the random number generator
+	 */
+	void initaliseRandomly(NetworkPolynomial::Parameters& parameters, unsigned int seed);
+
+	/**
+	 * Initialises all parameters from the initial parameters given to the constructor.
+	 */
+	void initaliseFromInitialParameters(NetworkPolynomial::Parameters& parameters);
+
+	/**
+	 * Copies the given parameters into the probability matrices of the nodes.
+	 */
+	void storeParameters(const NetworkPolynomial::Parameters& parameters);
 
 	//A reference to the network
 	Network& network_;
-	//The initialisation method
+	//The initialisation method of the selected run
 	unsigned int method_;
 	//The discretised observations
-	Matrix<int>& observations_;
+	DiscreteObservations observations_;
 	//An instance of the probabilityHandler
 	ProbabilityHandler probHandler_;
+	//Runtime options
+	EMSettings settings_;
+	//Parameters to warm start from, empty for the default initialisations
+	NetworkPolynomial::Parameters initialParameters_;
+	//Multiplicity of every sample column, empty if every column is a single sample
+	std::vector<unsigned int> weights_;
+	//Computes the expected sufficient statistics
+	ExpectationStep expectation_;
+	//Number of values of every node
+	std::vector<unsigned int> cardinalities_;
 	//The parameter difference
 	float differenceThreshold_;
 	//Fields dealing with run information
 	unsigned int maxRuns_;
 	int neededRuns_;	
+	unsigned int abandonedRuns_;
+	//Acceleration statistics of the selected run
+	unsigned int acceptedExtrapolations_;
+	unsigned int rejectedExtrapolations_;
+	//Iterations of the selected run restored from a checkpoint
+	unsigned int resumedIterations_;
+	//Measured EM-iterations saved by the acceleration
+	int iterationsSaved_;
+	//Telemetry of all runs
+	EMTrace trace_;
+	//Statistics per sample of the selected run, see getStatistics
+	NetworkPolynomial::Parameters statistics_;
+	unsigned int statisticsUpdates_;
 	//The resulting parameter difference
 	float finalDifference_;
+	//The log-likelihood computed in the last E-step
+	double logLikelihood_;
 	//c++11 time measuring
 	std::chrono::time_point<std::chrono::system_clock> start;
 	std::chrono::time_point<std::chrono::system_clock> end;
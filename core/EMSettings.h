@@ -0,0 +1,104 @@
+#ifndef EMSETTINGS_H
+#define EMSETTINGS_H
+
+#include <string>
+
+/**
+ * Options controlling how the EM algorithm is executed.
+ */
+struct EMSettings
+{
+	/**
+	 * If larger than 0, a run also converges once the relative change of its
+	 * log-likelihood falls below this value.
+	 */
+	double likelihoodTolerance = 0.0;
+
+	/**
+	 * Enables SQUAREM acceleration of the EM iterations.
+	 */
+	bool accelerate = false;
+
+	/**
+	 * If set together with accelerate, the selected run is repeated without
+	 * acceleration after the training to measure the EM-iterations the
+	 * acceleration saved, see EM::getIterationsSaved.
+	 */
+	bool measureIterationsSaved = false;
+
+	/**
+	 * Number of threads used for the E- and M-step, 0 to use all cores.
+	 */
+	unsigned int threads = 0;
+
+	/**
+	 * If set, the samples are split into shards of a fixed size and the
+	 * statistics of the shards are reduced in a fixed order. The results are
+	 * then bit-identical regardless of the number of threads. Otherwise every
+	 * thread accumulates one contiguous range of samples, which needs less
+	 * memory but the result depends on the number of threads.
+	 */
+	bool deterministic = true;
+
+	/**
+	 * Number of samples per shard in deterministic mode.
+	 */
+	unsigned int shardSize = 4096;
+
+	/**
+	 * Number of randomly initialised runs started in addition to the uniform
+	 * and the observed distribution.
+	 */
+	unsigned int randomRestarts = 2;
+
+	/**
+	 * Seed of the random initialisations and of the mini-batch sampling.
+	 * Restart i uses seed + i.
+	 */
+	unsigned int seed = 0;
+
+	/**
+	 * Number of iterations every run performs before it may be abandoned.
+	 */
+	unsigned int minimumIterations = 3;
+
+	/**
+	 * The remaining log-likelihood gain of a run is extrapolated geometrically
+	 * from its last two improvements. A run is abandoned if its log-likelihood
+	 * plus this factor times the remaining gain stays below the best run.
+	 */
+	double abandonFactor = 1.0;
+
+	/**
+	 * Step size schedule of online EM: eta_t = (t + stepSizeOffset)^(-stepSizeDecay).
+	 * The decay should be in (0.5, 1] for convergence, the offset at least 1.
+	 */
+	double stepSizeDecay = 0.7;
+	double stepSizeOffset = 2.0;
+
+	/**
+	 * If larger than 0, EM processes randomly drawn mini-batches of this size
+	 * using the online step size schedule instead of full passes over the data.
+	 */
+	unsigned int batchSize = 0;
+
+	/**
+	 * Number of passes over the data in mini-batch mode, may be fractional.
+	 */
+	double epochs = 1.0;
+
+	/**
+	 * If not empty, EM periodically writes the state of its runs to this file
+	 * and resumes from it if a valid checkpoint for the same data exists. The
+	 * file is removed once all runs converged, runs stopped by the iteration
+	 * limit can be continued with a higher limit.
+	 */
+	std::string checkpointFile;
+
+	/**
+	 * Number of iterations of the concurrent runs between two checkpoints.
+	 */
+	unsigned int checkpointInterval = 10;
+};
+
+#endif
@@ -0,0 +1,29 @@
+#ifndef EMTRACE_H
+#define EMTRACE_H
+
+#include <vector>
+
+/**
+ * Telemetry of a single step of an EM run. A step is one plain EM-iteration
+ * or one SQUAREM cycle of three or four EM-iterations.
+ */
+struct EMIteration
+{
+	//Initialisation method of the run, see EM::getSelectedMethod
+	unsigned int method;
+	//Number of EM-iterations of the run after this step
+	unsigned int iteration;
+	//Whether the step was a SQUAREM cycle
+	bool accelerated;
+	//Time spent in the E- and M-phases of this step
+	double eTimeInMicroSeconds;
+	double mTimeInMicroSeconds;
+	//Mean absolute parameter change of the step
+	float difference;
+	//Log-likelihood computed in the last E-phase of the step
+	double logLikelihood;
+};
+
+using EMTrace = std::vector<EMIteration>;
+
+#endif
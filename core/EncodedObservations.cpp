@@ -0,0 +1,320 @@
+#include "EncodedObservations.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <sstream>
+#include <unordered_map>
+
+const uint32_t EncodedObservations::NA_CODE =
+    std::numeric_limits<uint32_t>::max();
+const size_t EncodedObservations::MAXIMUM_DICTIONARY_SIZE = 1024;
+
+namespace {
+
+bool isNAToken(const char* begin, const char* end)
+{
+	static const char* const representations[] = {"NA", "na", "-", "/"};
+	size_t length = end - begin;
+	for(const char* na : representations) {
+		if(length == std::strlen(na) && std::equal(begin, end, na)) {
+			return true;
+		}
+	}
+	return false;
+}
+
+// Converts a token like the discretisations always did: the leading number
+// of the token is used, tokens without one yield 0. Returns whether the
+// whole token is a finite number.
+bool leadingNumber(const std::string& token, float& number)
+{
+	const char* begin = token.data();
+	const char* end = begin + token.size();
+	double value = 0.0;
+	const char* last = parseLeadingNumber(begin, end, value);
+	if(last == begin) {
+		value = 0.0;
+	}
+	const double largest = std::numeric_limits<float>::max();
+	number = static_cast<float>(std::max(-largest, std::min(largest, value)));
+	return last != begin && last == end;
+}
+
+}
+
+EncodedObservations::EncodedObservations() : colCount_(0) {}
+
+EncodedObservations::EncodedObservations(
+    const std::string& filename,
+    const std::vector<unsigned int>& deletedSamples, unsigned int threads)
+    : colCount_(0)
+{
+	load(filename, deletedSamples, threads, nullptr);
+}
+
+EncodedObservations::EncodedObservations(
+    const std::string& filename, FeatureHandler& handler,
+    const std::vector<unsigned int>& deletedSamples, unsigned int threads)
+    : colCount_(0)
+{
+	load(filename, deletedSamples, threads, &handler);
+}
+
+void EncodedObservations::load(const std::string& filename,
+                               const std::vector<unsigned int>& deletedSamples,
+                               unsigned int threads, FeatureHandler* handler)
+{
+	MappedFile file(filename);
+	const char* begin = file.data();
+	const char* end = begin + file.size();
+
+	// The first row determines the number of samples
+	std::vector<TextToken> tokens;
+	size_t firstLine = 1;
+	const char* body = begin;
+	while(body < end) {
+		const char* lineEnd = findLineEnd(body, end);
+		splitLine(body, lineEnd, tokens);
+		if(!tokens.empty()) {
+			break;
+		}
+		body = lineEnd < end ? lineEnd + 1 : end;
+		firstLine++;
+	}
+	const size_t numCols = tokens.empty() ? 0 : tokens.size() - 1;
+
+	std::vector<bool> deleted(numCols, false);
+	for(auto sample : deletedSamples) {
+		if(sample >= numCols) {
+			throw std::invalid_argument(
+			    "Attempted to delete a sample that is not present in the "
+			    "matrix.");
+		}
+		deleted[sample] = true;
+	}
+	colCount_ = std::count(deleted.begin(), deleted.end(), false);
+
+	TextChunks chunks = indexChunks(body, end, firstLine, threads);
+	const size_t numRows = chunks.firstRow.back();
+	rowNames_.resize(numRows);
+	features_.resize(numRows);
+	if(handler != nullptr) {
+		handler->initialise(*this);
+	}
+	// Line of the first row with a wrong number of samples in every chunk
+	std::vector<size_t> invalidLine(chunks.size(), 0);
+	forEachShard(chunks.size(), threads, [&](size_t chunk) {
+		std::vector<TextToken> tokens;
+		std::vector<TextToken> samples;
+		size_t row = chunks.firstRow[chunk];
+		size_t line = chunks.firstLine[chunk] - 1;
+		forEachLine(chunks.boundaries[chunk], chunks.boundaries[chunk + 1],
+		            [&](const char* lineBegin, const char* lineEnd) {
+			line++;
+			splitLine(lineBegin, lineEnd, tokens);
+			if(tokens.empty() || invalidLine[chunk] != 0) {
+				return;
+			}
+			if(tokens.size() != numCols + 1) {
+				invalidLine[chunk] = line;
+				return;
+			}
+			rowNames_[row].assign(tokens[0].first, tokens[0].second);
+			samples.clear();
+			for(size_t col = 0; col < numCols; col++) {
+				if(!deleted[col]) {
+					samples.push_back(tokens[col + 1]);
+				}
+			}
+			encode(samples, features_[row],
+			       handler == nullptr || handler->needsTokens(*this, row));
+			if(handler != nullptr) {
+				handler->process(*this, row);
+				features_[row] = Feature();
+			}
+			row++;
+		});
+	});
+	for(auto line : invalidLine) {
+		if(line != 0) {
+			throw std::invalid_argument("Row " + std::to_string(line) + " does not contain the specified number of samples");
+		}
+	}
+}
+
+EncodedObservations::EncodedObservations(const Matrix<std::string>& observations)
+    : rowNames_(observations.getRowNames()),
+      colNames_(observations.getColNames()),
+      colCount_(observations.getColCount()),
+      features_(observations.getRowCount())
+{
+	rowNames_.resize(observations.getRowCount());
+	std::vector<TextToken> tokens(colCount_);
+	for(unsigned int row = 0; row < observations.getRowCount(); row++) {
+		for(unsigned int col = 0; col < colCount_; col++) {
+			const std::string& value = observations(col, row);
+			tokens[col] = TextToken(value.data(), value.data() + value.size());
+		}
+		encode(tokens, features_[row], true);
+	}
+}
+
+void EncodedObservations::encode(const std::vector<TextToken>& tokens,
+                                 Feature& feature, bool keepTokens)
+{
+	std::unordered_map<std::string, uint32_t> codes;
+	std::string key;
+	feature.codes.resize(tokens.size());
+	for(size_t col = 0; col < tokens.size(); col++) {
+		const TextToken& token = tokens[col];
+		if(isNAToken(token.first, token.second)) {
+			feature.codes[col] = NA_CODE;
+			continue;
+		}
+		key.assign(token.first, token.second);
+		auto it = codes.find(key);
+		if(it == codes.end()) {
+			it = codes.emplace(key, feature.dictionary.size()).first;
+			feature.dictionary.push_back(key);
+		}
+		feature.codes[col] = it->second;
+	}
+
+	bool numeric = true;
+	feature.dictionaryNumbers.resize(feature.dictionary.size());
+	for(size_t code = 0; code < feature.dictionary.size(); code++) {
+		numeric = leadingNumber(feature.dictionary[code],
+		                        feature.dictionaryNumbers[code]) &&
+		          numeric;
+	}
+
+	// Continuous features are not worth a dictionary, unless their values are
+	// named after the tokens
+	if(!keepTokens && numeric &&
+	   feature.dictionary.size() > MAXIMUM_DICTIONARY_SIZE) {
+		feature.numbers.resize(tokens.size());
+		for(size_t col = 0; col < tokens.size(); col++) {
+			uint32_t code = feature.codes[col];
+			feature.numbers[col] = code == NA_CODE
+			                           ? std::numeric_limits<float>::quiet_NaN()
+			                           : feature.dictionaryNumbers[code];
+		}
+		std::vector<std::string>().swap(feature.dictionary);
+		std::vector<float>().swap(feature.dictionaryNumbers);
+		std::vector<uint32_t>().swap(feature.codes);
+	}
+}
+
+size_t EncodedObservations::getRowCount() const { return features_.size(); }
+
+size_t EncodedObservations::getColCount() const { return colCount_; }
+
+const std::vector<std::string>& EncodedObservations::getRowNames() const
+{
+	return rowNames_;
+}
+
+const std::vector<std::string>& EncodedObservations::getColNames() const
+{
+	return colNames_;
+}
+
+bool EncodedObservations::isNumeric(unsigned int row) const
+{
+	return !features_[row].numbers.empty();
+}
+
+bool EncodedObservations::isNA(unsigned int col, unsigned int row) const
+{
+	const Feature& feature = features_[row];
+	if(!feature.numbers.empty()) {
+		return std::isnan(feature.numbers[col]);
+	}
+	return feature.codes[col] == NA_CODE;
+}
+
+size_t EncodedObservations::countNA(unsigned int row) const
+{
+	const Feature& feature = features_[row];
+	if(!feature.numbers.empty()) {
+		return std::count_if(feature.numbers.begin(), feature.numbers.end(),
+		                     [](float value) { return std::isnan(value); });
+	}
+	return std::count(feature.codes.begin(), feature.codes.end(), NA_CODE);
+}
+
+boost::optional<float> EncodedObservations::getNumber(unsigned int col,
+                                                      unsigned int row) const
+{
+	const Feature& feature = features_[row];
+	if(!feature.numbers.empty()) {
+		float value = feature.numbers[col];
+		if(std::isnan(value)) {
+			return boost::none;
+		}
+		return value;
+	}
+	uint32_t code = feature.codes[col];
+	if(code == NA_CODE) {
+		return boost::none;
+	}
+	return feature.dictionaryNumbers[code];
+}
+
+std::string EncodedObservations::getValue(unsigned int col,
+                                          unsigned int row) const
+{
+	const Feature& feature = features_[row];
+	if(isNA(col, row)) {
+		return "NA";
+	}
+	if(!feature.numbers.empty()) {
+		std::ostringstream os;
+		os << feature.numbers[col];
+		return os.str();
+	}
+	return feature.dictionary[feature.codes[col]];
+}
+
+std::vector<std::string>
+EncodedObservations::getUniqueRowValues(unsigned int row) const
+{
+	const Feature& feature = features_[row];
+	std::vector<std::string> values = feature.dictionary;
+	if(!feature.numbers.empty()) {
+		std::vector<float> numbers;
+		for(auto value : feature.numbers) {
+			if(!std::isnan(value)) {
+				numbers.push_back(value);
+			}
+		}
+		std::sort(numbers.begin(), numbers.end());
+		numbers.erase(std::unique(numbers.begin(), numbers.end()),
+		              numbers.end());
+		for(auto value : numbers) {
+			std::ostringstream os;
+			os << value;
+			values.push_back(os.str());
+		}
+	}
+	if(countNA(row) > 0) {
+		values.push_back("NA");
+	}
+	std::sort(values.begin(), values.end());
+	values.erase(std::unique(values.begin(), values.end()), values.end());
+	return values;
+}
+
+const std::vector<std::string>&
+EncodedObservations::getDictionary(unsigned int row) const
+{
+	return features_[row].dictionary;
+}
+
+const std::vector<uint32_t>&
+EncodedObservations::getCodes(unsigned int row) const
+{
+	return features_[row].codes;
+}
@@ -0,0 +1,261 @@
+#ifndef ENCODEDOBSERVATIONS_H
+#define ENCODEDOBSERVATIONS_H
+
+#include "Matrix.h"
+
+#include <boost/optional/optional.hpp>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * Raw sample data, one feature per row and one sample per column, stored
+ * column-compressed per feature instead of one string per cell.
+ *
+ * The tokens of a feature are interned into a dictionary and every cell
+ * stores the 4 byte code of its token. Numeric features with more distinct
+ * values than MAXIMUM_DICTIONARY_SIZE are stored as a parsed float column
+ * instead if a FeatureHandler does not need their tokens, otherwise every
+ * feature keeps its tokens. The NA representations "NA", "na", "-" and "/"
+ * are unified while encoding.
+ */
+class EncodedObservations
+{
+	public:
+	//Code of a missing value
+	static const uint32_t NA_CODE;
+	//Largest dictionary kept for a numeric feature
+	static const size_t MAXIMUM_DICTIONARY_SIZE;
+
+	/**
+	 * Receives the features of a file while it is parsed, see the streaming
+	 * constructor.
+	 */
+	class FeatureHandler
+	{
+		public:
+		virtual ~FeatureHandler() = default;
+
+		/**initialise
+		 *
+		 * @param observations, the observations being parsed. The numbers of
+		 * features and samples are known, no feature has been parsed yet.
+		 */
+		virtual void initialise(const EncodedObservations& observations) = 0;
+
+		/**needsTokens
+		 *
+		 * @param observations, the observations being parsed
+		 * @param row, index of the feature that is about to be encoded
+		 *
+		 * @return true, if the original tokens of the feature are needed,
+		 * e.g. to name its values. Otherwise a numeric feature with many
+		 * distinct values is stored as float column. Only the name of the
+		 * feature is available. Different features are checked concurrently.
+		 */
+		virtual bool needsTokens(const EncodedObservations& observations,
+		                         unsigned int row)
+		{
+			return true;
+		}
+
+		/**process
+		 *
+		 * @param observations, the observations being parsed
+		 * @param row, index of the feature that has just been parsed
+		 *
+		 * Only the given feature and its name are available. Different
+		 * features are processed concurrently.
+		 */
+		virtual void process(const EncodedObservations& observations,
+		                     unsigned int row) = 0;
+	};
+
+	/**EncodedObservations
+	 *
+	 * @return EncodedObservations object without any features
+	 */
+	EncodedObservations();
+
+	/**EncodedObservations
+	 *
+	 * @param filename, a tab or space delimited file containing one feature
+	 * per line, starting with the name of the feature
+	 * @param deletedSamples, zero based indices of samples that should not be
+	 * read
+	 * @param threads, number of threads used for parsing, 0 to use all cores
+	 *
+	 * @return EncodedObservations object
+	 *
+	 * The file is memory mapped, large files are split into chunks of whole
+	 * lines that are encoded in parallel.
+	 */
+	explicit EncodedObservations(
+	    const std::string& filename,
+	    const std::vector<unsigned int>& deletedSamples = {},
+	    unsigned int threads = 0);
+
+	/**EncodedObservations
+	 *
+	 * @param observations, the raw sample data, one feature per row
+	 *
+	 * @return EncodedObservations object holding the same data
+	 */
+	explicit EncodedObservations(const Matrix<std::string>& observations);
+
+	/**EncodedObservations
+	 *
+	 * @param filename, a tab or space delimited file containing one feature
+	 * per line, starting with the name of the feature
+	 * @param handler, receives every feature as soon as it has been parsed
+	 * @param deletedSamples, zero based indices of samples that should not be
+	 * read
+	 * @param threads, number of threads used for parsing, 0 to use all cores
+	 *
+	 * @return EncodedObservations object holding the names of the features,
+	 * but not their values
+	 *
+	 * Streaming variant of the file constructor: every feature is released
+	 * once the handler has processed it, so only the features currently
+	 * parsed by the threads are held in memory.
+	 */
+	EncodedObservations(const std::string& filename, FeatureHandler& handler,
+	                    const std::vector<unsigned int>& deletedSamples = {},
+	                    unsigned int threads = 0);
+
+	/**getRowCount
+	 *
+	 * @return the number of features
+	 */
+	size_t getRowCount() const;
+
+	/**getColCount
+	 *
+	 * @return the number of samples
+	 */
+	size_t getColCount() const;
+
+	/**getRowNames
+	 *
+	 * @return the names of the features
+	 */
+	const std::vector<std::string>& getRowNames() const;
+
+	/**getColNames
+	 *
+	 * @return the names of the samples, empty if the samples are unnamed
+	 */
+	const std::vector<std::string>& getColNames() const;
+
+	/**isNumeric
+	 *
+	 * @param row, index of the feature
+	 *
+	 * @return true, if the feature is stored as float column without dictionary
+	 */
+	bool isNumeric(unsigned int row) const;
+
+	/**isNA
+	 *
+	 * @param col, index of the sample
+	 * @param row, index of the feature
+	 *
+	 * @return true, if the value is missing
+	 */
+	bool isNA(unsigned int col, unsigned int row) const;
+
+	/**countNA
+	 *
+	 * @param row, index of the feature
+	 *
+	 * @return the number of missing values of the feature
+	 */
+	size_t countNA(unsigned int row) const;
+
+	/**getNumber
+	 *
+	 * @param col, index of the sample
+	 * @param row, index of the feature
+	 *
+	 * @return the numeric value of the cell, none if it is missing. Tokens
+	 * are converted like by an input stream, i.e. the leading number of a
+	 * token is used and tokens not starting with a number yield 0.
+	 */
+	boost::optional<float> getNumber(unsigned int col, unsigned int row) const;
+
+	/**getValue
+	 *
+	 * @param col, index of the sample
+	 * @param row, index of the feature
+	 *
+	 * @return the token of the cell, "NA" if it is missing. Values of numeric
+	 * features are formatted like by an output stream.
+	 */
+	std::string getValue(unsigned int col, unsigned int row) const;
+
+	/**getUniqueRowValues
+	 *
+	 * @param row, index of the feature
+	 *
+	 * @return the sorted distinct tokens of the feature, including "NA" if a
+	 * value is missing
+	 */
+	std::vector<std::string> getUniqueRowValues(unsigned int row) const;
+
+	/**getDictionary
+	 *
+	 * @param row, index of the feature
+	 *
+	 * @return the distinct tokens of the feature in order of their first
+	 * occurrence, empty for numeric features
+	 */
+	const std::vector<std::string>& getDictionary(unsigned int row) const;
+
+	/**getCodes
+	 *
+	 * @param row, index of the feature
+	 *
+	 * @return the dictionary code of every sample, NA_CODE for missing values.
+	 * Empty for numeric features.
+	 */
+	const std::vector<uint32_t>& getCodes(unsigned int row) const;
+
+	private:
+	// A single feature, either dictionary encoded or a float column
+	struct Feature
+	{
+		std::vector<std::string> dictionary;
+		//Numeric value of every dictionary entry
+		std::vector<float> dictionaryNumbers;
+		std::vector<uint32_t> codes;
+		//Values of numeric features, NaN for missing values
+		std::vector<float> numbers;
+	};
+
+	/**load
+	 *
+	 * Parses a file as described for the file constructors, handler may be a
+	 * nullptr
+	 */
+	void load(const std::string& filename,
+	          const std::vector<unsigned int>& deletedSamples,
+	          unsigned int threads, FeatureHandler* handler);
+
+	/**encode
+	 *
+	 * @param tokens, the tokens of a feature, one per sample
+	 * @param feature, receives the encoded feature
+	 * @param keepTokens, true if the dictionary must be kept even if the
+	 * feature is numeric and has many distinct values
+	 */
+	static void encode(const std::vector<TextToken>& tokens, Feature& feature,
+	                   bool keepTokens);
+
+	std::vector<std::string> rowNames_;
+	std::vector<std::string> colNames_;
+	size_t colCount_;
+	std::vector<Feature> features_;
+};
+
+#endif
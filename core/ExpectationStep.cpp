@@ -0,0 +1,200 @@
+#include "ExpectationStep.h"
+#include "Parallel.h"
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+
+ExpectationStep::ExpectationStep(const Network& network)
+{
+	for(const auto& n : network.getNodes()) {
+		const Matrix<float>& probMatrix = n.getProbabilityMatrix();
+		observationRows_.push_back(n.getObservationRow());
+		parents_.push_back(n.getParents());
+		std::vector<unsigned int> factors;
+		for(unsigned int i = 0; i < n.getNumberOfParents(); i++) {
+			factors.push_back(n.getFactor(i));
+		}
+		factors_.push_back(factors);
+		cardinalities_.push_back(probMatrix.getColCount());
+		sizes_.push_back(probMatrix.getColCount() * probMatrix.getRowCount());
+	}
+}
+
+SufficientStatistics ExpectationStep::createEmptyStatistics() const
+{
+	return SufficientStatistics(cardinalities_, sizes_);
+}
+
+void ExpectationStep::setWeights(const std::vector<unsigned int>& weights)
+{
+	weights_ = weights;
+}
+
+const std::vector<unsigned int>& ExpectationStep::getCardinalities() const
+{
+	return cardinalities_;
+}
+
+double ExpectationStep::accumulate(const NetworkPolynomial& polynomial,
+                                   const DiscreteObservations& observations,
+                                   size_t begin, size_t end,
+                                   SufficientStatistics& statistics) const
+{
+	if(observations.getCodeSize() == sizeof(uint8_t)) {
+		return accumulate<uint8_t>(polynomial, observations, nullptr, begin,
+		                           end, statistics);
+	}
+	return accumulate<uint16_t>(polynomial, observations, nullptr, begin, end,
+	                            statistics);
+}
+
+template <typename Code>
+double ExpectationStep::accumulate(const NetworkPolynomial& polynomial,
+                                   const DiscreteObservations& observations,
+                                   const unsigned int* sampleIndices, size_t begin,
+                                   size_t end,
+                                   SufficientStatistics& statistics) const
+{
+	const auto& parameters = polynomial.getParameters();
+	std::vector<double*> counts;
+	for(unsigned int id = 0; id < observationRows_.size(); id++) {
+		counts.push_back(statistics.data(id));
+	}
+
+	// Incomplete samples with identical evidence share their posterior
+	std::map<std::vector<int>, unsigned int> incomplete;
+	std::vector<int> evidence(observationRows_.size());
+	// Blocks of samples are scanned sample by sample in sample-major order
+	std::vector<Code> codes;
+	std::vector<uint64_t> missing;
+	const size_t stride = observationRows_.size();
+	double logLikelihood = 0.0;
+	for(size_t block = begin; block < end;
+	    block += DiscreteObservations::SAMPLE_BLOCK_SIZE) {
+		const size_t blockEnd =
+		    std::min(end, block + DiscreteObservations::SAMPLE_BLOCK_SIZE);
+		observations.transpose(observationRows_, sampleIndices, block, blockEnd,
+		                       codes, missing);
+		for(size_t s = 0; s < blockEnd - block; s++) {
+			size_t sample =
+			    sampleIndices == nullptr ? block + s : sampleIndices[block + s];
+			unsigned int weight = weights_.empty() ? 1 : weights_[sample];
+			const Code* values = codes.data() + s * stride;
+
+			if(DiscreteObservations::isSet(missing.data(), s)) {
+				for(unsigned int id = 0; id < stride; id++) {
+					evidence[id] =
+					    observations.isMissing(sample, observationRows_[id])
+					        ? DiscreteObservations::NA
+					        : values[id];
+				}
+				incomplete[evidence] += weight;
+				continue;
+			}
+
+			// Observed counts
+			for(unsigned int id = 0; id < stride; id++) {
+				unsigned int row = 0;
+				for(unsigned int i = 0; i < parents_[id].size(); i++) {
+					row += factors_[id][i] * values[parents_[id][i]];
+				}
+				unsigned int index = values[id] + row * cardinalities_[id];
+				counts[id][index] += weight;
+				logLikelihood += weight * std::log(parameters[id][index]);
+			}
+		}
+	}
+
+	// Expected counts: theta * dP(e)/dtheta / P(e)
+	NetworkPolynomial::Parameters derivatives;
+	for(const auto& entry : incomplete) {
+		double probability = polynomial.differentiate(entry.first, derivatives);
+		logLikelihood += entry.second * std::log(probability);
+		if(probability <= 0.0) {
+			continue;
+		}
+		double scale = entry.second / probability;
+		for(unsigned int id = 0; id < derivatives.size(); id++) {
+			const auto& derivative = derivatives[id];
+			const auto& parameter = parameters[id];
+			double* statistic = counts[id];
+			for(unsigned int k = 0; k < derivative.size(); k++) {
+				statistic[k] += scale * parameter[k] * derivative[k];
+			}
+		}
+	}
+	return logLikelihood;
+}
+
+double ExpectationStep::compute(const NetworkPolynomial& polynomial,
+                                const DiscreteObservations& observations,
+                                const EMSettings& settings, unsigned int threads,
+                                SufficientStatistics& statistics) const
+{
+	return compute(polynomial, observations, 0, observations.getColCount(),
+	               settings, threads, statistics);
+}
+
+double ExpectationStep::compute(const NetworkPolynomial& polynomial,
+                                const DiscreteObservations& observations, size_t begin,
+                                size_t end, const EMSettings& settings,
+                                unsigned int threads,
+                                SufficientStatistics& statistics) const
+{
+	return compute(polynomial, observations, nullptr, begin, end, settings,
+	               threads, statistics);
+}
+
+double ExpectationStep::compute(const NetworkPolynomial& polynomial,
+                                const DiscreteObservations& observations,
+                                const std::vector<unsigned int>& samples,
+                                const EMSettings& settings, unsigned int threads,
+                                SufficientStatistics& statistics) const
+{
+	return compute(polynomial, observations, samples.data(), 0, samples.size(),
+	               settings, threads, statistics);
+}
+
+double ExpectationStep::compute(const NetworkPolynomial& polynomial,
+                                const DiscreteObservations& observations,
+                                const unsigned int* sampleIndices, size_t begin,
+                                size_t end, const EMSettings& settings,
+                                unsigned int threads,
+                                SufficientStatistics& statistics) const
+{
+	const size_t samples = end - begin;
+	threads = getNumberOfThreads(threads);
+	size_t shards = 1;
+	if(settings.deterministic) {
+		size_t shardSize = std::max(1u, settings.shardSize);
+		shards = std::max<size_t>(1, (samples + shardSize - 1) / shardSize);
+	} else {
+		shards = std::max<size_t>(1, std::min<size_t>(threads, samples));
+	}
+
+	std::vector<SufficientStatistics> shardStatistics(
+	    shards, createEmptyStatistics());
+	std::vector<double> shardLikelihood(shards, 0.0);
+	forEachShard(shards, threads, [&](size_t shard) {
+		auto range = getShardRange(samples, shards, shard);
+		if(observations.getCodeSize() == sizeof(uint8_t)) {
+			shardLikelihood[shard] = accumulate<uint8_t>(
+			    polynomial, observations, sampleIndices, begin + range.first,
+			    begin + range.second, shardStatistics[shard]);
+		} else {
+			shardLikelihood[shard] = accumulate<uint16_t>(
+			    polynomial, observations, sampleIndices, begin + range.first,
+			    begin + range.second, shardStatistics[shard]);
+		}
+	});
+
+	// Reduction in shard order
+	statistics = std::move(shardStatistics[0]);
+	double logLikelihood = shardLikelihood[0];
+	for(size_t shard = 1; shard < shards; shard++) {
+		statistics.add(shardStatistics[shard]);
+		logLikelihood += shardLikelihood[shard];
+	}
+	return logLikelihood;
+}
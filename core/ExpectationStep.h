@@ -0,0 +1,153 @@
+#ifndef EXPECTATIONSTEP_H
+#define EXPECTATIONSTEP_H
+
+#include "DiscreteObservations.h"
+#include "EMSettings.h"
+#include "NetworkPolynomial.h"
+#include "SufficientStatistics.h"
+
+/**
+ * This class computes the expected sufficient statistics of a set of
+ * discretised samples, i.e. the expected number of occurrences of every CPT
+ * entry. Complete samples contribute their observed counts. Samples with
+ * missing values contribute theta * dP(e)/dtheta / P(e), obtained from the
+ * derivatives of the network polynomial. Incomplete samples with the same
+ * evidence are evaluated once.
+ *
+ * These are the exact posteriors given all observed values of a sample. The
+ * E-step before distributed the missing values of every node by its own CPT
+ * row and ignored observed children, so EM now yields different parameters
+ * whenever a node with observed descendants is missing.
+ *
+ * The samples are split into shards that are processed in parallel. The
+ * statistics of the shards are reduced in shard order.
+ */
+class ExpectationStep
+{
+	public:
+	/**ExpectationStep
+	 *
+	 * @param network, a const reference to a network whose observations have
+	 * been assigned to the nodes
+	 *
+	 * @return ExpectationStep object
+	 */
+	explicit ExpectationStep(const Network& network);
+
+	/**compute
+	 *
+	 * @param polynomial, the network polynomial holding the current parameters
+	 * @param observations, discretised samples, one row per feature
+	 * @param settings, determinism and shard size of the computation
+	 * @param threads, number of threads to use, 0 for all cores
+	 * @param statistics, receives the expected sufficient statistics
+	 *
+	 * @return the log-likelihood of the samples
+	 */
+	double compute(const NetworkPolynomial& polynomial,
+	               const DiscreteObservations& observations, const EMSettings& settings,
+	               unsigned int threads,
+	               SufficientStatistics& statistics) const;
+
+	/**compute
+	 *
+	 * @param polynomial, the network polynomial holding the current parameters
+	 * @param observations, discretised samples, one row per feature
+	 * @param begin, first sample that should be considered
+	 * @param end, one past the last sample that should be considered
+	 * @param settings, determinism and shard size of the computation
+	 * @param threads, number of threads to use, 0 for all cores
+	 * @param statistics, receives the expected sufficient statistics
+	 *
+	 * @return the log-likelihood of the samples in the range
+	 */
+	double compute(const NetworkPolynomial& polynomial,
+	               const DiscreteObservations& observations, size_t begin, size_t end,
+	               const EMSettings& settings, unsigned int threads,
+	               SufficientStatistics& statistics) const;
+
+	/**compute
+	 *
+	 * @param polynomial, the network polynomial holding the current parameters
+	 * @param observations, discretised samples, one row per feature
+	 * @param samples, indices of the samples that should be considered
+	 * @param settings, determinism and shard size of the computation
+	 * @param threads, number of threads to use, 0 for all cores
+	 * @param statistics, receives the expected sufficient statistics
+	 *
+	 * @return the log-likelihood of the selected samples
+	 */
+	double compute(const NetworkPolynomial& polynomial,
+	               const DiscreteObservations& observations,
+	               const std::vector<unsigned int>& samples,
+	               const EMSettings& settings, unsigned int threads,
+	               SufficientStatistics& statistics) const;
+
+	/**accumulate
+	 *
+	 * @param polynomial, the network polynomial holding the current parameters
+	 * @param observations, discretised samples, one row per feature
+	 * @param begin, first sample of the range
+	 * @param end, one past the last sample of the range
+	 * @param statistics, the expected counts of the range are added to it
+	 *
+	 * @return the log-likelihood of the samples in the range
+	 */
+	double accumulate(const NetworkPolynomial& polynomial,
+	                  const DiscreteObservations& observations, size_t begin, size_t end,
+	                  SufficientStatistics& statistics) const;
+
+	/**setWeights
+	 *
+	 * @param weights, the multiplicity of every sample column, see
+	 * CompressedObservations. Empty if every column is a single sample.
+	 */
+	void setWeights(const std::vector<unsigned int>& weights);
+
+	/**createEmptyStatistics
+	 *
+	 * @return statistics in the layout of the CPTs, filled with zeros
+	 */
+	SufficientStatistics createEmptyStatistics() const;
+
+	/**getCardinalities
+	 *
+	 * @return the number of values of every node, excluding NA
+	 */
+	const std::vector<unsigned int>& getCardinalities() const;
+
+	private:
+	/**compute
+	 *
+	 * Sharded computation over the positions [begin, end) of sampleIndices,
+	 * or over the samples [begin, end) if sampleIndices is a nullptr
+	 */
+	double compute(const NetworkPolynomial& polynomial,
+	               const DiscreteObservations& observations,
+	               const unsigned int* sampleIndices, size_t begin, size_t end,
+	               const EMSettings& settings, unsigned int threads,
+	               SufficientStatistics& statistics) const;
+
+	/**accumulate
+	 *
+	 * Sequential accumulation over the positions [begin, end) of
+	 * sampleIndices, or over the samples [begin, end) if sampleIndices is a
+	 * nullptr. Code is the type of the stored observations.
+	 */
+	template <typename Code>
+	double accumulate(const NetworkPolynomial& polynomial,
+	                  const DiscreteObservations& observations,
+	                  const unsigned int* sampleIndices, size_t begin,
+	                  size_t end, SufficientStatistics& statistics) const;
+
+	// Observation row, parents, row factors and CPT size of every node
+	std::vector<unsigned int> observationRows_;
+	std::vector<std::vector<unsigned int>> parents_;
+	std::vector<std::vector<unsigned int>> factors_;
+	std::vector<unsigned int> cardinalities_;
+	std::vector<size_t> sizes_;
+	// Multiplicity of every sample column
+	std::vector<unsigned int> weights_;
+};
+
+#endif
@@ -1,5 +1,6 @@
 #ifndef MATRIX_H
 #define MATRIX_H
+#include <algorithm>
 #include <vector>
 #include <unordered_map>
 #include <set>
@@ -10,6 +11,10 @@
 #include <boost/algorithm/string.hpp>
 #include <boost/lexical_cast.hpp>
 
+#include "BinaryIO.h"
+#include "Parallel.h"
+#include "TextParsing.h"
+
 template <typename T> class Matrix;
 template <typename T> std::ostream& operator<<(std::ostream&, const Matrix<T>&);
 
@@ -129,6 +134,15 @@ template <typename T> class Matrix
 	 */
 	const T& getData(unsigned int col, unsigned int row) const;
 
+	/**rowData
+	 *
+	 * @param row Desired row
+	 *
+	 * @return Pointer to the first element of the specified row. The elements
+	 * of a row are stored contiguously.
+	 */
+	const T* rowData(unsigned int row) const;
+
 	/**setRowNames
 	 *
 	 * @param names Vector containing row names
@@ -406,21 +420,25 @@ template <typename T> class Matrix
 	 * @param filename File that should be read
 	 * @param rowNames Flag indicating whether the matrix contains rowNames
      * @param colNames Flag indicating whether the matrix contains colNames
+	 *
+	 * @param threads Number of threads used for parsing, 0 to use all cores
 	 *
 	 * This methods reads a tab or space delimited file containing a matrix.
+	 * The file is memory mapped and large files are parsed in parallel.
 	 */
-    void readMatrix(const std::string& filename, bool colNames, bool rowNames);
+    void readMatrix(const std::string& filename, bool colNames, bool rowNames, unsigned int threads = 0);
 
     /**readMatrixDeletion
      *
      * @param filename File that should be read
      * @param rowNames Flag indicating whether the matrix contains rowNames
      * @param colNames Flag indicating whether the matrix contains colNames
-     * @param deletedSamples vector of column IDs that should not be read
+     * @param deletedSamples vector of zero based column IDs that should not be read
+     * @param threads Number of threads used for parsing, 0 to use all cores
      *
      * This methods reads a tab or space delimited file containing a matrix.
      */
-    void readMatrixDeletion(const std::string& filename, bool colNames, bool rowNames, const std::vector<unsigned int>& deletedSamples);
+    void readMatrixDeletion(const std::string& filename, bool colNames, bool rowNames, const std::vector<unsigned int>& deletedSamples, unsigned int threads = 0);
 
 	/**countElement
 	 *
@@ -535,6 +553,26 @@ template <typename T> class Matrix
 	void clear();
 
 	private:
+	/**parseMatrix
+	 *
+	 * @param text, the content of a tab or space delimited file
+	 * @param size, the number of characters of the content
+	 * @param colNames Flag indicating whether the first line contains colNames
+	 * @param rowNames Flag indicating whether every line starts with a rowName
+	 * @param deletedSamples vector of column IDs that should not be stored
+	 * @param threads Number of threads used for parsing
+	 *
+	 * The header and the first row determine the number of samples. The
+	 * remaining lines are split into chunks of whole lines. A first pass
+	 * counts the rows of every chunk, a second pass converts the values of
+	 * every chunk directly into its rows of the matrix. Both passes process
+	 * the chunks in parallel.
+	 */
+	void parseMatrix(const char* text, size_t size, bool colNames,
+	                 bool rowNames,
+	                 const std::vector<unsigned int>& deletedSamples,
+	                 unsigned int threads);
+
 	//Unsigned ints to store the size of the matrix
 	size_t rowCount_;
 	size_t colCount_;
@@ -671,6 +709,14 @@ const T& Matrix<T>::getData(unsigned int col, unsigned int row) const
 	return data_[col + row * colCount_];
 }
 
+template <typename T>
+const T* Matrix<T>::rowData(unsigned int row) const
+{
+	if(row >= rowCount_) {
+		throw std::invalid_argument("In rowData, Invalid matrix row");
+	}
+	return data_.data() + row * colCount_;
+}
 
 template <typename T>
 void Matrix<T>::setRowNames(const std::vector<std::string>& names)
@@ -957,195 +1003,148 @@ bool Matrix<T>::containsElement(unsigned int colrow, unsigned int number,const T
 }
 
 template <typename T>
-void Matrix<T>::readMatrix(const std::string& filename, bool colNames, bool rowNames)
+void Matrix<T>::readMatrix(const std::string& filename, bool colNames, bool rowNames, unsigned int threads)
 {
-	std::ifstream input(filename, std::ifstream::in);
-	if (!input.good()){
-		throw std::invalid_argument("File not found");
-	}
-	std::string line;
-	int numRows = 0;
-	int numCols = 0;
-	rowNames_.clear();
-	colNames_.clear();
-	std::vector<std::string> colNBuffer;
-	// Determine number of rows
-	while(std::getline(input, line)) {
-		numRows++;
+	MappedFile file(filename);
+	parseMatrix(file.data(), file.size(), colNames, rowNames, {}, threads);
+}
+
+template <typename T>
+void Matrix<T>::readMatrixDeletion(const std::string& filename, bool colNames, bool rowNames, const std::vector<unsigned int>& deletedSamples, unsigned int threads)
+{
+	MappedFile file(filename);
+	parseMatrix(file.data(), file.size(), colNames, rowNames, deletedSamples, threads);
+	if(rowCount_ == 0) {
+		throw std::invalid_argument("Matrix containing data is improperly "
+		                            "formatted. No features were found.");
 	}
-	// Determine number of columns
-	input.clear();
-	input.seekg(0);
-	std::stringstream content;
-	std::string n;
-	std::getline(input, line);
-	content << line;
-	while(content >> n) {
-		numCols++;
+	if(colCount_ == 0) {
+		throw std::invalid_argument("Matrix containing data is improperly "
+		                            "formatted. No samples were found.");
 	}
-	// Adapt matrix
-	colCount_ = numCols - int(rowNames);
-	rowCount_ = numRows - int(colNames);
-	data_.clear();
-	data_.reserve(colCount_ * rowCount_);
-
-	// Read data
-	input.clear();
-	input.seekg(0);
-
-	const auto matcher = [](char c) { return c == '\t' || c == ' '; };
-	const auto finder = token_finder(matcher, boost::token_compress_on);
-	const auto split_iter_end = boost::algorithm::split_iterator<std::string::iterator>();
+}
 
-	if(colNames) {
-		auto it = boost::algorithm::make_split_iterator(line,finder);
-		for(; it != split_iter_end; ++it) {
-			if(boost::begin(*it) == boost::end(*it)) {
-				continue;
+template <typename T>
+void Matrix<T>::parseMatrix(const char* text, size_t size, bool colNames,
+                            bool rowNames,
+                            const std::vector<unsigned int>& deletedSamples,
+                            unsigned int threads)
+{
+	const char* position = text;
+	const char* end = text + size;
+	std::vector<TextToken> tokens;
+	std::vector<std::string> colNBuffer;
+	bool headerRead = !colNames;
+	const char* body = end;
+	unsigned int firstLine = 0;
+
+	// The header and the first row determine the layout of the matrix
+	while(position < end) {
+		const char* lineBegin = position;
+		const char* lineEnd = findLineEnd(position, end);
+		position = lineEnd < end ? lineEnd + 1 : end;
+		firstLine++;
+		splitLine(lineBegin, lineEnd, tokens);
+		if(tokens.empty()) {
+			continue;
+		}
+		if(!headerRead) {
+			for(const auto& token : tokens) {
+				colNBuffer.emplace_back(token.first, token.second);
 			}
-
-			colNBuffer.push_back(boost::copy_range<std::string>(*it));
+			headerRead = true;
+			continue;
 		}
+		body = lineBegin;
+		break;
 	}
-
-	std::vector<std::string> rowNBuffer;
-	unsigned int row = colNames+1;
-	while(std::getline(input, line)) {
-		auto it = boost::algorithm::make_split_iterator(line, finder);
-		unsigned int counter = 0;
-		if(rowNames) {
-			rowNBuffer.push_back(boost::copy_range<std::string>(*it));
-			++it;
+	const size_t numCols = body == end ? 0 : tokens.size() - size_t(rowNames);
+
+	// Position of every column in the matrix, -1 for deleted samples
+	std::vector<int> target(numCols, 0);
+	for(auto sample : deletedSamples) {
+		if(sample >= numCols) {
+			throw std::invalid_argument(
+			    "Attempted to delete a sample that is not present in the "
+			    "matrix.");
+		}
+		target[sample] = -1;
+	}
+	size_t kept = 0;
+	for(auto& col : target) {
+		if(col != -1) {
+			col = kept++;
 		}
-		
-		for(; it != split_iter_end; ++it) {
-			if(boost::begin(*it) == boost::end(*it)) {
-				continue;
+	}
+
+	// The remaining rows are split into chunks whose rows are counted first,
+	// then every chunk is parsed directly into its part of the matrix
+	TextChunks chunks = indexChunks(body, end, firstLine, threads);
+	const size_t numRows = chunks.firstRow.back();
+	std::vector<T> data(numRows * kept);
+	std::vector<std::string> rowNBuffer(rowNames ? numRows : 0);
+	// Line of the first row with a wrong number of samples in every chunk
+	std::vector<size_t> invalidLine(chunks.size(), 0);
+	forEachShard(chunks.size(), threads, [&](size_t chunk) {
+		std::vector<TextToken> tokens;
+		size_t row = chunks.firstRow[chunk];
+		size_t line = chunks.firstLine[chunk] - 1;
+		forEachLine(chunks.boundaries[chunk], chunks.boundaries[chunk + 1],
+		            [&](const char* lineBegin, const char* lineEnd) {
+			line++;
+			splitLine(lineBegin, lineEnd, tokens);
+			if(tokens.empty() || invalidLine[chunk] != 0) {
+				return;
 			}
-			else{
-				counter++;
+			if(tokens.size() != numCols + size_t(rowNames)) {
+				invalidLine[chunk] = line;
+				return;
 			}
-			data_.push_back(boost::lexical_cast<T>(boost::copy_range<std::string>(*it)));
-		}
-		if (counter != colCount_){
-			throw std::invalid_argument("Row "+std::to_string(row)+" does not contain the specified number of samples");
+			if(rowNames) {
+				rowNBuffer[row].assign(tokens[0].first, tokens[0].second);
+			}
+			T* values = data.data() + row * kept;
+			for(size_t col = 0; col < numCols; col++) {
+				if(target[col] != -1) {
+					const TextToken& token = tokens[col + size_t(rowNames)];
+					parseValue(token.first, token.second, values[target[col]]);
+				}
+			}
+			row++;
+		});
+	});
+	for(auto line : invalidLine) {
+		if(line != 0) {
+			throw std::invalid_argument("Row " + std::to_string(line) + " does not contain the specified number of samples");
 		}
-		row++;
 	}
 
-	setRowNames(rowNBuffer);
-	setColNames(colNBuffer);
-}
-
-template <typename T>
-void Matrix<T>::readMatrixDeletion(const std::string& filename, bool colNames, bool rowNames, const std::vector<unsigned int>& deletedSamples)
-{
-	std::vector<unsigned int> deSelected = deletedSamples;
-	std::sort(deSelected.begin(), deSelected.end());
-    std::ifstream input(filename, std::ifstream::in);
-    if (!input.good()){
-        throw std::invalid_argument("File not found");
-    }
-    std::string line;
-
-	size_t numRows = 0;
-    size_t numCols = 0;
-
-    rowNames_.clear();
-    colNames_.clear();
-    std::vector<std::string> colNBuffer;
-    // Determine number of rows
-    while(std::getline(input, line)) {
-        numRows++;
-    }
-    // Determine number of columns
-    input.clear();
-    input.seekg(0);
-    std::stringstream content;
-    std::string n;
-    std::getline(input, line);
-    content << line;
-    while(content >> n) {
-        numCols++;
-    }
-
-	if(numCols < deletedSamples.size()) {
-		throw std::invalid_argument(
-		    "Attempted to delete more samples than present in the matrix.");
+	// A header may name the column of the row names as well
+	if(rowNames && colNBuffer.size() == numCols + 1) {
+		colNBuffer.erase(colNBuffer.begin());
 	}
-
-	numCols -= deletedSamples.size();
-
-	// Adapt matrix
-    colCount_ = numCols - int(rowNames);
-    rowCount_ = numRows - int(colNames);
-	if (rowCount_== 0 ||rowCount_ > numRows){
-		throw std::invalid_argument("Matrix containing data is improperly "
-		                            "formatted. No features were found.");
+	if(colNames && numRows > 0 && colNBuffer.size() != numCols) {
+		throw std::invalid_argument("The header does not contain the specified number of samples");
 	}
-
-	if (colCount_ == 0 || colCount_ > numCols){
-		throw std::invalid_argument("Matrix containing data is improperly "
-		                            "formatted. No samples were found.");
+	if(!colNBuffer.empty()) {
+		std::vector<std::string> keptNames;
+		for(size_t col = 0; col < numCols; col++) {
+			if(target[col] != -1) {
+				keptNames.push_back(std::move(colNBuffer[col]));
+			}
+		}
+		colNBuffer = std::move(keptNames);
 	}
 
-    data_.clear();
-    data_.reserve(colCount_ * rowCount_);
-
-    // Read data
-    input.clear();
-    input.seekg(0);
-
-    const auto matcher = [](char c) { return c == '\t' || c == ' '; };
-    const auto finder = token_finder(matcher, boost::token_compress_on);
-    const auto split_iter_end = boost::algorithm::split_iterator<std::string::iterator>();
-
-	unsigned int counter;
-    if(colNames) {
-		counter = 0;
-        auto it = boost::algorithm::make_split_iterator(line,finder);
-        for(; it != split_iter_end; ++it) {
-            if(boost::begin(*it) == boost::end(*it)) {
-                continue;
-            }
-			else{
-				counter++;
-			}
-			if (!std::binary_search(deSelected.begin(), deSelected.end(),(counter+1))){
-	            colNBuffer.push_back(boost::copy_range<std::string>(*it));
-			}
-        }
-    }
-
-    std::vector<std::string> rowNBuffer;
-    unsigned int row = colNames+1;
-    while(std::getline(input, line)) {
-        auto it = boost::algorithm::make_split_iterator(line, finder);
-        counter=0;
-        if(rowNames) {
-            rowNBuffer.push_back(boost::copy_range<std::string>(*it));
-            ++it;
-        }
-
-        for(; it != split_iter_end; ++it) {
-            if(boost::begin(*it) == boost::end(*it)) {
-                continue;
-            }
-            else{
-                counter++;
-            }
-			if (!std::binary_search(deSelected.begin(), deSelected.end(),(counter+1))){
-	            data_.push_back(boost::lexical_cast<T>(boost::copy_range<std::string>(*it)));
-				}
-        }
-        if (counter != colCount_+deletedSamples.size()){
-            throw std::invalid_argument("Row "+std::to_string(row)+" does not contain the specified number of samples");
-        }
-        row++;
-    }
-
-    setRowNames(rowNBuffer);
-    setColNames(colNBuffer);
+	data_ = std::move(data);
+	colCount_ = kept;
+	rowCount_ = numRows;
+	rowNames_.clear();
+	colNames_.clear();
+	rowNamesToIndex_.clear();
+	colNamesToIndex_.clear();
+	setRowNames(rowNBuffer);
+	setColNames(colNBuffer);
 }
 
 template <typename T>
@@ -1,5 +1,7 @@
 #include "Network.h"
+#include "BinaryIO.h"
 
+#include <cstdio>
 #include <ctime>
 #include <chrono>
 #include <fstream>
@@ -437,6 +439,214 @@ void Network::saveParameters() const{
 	file.close();
 }
 
+namespace {
+const char SNAPSHOT_MAGIC[8] = {'C', 'T', 'S', 'N', 'A', 'P', 'S', 'H'};
+const uint32_t SNAPSHOT_VERSION = 1;
+// Written in native byte order to detect snapshots of a different endianness
+const uint32_t SNAPSHOT_BYTE_ORDER = 0x01020304;
+
+template <typename T>
+void writeMatrix(BinaryWriter& writer, const Matrix<T>& m)
+{
+	writer.writeValue<uint64_t>(m.getRowCount());
+	writer.writeValue<uint64_t>(m.getColCount());
+	for(unsigned int row = 0; row < m.getRowCount(); row++) {
+		writer.writeArray(m.rowData(row), m.getColCount());
+	}
+}
+
+template <typename T>
+void readMatrix(BinaryReader& reader, Matrix<T>& m)
+{
+	uint64_t rows = reader.readValue<uint64_t>();
+	uint64_t cols = reader.readValue<uint64_t>();
+	if(rows != m.getRowCount() || cols != m.getColCount()) {
+		throw std::invalid_argument("Invalid matrix dimensions in snapshot");
+	}
+	for(unsigned int row = 0; row < rows; row++) {
+		std::vector<T> values = reader.readArray<T>();
+		if(values.size() != cols) {
+			throw std::invalid_argument("Invalid matrix dimensions in snapshot");
+		}
+		for(unsigned int col = 0; col < cols; col++) {
+			m.setData(values[col], col, row);
+		}
+	}
+}
+}
+
+void Network::saveSnapshot(const std::string& filename) const
+{
+	// Write to a temporary file first, readers never see a partial snapshot
+	const std::string temporary = filename + ".tmp";
+	std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+	if(!file.good()) {
+		throw std::invalid_argument("Cannot write snapshot '" + filename + "'");
+	}
+	BinaryWriter writer(file);
+	file.write(SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+	writer.writeValue(SNAPSHOT_VERSION);
+	writer.writeValue(SNAPSHOT_BYTE_ORDER);
+
+	writer.writeValue<uint64_t>(originalIDToDense_.size());
+	for(const auto& ids : originalIDToDense_) {
+		writer.writeValue<uint32_t>(ids.first);
+		writer.writeValue<uint32_t>(ids.second);
+	}
+
+	writer.writeValue<uint64_t>(observationsMap_.size());
+	for(const auto& entry : observationsMap_) {
+		writer.writeString(entry.first);
+		writer.writeValue<int32_t>(entry.second);
+	}
+	writer.writeValue<uint64_t>(observationsMapR_.size());
+	for(const auto& entry : observationsMapR_) {
+		writer.writeValue<int32_t>(entry.first.first);
+		writer.writeValue<int32_t>(entry.first.second);
+		writer.writeString(entry.second);
+	}
+
+	writer.writeValue<uint64_t>(NodeList_.size());
+	for(const auto& n : NodeList_) {
+		writer.writeValue<uint32_t>(n.getID());
+		writer.writeString(n.getName());
+		writer.writeArray(n.getParents());
+		writer.writeValue<int32_t>(n.getObservationRow());
+		writer.writeValue<int32_t>(n.getParentCombinations());
+		writer.writeArray(n.getUniqueValues());
+		writer.writeArray(n.getUniqueValuesExcludingNA());
+		writer.writeStrings(n.getValueNames());
+		writer.writeStrings(n.getValueNamesProb());
+		writer.writeStrings(n.getParentValueNames());
+		writer.writeValue<uint64_t>(n.getParentValues().size());
+		for(const auto& values : n.getParentValues()) {
+			writer.writeArray(values);
+		}
+		writeMatrix(writer, n.getObservationMatrix());
+		writeMatrix(writer, n.getProbabilityMatrix());
+	}
+	file.close();
+	if(!file.good() || std::rename(temporary.c_str(), filename.c_str()) != 0) {
+		std::remove(temporary.c_str());
+		throw std::invalid_argument("Cannot write snapshot '" + filename + "'");
+	}
+}
+
+void Network::loadSnapshot(const std::string& filename)
+{
+	MappedFile file(filename);
+	const char* data = file.data();
+	size_t size = file.size();
+	if(size < sizeof(SNAPSHOT_MAGIC) ||
+	   std::memcmp(data, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) != 0) {
+		throw std::invalid_argument("'" + filename + "' is not a snapshot");
+	}
+	BinaryReader reader(data + sizeof(SNAPSHOT_MAGIC),
+	                    size - sizeof(SNAPSHOT_MAGIC));
+	if(reader.readValue<uint32_t>() != SNAPSHOT_VERSION) {
+		throw std::invalid_argument("Unsupported snapshot version");
+	}
+	if(reader.readValue<uint32_t>() != SNAPSHOT_BYTE_ORDER) {
+		throw std::invalid_argument("Snapshot was written with a different byte order");
+	}
+
+	std::vector<std::pair<unsigned int, unsigned int>> originalIDToDense;
+	uint64_t count = reader.readValue<uint64_t>();
+	for(uint64_t i = 0; i < count; i++) {
+		unsigned int original = reader.readValue<uint32_t>();
+		unsigned int dense = reader.readValue<uint32_t>();
+		originalIDToDense.push_back(std::make_pair(original, dense));
+	}
+
+	std::unordered_map<std::string, int> observationsMap;
+	count = reader.readValue<uint64_t>();
+	for(uint64_t i = 0; i < count; i++) {
+		std::string name = reader.readString();
+		observationsMap[name] = reader.readValue<int32_t>();
+	}
+	std::map<std::pair<int, int>, std::string> observationsMapR;
+	count = reader.readValue<uint64_t>();
+	for(uint64_t i = 0; i < count; i++) {
+		int value = reader.readValue<int32_t>();
+		int row = reader.readValue<int32_t>();
+		observationsMapR[std::make_pair(value, row)] = reader.readString();
+	}
+
+	// Structure first, the CPT layout depends on the parents of all nodes
+	std::vector<Node> nodes;
+	std::vector<std::vector<unsigned int>> parents;
+	std::vector<std::string> ids;
+	std::unordered_map<std::string, unsigned int> nameToIndex;
+	std::unordered_map<unsigned int, unsigned int> idToIndex;
+	count = reader.readValue<uint64_t>();
+	for(uint64_t i = 0; i < count; i++) {
+		unsigned int id = reader.readValue<uint32_t>();
+		if(id != i) {
+			throw std::invalid_argument("Invalid node identifier in snapshot");
+		}
+		nodes.push_back(Node(0, id, reader.readString()));
+		nameToIndex[nodes.back().getName()] = i;
+		idToIndex[id] = i;
+		ids.push_back(std::to_string(id));
+		parents.push_back(reader.readArray<unsigned int>());
+		for(auto parent : parents.back()) {
+			if(parent >= count) {
+				throw std::invalid_argument("Invalid parent identifier in snapshot");
+			}
+		}
+
+		Node& n = nodes.back();
+		n.setObservationRow(reader.readValue<int32_t>());
+		n.setParentCombinations(reader.readValue<int32_t>());
+		n.setUniqueValues(reader.readArray<int>());
+		n.setUniqueValuesExcludingNA(reader.readArray<int>());
+		n.setValueNames(reader.readStrings());
+		n.setValueNamesProb(reader.readStrings());
+		n.setParentValueNames(reader.readStrings());
+		std::vector<std::vector<int>> parentValues(reader.readValue<uint64_t>());
+		for(auto& values : parentValues) {
+			values = reader.readArray<int>();
+		}
+		n.setParentValues(parentValues);
+
+		Matrix<int> obsMatrix(n.getValueNames(), n.getParentValueNames(), 0);
+		Matrix<float> probMatrix(n.getValueNamesProb(), n.getParentValueNames(), 0.0f);
+		readMatrix(reader, obsMatrix);
+		readMatrix(reader, probMatrix);
+		n.setObservations(obsMatrix);
+		n.setObservationBackup(obsMatrix);
+		n.setProbability(probMatrix);
+	}
+	if(!reader.atEnd()) {
+		throw std::invalid_argument("Trailing data in snapshot");
+	}
+
+	NodeList_ = std::move(nodes);
+	IDToIndex_ = std::move(idToIndex);
+	NameToIndex_ = std::move(nameToIndex);
+	originalIDToDense_ = std::move(originalIDToDense);
+	observationsMap_ = std::move(observationsMap);
+	observationsMapR_ = std::move(observationsMapR);
+	hypostart_ = 0;
+	IDMap_.clear();
+	AdjacencyMatrixBackup_ = Matrix<unsigned int>(0, 0, 0);
+	AdjacencyMatrix_ = Matrix<unsigned int>(NodeList_.size(), NodeList_.size(), 0);
+	AdjacencyMatrix_.setRowNames(ids);
+	AdjacencyMatrix_.setColNames(ids);
+	for(unsigned int id = 0; id < NodeList_.size(); id++) {
+		for(auto parent : parents[id]) {
+			AdjacencyMatrix_.setData(1, id, parent);
+		}
+	}
+	assignParents();
+	for(auto& n : NodeList_) {
+		computeFactor(n);
+		n.initialiseRevFactor();
+		n.clearDynProgMatrix();
+		n.createBackup();
+	}
+}
+
 void Network::clearDynProgMatrices(){
 	for (auto& n : NodeList_){
 		n.clearDynProgMatrix();
@@ -295,6 +295,25 @@ class Network{
 		 */
 		void saveParameters() const;
 
+		/**saveSnapshot
+		 *
+		 * @param filename Name of the snapshot file
+		 *
+		 * Writes the structure, the value name dictionaries, the observation
+		 * counts and all CPTs of a trained network to a versioned binary file.
+		 */
+		void saveSnapshot(const std::string& filename) const;
+
+		/**loadSnapshot
+		 *
+		 * @param filename Name of a file created by saveSnapshot
+		 *
+		 * Replaces this network by the trained network stored in the snapshot.
+		 * The file is memory mapped read-only, thus several processes can load
+		 * the same snapshot concurrently without re-training.
+		 */
+		void loadSnapshot(const std::string& filename);
+
 		/**clearDynProgMatrices 
 		 *
 		 * Clear all entries in the matrices created for DynamicProgramming
@@ -1,14 +1,25 @@
 #include "NetworkController.h"
 
+#include "CompressedObservations.h"
 #include "DataDistribution.h"
+#include "DiscretisationCache.h"
 #include "Discretiser.h"
 #include "DiscretisationSettings.h"
 #include "EM.h"
+#include "OnlineEM.h"
+#include "ProbabilityHandler.h"
+#include <algorithm>
+#include <cmath>
 #include <fstream>
+#include <limits>
+#include <sstream>
 NetworkController::NetworkController()
     : observations_(0, 0, -1),
+      onlineUpdates_(0),
       eMRuns_(0),
       finalDifference_(0),
+      eMIterationsSaved_(0),
+      eMResumedIterations_(0),
       likelihoodOfTheData_(0.0f),
       timeInMicroSeconds_(0)
 {
@@ -16,6 +27,7 @@ NetworkController::NetworkController()
 
 void NetworkController::loadNetwork(const std::string& networkfile){
 	network_.readNetwork(networkfile);
+	countedWeights_.clear();
 }
 
 Network& NetworkController::getNetwork(){
@@ -29,26 +41,29 @@ const Network& NetworkController::getNetwork() const {
 void NetworkController::loadObservations(const std::string& datafile,
                                          const std::string& controlFile)
 {
-	Matrix<std::string> originalObservations(datafile, false, true);
-	Discretiser d(originalObservations,controlFile,observations_,network_);
+	loadObservations(datafile, controlFile, {});
 }
 
 void NetworkController::loadObservations(
     const std::string& datafile, const std::string& controlFile,
     const std::vector<unsigned int>& samplesToDelete)
 {
-	Matrix<std::string> originalObservations(datafile, false, true,samplesToDelete);
-	Discretiser d(originalObservations,controlFile,observations_,network_);
+	if(discretisationCache_) {
+		// The cache is keyed by the settings, not by the name of the control file
+		loadObservations(datafile, DiscretisationSettings(controlFile),
+		                 samplesToDelete);
+		return;
+	}
+	Discretiser d(datafile, controlFile, observations_, network_,
+	              samplesToDelete);
+	resetSelection();
 }
 
 void NetworkController::loadObservations(
 	const std::string& datafile, 
 	const DiscretisationSettings& propertyTree)
 {
-	Matrix<std::string> originalObservations(datafile, false, true);
-	Discretiser d(originalObservations,observations_,network_);
-	d.setJsonTree(propertyTree);
-	d.discretise();
+	loadObservations(datafile, propertyTree, {});
 }
 
 void NetworkController::loadObservations(
@@ -56,35 +71,318 @@ void NetworkController::loadObservations(
 	const DiscretisationSettings& propertyTree,
 	const std::vector<unsigned int>& samplesToDelete)
 {
-	Matrix<std::string> originalObservations(datafile, false, true,samplesToDelete);
-	Discretiser d(originalObservations,observations_,network_);
-	d.setJsonTree(propertyTree);
-	d.discretise();
+	// The contents are hashed before they are parsed, store skips the
+	// discretisation if the datafile changes in the meantime
+	uint64_t contentHash = 0;
+	uint64_t fileSize = 0;
+	const bool hashed =
+	    discretisationCache_ &&
+	    DiscretisationCache::computeContentHash(datafile, contentHash, fileSize);
+	if(!hashed ||
+	   !discretisationCache_->load(contentHash, fileSize, propertyTree,
+	                               samplesToDelete, observations_, network_)) {
+		Discretiser d(datafile, propertyTree, observations_, network_,
+		              samplesToDelete);
+		if(hashed) {
+			discretisationCache_->store(datafile, contentHash, fileSize,
+			                            propertyTree, samplesToDelete,
+			                            observations_, d);
+		}
+	}
+	resetSelection();
+}
+
+void NetworkController::setDiscretisationCache(const std::string& directory)
+{
+	if(directory.empty()) {
+		discretisationCache_.reset();
+	} else {
+		discretisationCache_ = std::make_shared<DiscretisationCache>(directory);
+	}
+}
+
+void NetworkController::setDeselectedSamples(
+    const std::vector<unsigned int>& deselectedSamples)
+{
+	std::vector<bool> deselected(observations_.getColCount(), false);
+	for(auto sample : deselectedSamples) {
+		if(sample >= deselected.size()) {
+			throw std::invalid_argument(
+			    "Attempted to deselect a sample that is not loaded");
+		}
+		deselected[sample] = true;
+	}
+	if(!deselected.empty() &&
+	   std::find(deselected.begin(), deselected.end(), false) == deselected.end()) {
+		throw std::invalid_argument("At least one sample has to be selected");
+	}
+	deselectedSamples_ = std::move(deselected);
+}
+
+std::vector<unsigned int> NetworkController::getDeselectedSamples() const
+{
+	std::vector<unsigned int> deselected;
+	for(unsigned int sample = 0; sample < deselectedSamples_.size(); sample++) {
+		if(deselectedSamples_[sample]) {
+			deselected.push_back(sample);
+		}
+	}
+	return deselected;
+}
+
+void NetworkController::resetSelection()
+{
+	deselectedSamples_.clear();
+	countedWeights_.clear();
 }
 
+std::vector<unsigned int> NetworkController::getSelectedWeights(
+    const CompressedObservations& compressed) const
+{
+	std::vector<unsigned int> weights = compressed.getWeights();
+	for(size_t sample = 0; sample < deselectedSamples_.size(); sample++) {
+		if(deselectedSamples_[sample]) {
+			weights[compressed.getIndices()[sample]]--;
+		}
+	}
+	return weights;
+}
 
+bool NetworkController::countsUpToDate() const
+{
+	if(countedWeights_.empty() ||
+	   countedParents_.size() != network_.getNodes().size()) {
+		return false;
+	}
+	for(const auto& n : network_.getNodes()) {
+		if(n.getParents() != countedParents_[n.getID()]) {
+			return false;
+		}
+	}
+	return true;
+}
 
 void NetworkController::trainNetwork(){
-	DataDistribution datadu(network_, observations_);
-	storeDiscretisedData("discretisedData.txt");
+	train(nullptr, false);
+}
+
+void NetworkController::trainNetwork(
+    const NetworkPolynomial::Parameters& initialParameters){
+	train(&initialParameters, false);
+}
+
+void NetworkController::retrainNetwork(){
+	NetworkPolynomial::Parameters parameters = getParameters();
+	if(!countsUpToDate()) {
+		train(&parameters, true);
+		return;
+	}
+	// Compression is deterministic, so the distinct samples are the counted ones
+	CompressedObservations compressed(observations_);
+	std::vector<unsigned int> weights = getSelectedWeights(compressed);
+	std::vector<int> changes(weights.size());
+	for(size_t sample = 0; sample < weights.size(); sample++) {
+		changes[sample] = static_cast<int>(weights[sample]) -
+		                  static_cast<int>(countedWeights_[sample]);
+	}
+	DataDistribution datadu(network_, DiscreteObservations(compressed.getSamples()));
+	datadu.updateObservations(changes);
+	countedWeights_ = weights;
+	estimateParameters(&parameters, compressed, weights);
+}
+
+NetworkPolynomial::Parameters NetworkController::getParameters() const {
+	return NetworkPolynomial::extractParameters(network_);
+}
+
+void NetworkController::train(
+    const NetworkPolynomial::Parameters* initialParameters, bool fallback){
+	// The values the initial parameters refer to, before they are counted again
+	std::vector<std::vector<std::string>> valueNames;
+	std::vector<std::vector<std::string>> parentValueNames;
+	if(initialParameters != nullptr && fallback) {
+		for(const auto& n : network_.getNodes()) {
+			valueNames.push_back(n.getValueNamesProb());
+			parentValueNames.push_back(n.getParentValueNames());
+		}
+	}
+	// Identical samples are counted and scored once, weighted by their multiplicity
+	CompressedObservations compressed(observations_);
+	// Deselected samples are part of the layout of the CPTs, but are not counted
+	std::vector<unsigned int> weights = getSelectedWeights(compressed);
+	// Counting and EM read the samples as compact codes
+	DataDistribution datadu(network_, DiscreteObservations(compressed.getSamples()),
+	                        weights);
 	datadu.assignObservationsToNodes();
 	datadu.distributeObservations();
-	EM em(network_, observations_, 0.001f, 100000);
+	countedWeights_ = weights;
+	countedParents_.clear();
+	for(const auto& n : network_.getNodes()) {
+		countedParents_.push_back(n.getParents());
+	}
+	if(initialParameters != nullptr && fallback) {
+		// The CPTs are empty now, but their layout is the one EM expects
+		auto layout = getParameters();
+		bool fits = layout.size() == initialParameters->size() &&
+		            valueNames.size() == layout.size();
+		for(size_t id = 0; fits && id < layout.size(); id++) {
+			// Renamed or reordered values would inherit the probabilities of
+			// other values, even if their number did not change
+			const Node& n = network_.getNode(id);
+			fits = layout[id].size() == (*initialParameters)[id].size() &&
+			       n.getValueNamesProb() == valueNames[id] &&
+			       n.getParentValueNames() == parentValueNames[id];
+		}
+		if(!fits) {
+			initialParameters = nullptr;
+		}
+	}
+	estimateParameters(initialParameters, compressed, weights);
+}
+
+void NetworkController::estimateParameters(
+    const NetworkPolynomial::Parameters* initialParameters,
+    const CompressedObservations& compressed,
+    const std::vector<unsigned int>& weights)
+{
+	const Matrix<int>& distinct = compressed.getSamples();
+	DiscreteObservations samples;
+	std::vector<unsigned int> selectedWeights;
+	if(std::find(weights.begin(), weights.end(), 0) == weights.end()) {
+		samples = DiscreteObservations(distinct);
+		selectedWeights = weights;
+	} else {
+		// Distinct samples without a selected occurrence are left out
+		std::vector<unsigned int> selected;
+		for(unsigned int col = 0; col < weights.size(); col++) {
+			if(weights[col] > 0) {
+				selected.push_back(col);
+				selectedWeights.push_back(weights[col]);
+			}
+		}
+		Matrix<int> selectedSamples(selected.size(), distinct.getRowCount(), -1);
+		selectedSamples.setRowNames(distinct.getRowNames());
+		for(size_t col = 0; col < selected.size(); col++) {
+			for(unsigned int row = 0; row < distinct.getRowCount(); row++) {
+				selectedSamples(col, row) = distinct(selected[col], row);
+			}
+		}
+		samples = DiscreteObservations(selectedSamples);
+	}
+
+	const NetworkPolynomial::Parameters noParameters;
+	EM em(network_, std::move(samples),
+	      initialParameters == nullptr ? noParameters : *initialParameters,
+	      0.001f, 100000,
+	      eMSettings_, selectedWeights);
 	eMRuns_ = em.getNumberOfRuns();
 	finalDifference_ = em.getDifference();
 	likelihoodOfTheData_ = em.calculateLikelihoodOfTheData();
 	timeInMicroSeconds_ = em.getTimeInMicroSeconds();
+	eMIterationsSaved_ = em.getIterationsSaved();
+	eMResumedIterations_ = em.getResumedIterations();
+	eMTrace_ = em.getTrace();
+	// Online updates continue from the expected counts of the training, so
+	// the first batch does not outweigh the whole training data
+	onlineStatistics_ = em.getStatistics();
+	onlineUpdates_ = em.getNumberOfStatisticsUpdates();
 	network_.clearDynProgMatrices();
 }
 
+double NetworkController::updateNetwork(const Matrix<int>& samples) {
+	double logLikelihood = 0.0;
+	if(onlineStatistics_.empty()) {
+		OnlineEM onlineEM(network_, eMSettings_);
+		logLikelihood = onlineEM.update(samples);
+		onlineStatistics_ = onlineEM.getStatistics();
+		onlineUpdates_ = onlineEM.getNumberOfUpdates();
+	} else {
+		OnlineEM onlineEM(network_, onlineStatistics_, onlineUpdates_, eMSettings_);
+		logLikelihood = onlineEM.update(samples);
+		onlineStatistics_ = onlineEM.getStatistics();
+		onlineUpdates_ = onlineEM.getNumberOfUpdates();
+	}
+	return logLikelihood;
+}
+
+void NetworkController::setEMSettings(const EMSettings& settings) {
+	eMSettings_ = settings;
+}
+
+const EMSettings& NetworkController::getEMSettings() const {
+	return eMSettings_;
+}
+
 float NetworkController::getLikelihoodOfTheData() const {
 	return likelihoodOfTheData_;
 }
 
+std::vector<double>
+NetworkController::getLogLikelihoodOfSamples(unsigned int threads)
+{
+	ProbabilityHandler probHandler(network_);
+	CompressedObservations compressed(observations_);
+	std::vector<double> distinct = probHandler.calculateLogLikelihoodOfSamples(
+	    DiscreteObservations(compressed.getSamples()), threads);
+	std::vector<double> logLikelihoods;
+	logLikelihoods.reserve(compressed.getIndices().size());
+	for(auto index : compressed.getIndices()) {
+		logLikelihoods.push_back(distinct[index]);
+	}
+	return logLikelihoods;
+}
+
 int NetworkController::getNumberOfEMRuns() const {
 	return eMRuns_;
 }
 
+int NetworkController::getEMIterationsSaved() const {
+	return eMIterationsSaved_;
+}
+
+unsigned int NetworkController::getEMResumedIterations() const {
+	return eMResumedIterations_;
+}
+
+const EMTrace& NetworkController::getEMTrace() const {
+	return eMTrace_;
+}
+
+// JSON has no representation for infinite values
+static std::string toJson(double value) {
+	if(!std::isfinite(value)) {
+		return "null";
+	}
+	std::ostringstream ss;
+	ss.precision(std::numeric_limits<double>::digits10);
+	ss << value;
+	return ss.str();
+}
+
+void NetworkController::writeEMTelemetry(std::ostream& os) const {
+	os << "{\n"
+	   << "\t\"runs\": " << eMRuns_ << ",\n"
+	   << "\t\"timeInMicroSeconds\": " << timeInMicroSeconds_ << ",\n"
+	   << "\t\"parameterDifference\": " << toJson(finalDifference_) << ",\n"
+	   << "\t\"resumedIterations\": " << eMResumedIterations_ << ",\n";
+	if(eMSettings_.accelerate && eMSettings_.measureIterationsSaved) {
+		os << "\t\"iterationsSaved\": " << eMIterationsSaved_ << ",\n";
+	}
+	os << "\t\"iterations\": [";
+	for(size_t i = 0; i < eMTrace_.size(); i++) {
+		const EMIteration& step = eMTrace_[i];
+		os << (i == 0 ? "\n" : ",\n")
+		   << "\t\t{\"method\": " << step.method
+		   << ", \"iteration\": " << step.iteration
+		   << ", \"accelerated\": " << (step.accelerated ? "true" : "false")
+		   << ", \"eTimeInMicroSeconds\": " << toJson(step.eTimeInMicroSeconds)
+		   << ", \"mTimeInMicroSeconds\": " << toJson(step.mTimeInMicroSeconds)
+		   << ", \"difference\": " << toJson(step.difference)
+		   << ", \"logLikelihood\": " << toJson(step.logLikelihood) << "}";
+	}
+	os << (eMTrace_.empty() ? "]\n" : "\n\t]\n") << "}\n";
+}
+
 float NetworkController::getParameterDifference() const {
 	return finalDifference_;
 }
@@ -97,6 +395,18 @@ void NetworkController::saveParameters() const{
 	network_.saveParameters();
 }
 
+void NetworkController::saveSnapshot(const std::string& filename) const{
+	network_.saveSnapshot(filename);
+}
+
+void NetworkController::loadSnapshot(const std::string& filename){
+	network_.loadSnapshot(filename);
+	observations_ = Matrix<int>(0, 0, -1);
+	resetSelection();
+	onlineStatistics_.clear();
+	onlineUpdates_ = 0;
+}
+
 bool NetworkController::isEdgePossible(unsigned int sourceID, unsigned int targetID,
                                        std::vector<std::pair<unsigned int, unsigned int>>& addedEdges,
                                        std::vector<std::pair<unsigned int, unsigned int>>& removedEdges)
@@ -1,12 +1,19 @@
 #ifndef NETWORKCONTROLLER_H
 #define NETWORKCONTROLLER_H
 
+#include "EMSettings.h"
+#include "EMTrace.h"
 #include "Matrix.h"
 #include "Network.h"
+#include "NetworkPolynomial.h"
 
+#include <memory>
+#include <ostream>
 #include <string>
 #include <vector>
 
+class CompressedObservations;
+class DiscretisationCache;
 class Discretiser;
 class DiscretisationSettings;
 
@@ -73,16 +80,104 @@ class NetworkController
 	 */
 	void loadObservations(const std::string& datafile, const DiscretisationSettings& settings, const std::vector<unsigned int>& samplesToDelete);
 
+	/**
+	 * Enables a cache of the discretised observations. Loading observations
+	 * from a file restores them from the cache instead of parsing and
+	 * discretising the file if the same contents were discretised with the
+	 * same settings and deleted samples before, otherwise the result is added
+	 * to the cache in the background.
+	 *
+	 * @param directory Existing directory holding the cache files, an empty name disables the cache.
+	 */
+	void setDiscretisationCache(const std::string& directory);
+
+	/**
+	 * Excludes loaded samples from training without reading the data again.
+	 * The selection is kept until other observations are loaded. Deselected
+	 * samples still determine the values of the nodes and the thresholds of
+	 * the discretisation, so changing the selection keeps the layout of the
+	 * CPTs. To exclude samples from the discretisation as well, pass them as
+	 * samplesToDelete to loadObservations instead.
+	 *
+	 * @param deselectedSamples Column indices of the loaded samples that should not be used for training.
+	 */
+	void setDeselectedSamples(const std::vector<unsigned int>& deselectedSamples);
+
+	/**
+	 * @return the column indices of the loaded samples excluded from training
+	 */
+	std::vector<unsigned int> getDeselectedSamples() const;
+
 	/**
 	 * Trains the network using the EM algorithm
 	 */
 	void trainNetwork();
 
+	/**
+	 * Trains the network using the EM algorithm, starting from the given
+	 * parameters instead of the default initialisations.
+	 *
+	 * @param initialParameters Previously learned parameters, see getParameters.
+	 */
+	void trainNetwork(const NetworkPolynomial::Parameters& initialParameters);
+
+	/**
+	 * Trains the network using the EM algorithm, starting from its current CPTs.
+	 * After small changes of the data this converges within a few iterations.
+	 * If the network has not been trained before, or the values of a node
+	 * changed, the default initialisations are used.
+	 * If the network has been trained on the loaded observations with its
+	 * current structure and only the selection of samples changed, the counts
+	 * of the nodes are updated by subtracting the contributions of newly
+	 * deselected samples and adding those of reselected ones, instead of
+	 * counting all samples again.
+	 */
+	void retrainNetwork();
+
+	/**
+	 * @return the current CPTs of the network, one vector per node in the
+	 * layout used by NetworkPolynomial
+	 */
+	NetworkPolynomial::Parameters getParameters() const;
+
+	/**
+	 * Updates the CPTs of the trained network with new samples using online EM.
+	 * The running statistics are kept between calls. Training seeds them with the
+	 * expected counts of the training samples and the step size schedule continues
+	 * after their number, so new samples are weighed against the training data.
+	 *
+	 * @param samples Discretised samples with the same row layout as the loaded observations.
+	 *
+	 * @return the log-likelihood of the samples before the update
+	 */
+	double updateNetwork(const Matrix<int>& samples);
+
+	/**
+	 * Sets the runtime options used by the EM algorithm.
+	 *
+	 * @param settings Number of threads and determinism of the training.
+	 */
+	void setEMSettings(const EMSettings& settings);
+
+	/**
+	 * @return the runtime options used by the EM algorithm
+	 */
+	const EMSettings& getEMSettings() const;
+
 	/**
 	 * @return the log-likelihood of the data
 	 */
 	float getLikelihoodOfTheData() const;
 
+	/**
+	 * Scores every loaded sample with the trained network.
+	 *
+	 * @param threads Number of threads used for scoring, 0 to use all cores.
+	 *
+	 * @return the log-likelihood of every sample
+	 */
+	std::vector<double> getLogLikelihoodOfSamples(unsigned int threads = 0);
+
 	/**
 	 * @return a reference to the network
 	 */
@@ -98,6 +193,28 @@ class NetworkController
 	 */
 	int getNumberOfEMRuns() const;
 
+	/**
+	 * @return the EM iterations saved by the acceleration, 0 unless measured, see
+	 * EMSettings::measureIterationsSaved
+	 */
+	int getEMIterationsSaved() const;
+
+	/**
+	 * @return the number of EM iterations restored from a checkpoint, see EMSettings
+	 */
+	unsigned int getEMResumedIterations() const;
+
+	/**
+	 * @return the per-step telemetry of the last EM training, see EM::getTrace
+	 */
+	const EMTrace& getEMTrace() const;
+
+	/**
+	 * Writes the summary and the per-step telemetry of the last EM training as JSON.
+	 * @param os The stream to write to.
+	 */
+	void writeEMTelemetry(std::ostream& os) const;
+
 	/**
 	 * @return the final Parameter difference in EM
 	 */ 
@@ -114,6 +231,19 @@ class NetworkController
 	 */
 	void saveParameters() const;
 
+	/**
+	 * Stores the trained network in a binary snapshot.
+	 * @param filename Name of the snapshot file.
+	 */
+	void saveSnapshot(const std::string& filename) const;
+
+	/**
+	 * Replaces the network by a trained network stored in a snapshot. No
+	 * observations or training are needed afterwards to answer queries.
+	 * @param filename Name of the snapshot file.
+	 */
+	void loadSnapshot(const std::string& filename);
+
 	/**
 	 * Checks whether an edge can be added to a network without inducing a cycle.
 	 *
@@ -135,18 +265,80 @@ class NetworkController
 	void storeDiscretisedData(const std::string& filename) const;	
 	private:
 
+	/**
+	 * Distributes the observations and runs EM.
+	 * @param initialParameters Parameters to warm start from, nullptr for the default initialisations.
+	 * @param fallback Use the default initialisations if the parameters do not fit the network.
+	 */
+	void train(const NetworkPolynomial::Parameters* initialParameters, bool fallback);
+
+	/**
+	 * Runs EM on the selected samples.
+	 * @param initialParameters Parameters to warm start from, nullptr for the default initialisations.
+	 * @param compressed The distinct loaded samples.
+	 * @param weights The number of selected occurrences of every distinct sample.
+	 */
+	void estimateParameters(const NetworkPolynomial::Parameters* initialParameters,
+	                        const CompressedObservations& compressed,
+	                        const std::vector<unsigned int>& weights);
+
+	/**
+	 * @param compressed The distinct loaded samples.
+	 * @return the number of selected occurrences of every distinct sample
+	 */
+	std::vector<unsigned int> getSelectedWeights(const CompressedObservations& compressed) const;
+
+	/**
+	 * @return true, if the nodes hold the counts of the loaded samples for the current network structure
+	 */
+	bool countsUpToDate() const;
+
+	/**
+	 * Forgets the selection and the counts of the loaded samples.
+	 */
+	void resetSelection();
+
 	//Network object
 	Network network_;
 
 	//Matrix containing the discretised observations
 	Matrix<int> observations_;
 
+	//Cache of the discretised observations, nullptr if disabled
+	std::shared_ptr<DiscretisationCache> discretisationCache_;
+
+	//Samples excluded from training, one flag per column of observations_ or empty
+	std::vector<bool> deselectedSamples_;
+
+	//Weights of the distinct samples counted by the nodes, empty if the nodes
+	//do not hold counts of the loaded samples
+	std::vector<unsigned int> countedWeights_;
+
+	//Parents of every node when the samples were counted
+	std::vector<std::vector<unsigned int>> countedParents_;
+
+	//Runtime options of the EM algorithm
+	EMSettings eMSettings_;
+
+	//Running statistics and number of updates of online EM
+	std::vector<std::vector<double>> onlineStatistics_;
+	unsigned int onlineUpdates_;
+
 	//Number of EM runs
 	int eMRuns_;
 
 	//Final EM parameter difference
 	float finalDifference_;
 
+	//Measured EM iterations saved by the acceleration
+	int eMIterationsSaved_;
+
+	//EM iterations restored from a checkpoint
+	unsigned int eMResumedIterations_;
+
+	//Per-step telemetry of the last EM training
+	EMTrace eMTrace_;
+
 	//Log Likelihood of the data
 	float likelihoodOfTheData_;
 
@@ -0,0 +1,382 @@
+#include "NetworkPolynomial.h"
+
+#include <algorithm>
+#include <limits>
+#include <set>
+#include <stdexcept>
+
+NetworkPolynomial::NetworkPolynomial(const Network& network)
+    : network_(network), parameters_(extractParameters(network)), tableCount_(0)
+{
+	initialise();
+}
+
+NetworkPolynomial::NetworkPolynomial(const Network& network,
+                                     const Parameters& parameters)
+    : network_(network), parameters_(parameters), tableCount_(0)
+{
+	initialise();
+}
+
+NetworkPolynomial::Parameters
+NetworkPolynomial::extractParameters(const Network& network)
+{
+	Parameters parameters;
+	parameters.reserve(network.size());
+	for(const auto& n : network.getNodes()) {
+		const Matrix<float>& probMatrix = n.getProbabilityMatrix();
+		std::vector<double> cpt(probMatrix.getColCount() *
+		                        probMatrix.getRowCount());
+		for(unsigned int row = 0; row < probMatrix.getRowCount(); row++) {
+			for(unsigned int col = 0; col < probMatrix.getColCount(); col++) {
+				cpt[col + row * probMatrix.getColCount()] =
+				    probMatrix(col, row);
+			}
+		}
+		parameters.push_back(std::move(cpt));
+	}
+	return parameters;
+}
+
+const NetworkPolynomial::Parameters& NetworkPolynomial::getParameters() const
+{
+	return parameters_;
+}
+
+void NetworkPolynomial::setParameters(const Parameters& parameters)
+{
+	if(parameters.size() != parameters_.size()) {
+		throw std::invalid_argument(
+		    "The number of CPTs does not match the number of nodes");
+	}
+	for(unsigned int id = 0; id < parameters.size(); id++) {
+		if(parameters[id].size() != parameters_[id].size()) {
+			throw std::invalid_argument("The CPT of node " +
+			                            network_.getNode(id).getName() +
+			                            " does not match its parents");
+		}
+	}
+	parameters_ = parameters;
+}
+
+void NetworkPolynomial::initialise()
+{
+	if(parameters_.size() != network_.size()) {
+		throw std::invalid_argument(
+		    "The number of CPTs does not match the number of nodes");
+	}
+	families_.clear();
+	for(const auto& n : network_.getNodes()) {
+		if(n.getProbabilityMatrix().getColCount() == 0) {
+			throw std::invalid_argument("The network has not been trained");
+		}
+		families_.push_back(createFamily(n));
+	}
+	createSchedule();
+}
+
+NetworkPolynomial::Family NetworkPolynomial::createFamily(const Node& n) const
+{
+	Family family;
+	family.id = n.getID();
+	family.cardinality = n.getProbabilityMatrix().getColCount();
+	family.vars.push_back(n.getID());
+	family.cards.push_back(family.cardinality);
+
+	const auto& parents = n.getParents();
+	// Row factors of the CPT, the last parent varies fastest
+	std::vector<unsigned int> rowFactors(parents.size(), 1);
+	unsigned int rows = 1;
+	for(int i = parents.size() - 1; i >= 0; i--) {
+		rowFactors[i] = rows;
+		rows *= network_.getNode(parents[i]).getProbabilityMatrix().getColCount();
+	}
+	for(auto p : parents) {
+		family.vars.push_back(p);
+		family.cards.push_back(
+		    network_.getNode(p).getProbabilityMatrix().getColCount());
+	}
+
+	if(parameters_[n.getID()].size() < family.cardinality * rows) {
+		throw std::invalid_argument("The CPT of node " + n.getName() +
+		                            " does not match its parents");
+	}
+
+	// The family table is stored with the node itself varying fastest
+	size_t size = family.cardinality * rows;
+	family.cptIndex.resize(size);
+	std::vector<unsigned int> assignment(family.vars.size(), 0);
+	for(size_t index = 0; index < size; index++) {
+		unsigned int row = 0;
+		for(unsigned int i = 0; i < parents.size(); i++) {
+			row += rowFactors[i] * assignment[i + 1];
+		}
+		family.cptIndex[index] = assignment[0] + row * family.cardinality;
+		for(unsigned int k = 0; k < assignment.size(); k++) {
+			if(++assignment[k] < family.cards[k]) {
+				break;
+			}
+			assignment[k] = 0;
+		}
+	}
+	return family;
+}
+
+void NetworkPolynomial::createSchedule()
+{
+	size_t nodeCount = families_.size();
+	steps_.clear();
+	remaining_.clear();
+
+	std::vector<unsigned int> cardOf(nodeCount);
+	std::vector<std::set<unsigned int>> neighbours(nodeCount);
+	std::vector<std::vector<unsigned int>> tableVars;
+	std::vector<bool> alive;
+	for(const auto& family : families_) {
+		cardOf[family.id] = family.cardinality;
+		tableVars.push_back(family.vars);
+		alive.push_back(true);
+		for(auto u : family.vars) {
+			for(auto v : family.vars) {
+				if(u != v) {
+					neighbours[u].insert(v);
+				}
+			}
+		}
+	}
+
+	std::vector<bool> eliminated(nodeCount, false);
+	for(size_t iteration = 0; iteration < nodeCount; iteration++) {
+		// Greedy choice: the variable creating the smallest table
+		unsigned int var = 0;
+		double minWeight = std::numeric_limits<double>::infinity();
+		for(unsigned int v = 0; v < nodeCount; v++) {
+			if(eliminated[v]) {
+				continue;
+			}
+			double weight = cardOf[v];
+			for(auto u : neighbours[v]) {
+				weight *= cardOf[u];
+			}
+			if(weight < minWeight) {
+				minWeight = weight;
+				var = v;
+			}
+		}
+
+		Step step;
+		step.var = var;
+		step.cardinality = cardOf[var];
+		std::set<unsigned int> others;
+		for(unsigned int t = 0; t < tableVars.size(); t++) {
+			const auto& vars = tableVars[t];
+			if(alive[t] && std::find(vars.begin(), vars.end(), var) != vars.end()) {
+				step.inputs.push_back(t);
+				alive[t] = false;
+				for(auto v : vars) {
+					if(v != var) {
+						others.insert(v);
+					}
+				}
+			}
+		}
+
+		// The eliminated variable varies fastest in the product table
+		std::vector<unsigned int> productVars{var};
+		productVars.insert(productVars.end(), others.begin(), others.end());
+		step.productSize = 1;
+		for(auto v : productVars) {
+			step.productSize *= cardOf[v];
+		}
+
+		for(auto t : step.inputs) {
+			const auto& vars = tableVars[t];
+			// Stride of every product variable in the input table
+			std::vector<unsigned int> strides(productVars.size(), 0);
+			unsigned int stride = 1;
+			for(auto v : vars) {
+				auto pos = std::find(productVars.begin(), productVars.end(), v) -
+				           productVars.begin();
+				strides[pos] = stride;
+				stride *= cardOf[v];
+			}
+			std::vector<unsigned int> index(step.productSize);
+			std::vector<unsigned int> assignment(productVars.size(), 0);
+			unsigned int current = 0;
+			for(size_t p = 0; p < step.productSize; p++) {
+				index[p] = current;
+				for(unsigned int k = 0; k < assignment.size(); k++) {
+					current += strides[k];
+					if(++assignment[k] < cardOf[productVars[k]]) {
+						break;
+					}
+					current -= strides[k] * assignment[k];
+					assignment[k] = 0;
+				}
+			}
+			step.inputIndex.push_back(std::move(index));
+		}
+
+		step.result = tableVars.size();
+		tableVars.push_back(std::vector<unsigned int>(others.begin(), others.end()));
+		alive.push_back(true);
+		steps_.push_back(std::move(step));
+
+		eliminated[var] = true;
+		for(auto u : others) {
+			neighbours[u].erase(var);
+			for(auto v : others) {
+				if(u != v) {
+					neighbours[u].insert(v);
+				}
+			}
+		}
+		neighbours[var].clear();
+	}
+
+	tableCount_ = tableVars.size();
+	for(unsigned int t = 0; t < tableCount_; t++) {
+		if(alive[t]) {
+			remaining_.push_back(t);
+		}
+	}
+}
+
+double NetworkPolynomial::forward(const std::vector<int>& evidence,
+                                  std::vector<std::vector<double>>& tables) const
+{
+	if(evidence.size() < families_.size()) {
+		throw std::invalid_argument(
+		    "The evidence does not cover all nodes of the network");
+	}
+	tables.assign(tableCount_, std::vector<double>());
+
+	// Leaf tables: CPT entries multiplied with the evidence indicators
+	for(const auto& family : families_) {
+		const auto& cpt = parameters_[family.id];
+		auto& table = tables[family.id];
+		table.resize(family.cptIndex.size());
+		std::vector<unsigned int> assignment(family.vars.size(), 0);
+		for(size_t index = 0; index < table.size(); index++) {
+			bool consistent = true;
+			for(unsigned int k = 0; k < assignment.size(); k++) {
+				int e = evidence[family.vars[k]];
+				if(e != -1 && e != static_cast<int>(assignment[k])) {
+					consistent = false;
+					break;
+				}
+			}
+			table[index] = consistent ? cpt[family.cptIndex[index]] : 0.0;
+			for(unsigned int k = 0; k < assignment.size(); k++) {
+				if(++assignment[k] < family.cards[k]) {
+					break;
+				}
+				assignment[k] = 0;
+			}
+		}
+	}
+
+	for(unsigned int s = 0; s < steps_.size(); s++) {
+		const Step& step = steps_[s];
+		std::vector<double> product(step.productSize, 1.0);
+		for(unsigned int i = 0; i < step.inputs.size(); i++) {
+			const auto& input = tables[step.inputs[i]];
+			const auto& index = step.inputIndex[i];
+			for(size_t p = 0; p < step.productSize; p++) {
+				product[p] *= input[index[p]];
+			}
+		}
+		auto& result = tables[step.result];
+		result.assign(step.productSize / step.cardinality, 0.0);
+		for(size_t r = 0; r < result.size(); r++) {
+			double sum = 0.0;
+			for(unsigned int x = 0; x < step.cardinality; x++) {
+				sum += product[x + r * step.cardinality];
+			}
+			result[r] = sum;
+		}
+	}
+
+	double probability = 1.0;
+	for(auto t : remaining_) {
+		probability *= tables[t][0];
+	}
+	return probability;
+}
+
+double NetworkPolynomial::evaluate(const std::vector<int>& evidence) const
+{
+	std::vector<std::vector<double>> tables;
+	return forward(evidence, tables);
+}
+
+double NetworkPolynomial::differentiate(const std::vector<int>& evidence,
+                                        Parameters& derivatives) const
+{
+	std::vector<std::vector<double>> tables;
+	double probability = forward(evidence, tables);
+
+	std::vector<std::vector<double>> adjoints(tableCount_);
+	for(unsigned int t = 0; t < tableCount_; t++) {
+		adjoints[t].assign(tables[t].size(), 0.0);
+	}
+	for(auto t : remaining_) {
+		double others = 1.0;
+		for(auto u : remaining_) {
+			if(u != t) {
+				others *= tables[u][0];
+			}
+		}
+		adjoints[t][0] = others;
+	}
+
+	// Reverse pass through the elimination steps
+	for(int s = steps_.size() - 1; s >= 0; s--) {
+		const Step& step = steps_[s];
+		const auto& resultAdjoint = adjoints[step.result];
+		for(size_t p = 0; p < step.productSize; p++) {
+			double adjoint = resultAdjoint[p / step.cardinality];
+			if(adjoint == 0.0) {
+				continue;
+			}
+			for(unsigned int i = 0; i < step.inputs.size(); i++) {
+				double others = adjoint;
+				for(unsigned int j = 0; j < step.inputs.size(); j++) {
+					if(i != j) {
+						others *= tables[step.inputs[j]][step.inputIndex[j][p]];
+					}
+				}
+				adjoints[step.inputs[i]][step.inputIndex[i][p]] += others;
+			}
+		}
+	}
+
+	// Map the adjoints of the leaf tables back to the CPT entries
+	derivatives.resize(parameters_.size());
+	for(const auto& family : families_) {
+		auto& derivative = derivatives[family.id];
+		derivative.assign(parameters_[family.id].size(), 0.0);
+		const auto& adjoint = adjoints[family.id];
+		std::vector<unsigned int> assignment(family.vars.size(), 0);
+		for(size_t index = 0; index < adjoint.size(); index++) {
+			bool consistent = true;
+			for(unsigned int k = 0; k < assignment.size(); k++) {
+				int e = evidence[family.vars[k]];
+				if(e != -1 && e != static_cast<int>(assignment[k])) {
+					consistent = false;
+					break;
+				}
+			}
+			if(consistent) {
+				derivative[family.cptIndex[index]] = adjoint[index];
+			}
+			for(unsigned int k = 0; k < assignment.size(); k++) {
+				if(++assignment[k] < family.cards[k]) {
+					break;
+				}
+				assignment[k] = 0;
+			}
+		}
+	}
+	return probability;
+}
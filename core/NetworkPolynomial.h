@@ -0,0 +1,152 @@
+#ifndef NETWORKPOLYNOMIAL_H
+#define NETWORKPOLYNOMIAL_H
+
+#include "Network.h"
+
+#include <vector>
+
+/**
+ * This class represents the network polynomial of a Bayesian network, i.e. the
+ * sum over all complete value assignments of the product of the CPT entries
+ * consistent with those assignments (Darwiche, 2003). Evaluating the polynomial
+ * for a set of evidence yields the probability of that evidence. Its partial
+ * derivatives with respect to the CPT entries are obtained for all parameters
+ * at once by a single backward pass through the variable elimination.
+ *
+ * The elimination schedule only depends on the network structure. It is
+ * computed once on construction and reused for every evaluation.
+ */
+class NetworkPolynomial
+{
+	public:
+	/**
+	 * One vector of CPT entries per node. The entries are stored in the layout
+	 * of the probability matrix of the node: value + row * numberOfValues.
+	 */
+	using Parameters = std::vector<std::vector<double>>;
+
+	/**NetworkPolynomial
+	 *
+	 * @param network, a const reference to a trained network
+	 *
+	 * @return NetworkPolynomial object using the current CPTs of the network
+	 */
+	explicit NetworkPolynomial(const Network& network);
+
+	/**NetworkPolynomial
+	 *
+	 * @param network, a const reference to a trained network
+	 * @param parameters, CPT entries that should be used instead of the ones
+	 * stored in the nodes of the network
+	 *
+	 * @return NetworkPolynomial object using the given parameters
+	 */
+	NetworkPolynomial(const Network& network, const Parameters& parameters);
+
+	/**evaluate
+	 *
+	 * @param evidence, a vector containing the observed value of every node, -1
+	 * for unobserved nodes
+	 *
+	 * @return the probability of the evidence
+	 */
+	double evaluate(const std::vector<int>& evidence) const;
+
+	/**differentiate
+	 *
+	 * @param evidence, a vector containing the observed value of every node, -1
+	 * for unobserved nodes
+	 * @param derivatives, is filled with the partial derivatives of the
+	 * probability of the evidence with respect to every CPT entry
+	 *
+	 * @return the probability of the evidence
+	 */
+	double differentiate(const std::vector<int>& evidence,
+	                     Parameters& derivatives) const;
+
+	/**getParameters
+	 *
+	 * @return the CPT entries used by this polynomial
+	 */
+	const Parameters& getParameters() const;
+
+	/**setParameters
+	 *
+	 * @param parameters, CPT entries that should be used from now on. The
+	 * layout has to match the one of the current parameters.
+	 */
+	void setParameters(const Parameters& parameters);
+
+	/**extractParameters
+	 *
+	 * @param network, a const reference to a trained network
+	 *
+	 * @return the CPT entries of all nodes of the network
+	 */
+	static Parameters extractParameters(const Network& network);
+
+	private:
+	// Structural information on the family of a single node
+	struct Family
+	{
+		unsigned int id;
+		unsigned int cardinality;
+		std::vector<unsigned int> vars;
+		std::vector<unsigned int> cards;
+		// Maps an entry of the dense family table to its CPT entry
+		std::vector<unsigned int> cptIndex;
+	};
+
+	// A single elimination step combining several tables into one
+	struct Step
+	{
+		unsigned int var;
+		unsigned int cardinality;
+		unsigned int result;
+		std::vector<unsigned int> inputs;
+		// Maps every entry of the product table to the entries of the inputs
+		std::vector<std::vector<unsigned int>> inputIndex;
+		size_t productSize;
+	};
+
+	/**initialise
+	 *
+	 * Collects the families and computes the elimination schedule
+	 */
+	void initialise();
+
+	/**createFamily
+	 *
+	 * @param n, const reference to the node whose family should be created
+	 *
+	 * @return the dense table description for the given node
+	 */
+	Family createFamily(const Node& n) const;
+
+	/**createSchedule
+	 *
+	 * Determines a greedy elimination ordering on the moral graph and
+	 * precomputes all index mappings needed to execute it
+	 */
+	void createSchedule();
+
+	/**forward
+	 *
+	 * @param evidence, observed value of every node
+	 * @param tables, receives the values of all leaf and intermediate tables
+	 *
+	 * @return the probability of the evidence
+	 */
+	double forward(const std::vector<int>& evidence,
+	               std::vector<std::vector<double>>& tables) const;
+
+	const Network& network_;
+	Parameters parameters_;
+	std::vector<Family> families_;
+	std::vector<Step> steps_;
+	// Tables that are not consumed by any step, i.e. scalars
+	std::vector<unsigned int> remaining_;
+	unsigned int tableCount_;
+};
+
+#endif
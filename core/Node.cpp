@@ -84,6 +84,11 @@ const Matrix<float>& Node::getProbabilityMatrix() const
 
 Matrix<int>& Node::getObservationMatrix() { return ObservationMatrix_; }
 
+const Matrix<int>& Node::getObservationMatrix() const
+{
+	return ObservationMatrix_;
+}
+
 std::ostream& operator<<(std::ostream& os, const Node& n)
 {
 	os << "Node name: " << n.name_ << "\nNode id: " << n.id_
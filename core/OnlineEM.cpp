@@ -0,0 +1,207 @@
+#include "OnlineEM.h"
+
+#include <cmath>
+#include <stdexcept>
+
+OnlineEM::OnlineEM(Network& network, const EMSettings& settings)
+    : network_(network),
+      settings_(settings),
+      expectation_(network),
+      polynomial_(network),
+      parameters_(polynomial_.getParameters()),
+      updates_(0),
+      difference_(0.0f)
+{
+	initialise();
+	// The current CPTs act as prior, equally weighted over the parent values
+	statistics_ = parameters_;
+	for(auto& statistic : statistics_) {
+		double rows = 0.0;
+		for(auto value : statistic) {
+			rows += value;
+		}
+		for(auto& value : statistic) {
+			value /= rows;
+		}
+	}
+}
+
+OnlineEM::OnlineEM(Network& network,
+                   const NetworkPolynomial::Parameters& statistics,
+                   unsigned int updates, const EMSettings& settings)
+    : network_(network),
+      settings_(settings),
+      expectation_(network),
+      polynomial_(network),
+      parameters_(polynomial_.getParameters()),
+      statistics_(statistics),
+      updates_(updates),
+      difference_(0.0f)
+{
+	initialise();
+	if(statistics_.size() != parameters_.size()) {
+		throw std::invalid_argument(
+		    "The statistics do not match the number of nodes");
+	}
+	for(unsigned int id = 0; id < statistics_.size(); id++) {
+		if(statistics_[id].size() != parameters_[id].size()) {
+			throw std::invalid_argument("The statistics of node " +
+			                            network_.getNode(id).getName() +
+			                            " do not match its CPT");
+		}
+	}
+}
+
+void OnlineEM::initialise()
+{
+	if(settings_.stepSizeDecay <= 0.0 || settings_.stepSizeDecay > 1.0) {
+		throw std::invalid_argument("The step size decay has to be in (0, 1]");
+	}
+	if(settings_.stepSizeOffset < 1.0) {
+		throw std::invalid_argument("The step size offset has to be at least 1");
+	}
+
+	const auto& cardinalities = expectation_.getCardinalities();
+	for(unsigned int id = 0; id < parameters_.size(); id++) {
+		auto& parameter = parameters_[id];
+		unsigned int cardinality = cardinalities[id];
+		for(size_t row = 0; row < parameter.size() / cardinality; row++) {
+			double rowsum = 0.0;
+			for(unsigned int col = 0; col < cardinality; col++) {
+				rowsum += parameter[col + row * cardinality];
+			}
+			for(unsigned int col = 0; col < cardinality; col++) {
+				unsigned int index = col + row * cardinality;
+				parameter[index] =
+				    rowsum > 0.0 ? parameter[index] / rowsum : 1.0 / cardinality;
+			}
+		}
+	}
+	polynomial_.setParameters(parameters_);
+}
+
+double OnlineEM::getStepSize(unsigned int t) const
+{
+	return std::pow(t + settings_.stepSizeOffset, -settings_.stepSizeDecay);
+}
+
+const NetworkPolynomial::Parameters& OnlineEM::getStatistics() const
+{
+	return statistics_;
+}
+
+unsigned int OnlineEM::getNumberOfUpdates() const
+{
+	return updates_;
+}
+
+const NetworkPolynomial::Parameters& OnlineEM::getParameters() const
+{
+	return parameters_;
+}
+
+double OnlineEM::update(const Matrix<int>& samples)
+{
+	return update(DiscreteObservations(samples));
+}
+
+double OnlineEM::update(const Matrix<int>& samples, size_t begin, size_t end)
+{
+	return update(DiscreteObservations(samples), begin, end);
+}
+
+double OnlineEM::update(const Matrix<int>& samples,
+                        const std::vector<unsigned int>& indices)
+{
+	return update(DiscreteObservations(samples), indices);
+}
+
+double OnlineEM::update(const DiscreteObservations& samples)
+{
+	return update(samples, 0, samples.getColCount());
+}
+
+double OnlineEM::update(const DiscreteObservations& samples, size_t begin,
+                        size_t end)
+{
+	if(begin >= end || end > samples.getColCount()) {
+		throw std::invalid_argument("No samples provided");
+	}
+
+	SufficientStatistics batch;
+	double logLikelihood = expectation_.compute(
+	    polynomial_, samples, begin, end, settings_, settings_.threads, batch);
+	step(batch, end - begin);
+	return logLikelihood;
+}
+
+double OnlineEM::update(const DiscreteObservations& samples,
+                        const std::vector<unsigned int>& indices)
+{
+	if(indices.empty()) {
+		throw std::invalid_argument("No samples provided");
+	}
+	for(auto sample : indices) {
+		if(sample >= samples.getColCount()) {
+			throw std::invalid_argument("Invalid sample index");
+		}
+	}
+
+	SufficientStatistics batch;
+	double logLikelihood = expectation_.compute(
+	    polynomial_, samples, indices, settings_, settings_.threads, batch);
+	step(batch, indices.size());
+	return logLikelihood;
+}
+
+void OnlineEM::step(const SufficientStatistics& batch, size_t count)
+{
+	double eta = getStepSize(updates_);
+	double perSample = eta / count;
+	for(unsigned int id = 0; id < statistics_.size(); id++) {
+		auto& statistic = statistics_[id];
+		const double* counts = batch.data(id);
+		for(unsigned int k = 0; k < statistic.size(); k++) {
+			statistic[k] = (1.0 - eta) * statistic[k] + perSample * counts[k];
+		}
+	}
+	maximise();
+	updates_++;
+}
+
+void OnlineEM::maximise()
+{
+	const auto& cardinalities = expectation_.getCardinalities();
+	double difference = 0.0;
+	unsigned int counter = 0;
+	for(auto& n : network_.getNodes()) {
+		auto& parameter = parameters_[n.getID()];
+		const auto& statistic = statistics_[n.getID()];
+		unsigned int cardinality = cardinalities[n.getID()];
+		for(size_t row = 0; row < parameter.size() / cardinality; row++) {
+			double rowsum = 0.0;
+			for(unsigned int col = 0; col < cardinality; col++) {
+				rowsum += statistic[col + row * cardinality];
+			}
+			for(unsigned int col = 0; col < cardinality; col++) {
+				unsigned int index = col + row * cardinality;
+				// Parent values without support keep their distribution
+				if(rowsum > 0.0) {
+					difference +=
+					    std::fabs(parameter[index] - statistic[index] / rowsum);
+					parameter[index] = statistic[index] / rowsum;
+				}
+				counter++;
+				n.setProbability(parameter[index], col, row);
+			}
+		}
+	}
+	polynomial_.setParameters(parameters_);
+	network_.clearDynProgMatrices();
+	difference_ = difference / counter;
+}
+
+float OnlineEM::getDifference() const
+{
+	return difference_;
+}
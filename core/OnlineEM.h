@@ -0,0 +1,179 @@
+#ifndef ONLINEEM_H
+#define ONLINEEM_H
+
+#include "EMSettings.h"
+#include "ExpectationStep.h"
+
+/**
+ * This class performs stepwise online EM (Cappe & Moulines, 2009; Liang &
+ * Klein, 2009). Every batch of new samples updates running sufficient
+ * statistics mu <- (1 - eta_t) * mu + eta_t * s_t, where s_t are the expected
+ * statistics of the batch per sample. The CPTs of the network are then
+ * re-estimated from mu. The step size follows the schedule
+ * eta_t = (t + offset)^(-kappa), configured in EMSettings.
+ */
+class OnlineEM
+{
+	public:
+	/**OnlineEM
+	 *
+	 * @param network, a reference to a network whose observations have been
+	 * assigned to the nodes. Its current CPTs are used as starting point.
+	 * @param settings, step size schedule, threads and determinism of the E-step
+	 *
+	 * @return OnlineEM object
+	 */
+	explicit OnlineEM(Network& network, const EMSettings& settings = EMSettings());
+
+	/**OnlineEM
+	 *
+	 * @param network, a reference to a network whose CPTs have been estimated
+	 * by a previous OnlineEM object
+	 * @param statistics, the running statistics of the previous object
+	 * @param updates, the number of updates performed by the previous object
+	 * @param settings, step size schedule, threads and determinism of the E-step
+	 *
+	 * @return OnlineEM object continuing the previous estimation
+	 */
+	OnlineEM(Network& network, const NetworkPolynomial::Parameters& statistics,
+	         unsigned int updates, const EMSettings& settings = EMSettings());
+
+	OnlineEM& operator=(const OnlineEM&) = delete;
+	OnlineEM& operator=(OnlineEM&&) = delete;
+
+	/**update
+	 *
+	 * @param samples, discretised samples with the same row layout as the
+	 * observations used to set up the network
+	 *
+	 * @return the log-likelihood of the samples under the parameters before
+	 * the update
+	 *
+	 * Updates the sufficient statistics and the CPTs of the network
+	 */
+	double update(const Matrix<int>& samples);
+
+	/**update
+	 *
+	 * @param samples, discretised samples
+	 * @param begin, first sample of the batch
+	 * @param end, one past the last sample of the batch
+	 *
+	 * @return the log-likelihood of the batch under the parameters before
+	 * the update
+	 */
+	double update(const Matrix<int>& samples, size_t begin, size_t end);
+
+	/**update
+	 *
+	 * @param samples, discretised samples
+	 * @param indices, indices of the samples forming the batch
+	 *
+	 * @return the log-likelihood of the batch under the parameters before
+	 * the update
+	 */
+	double update(const Matrix<int>& samples,
+	              const std::vector<unsigned int>& indices);
+
+	/**update
+	 *
+	 * @param samples, discretised samples in compact storage
+	 *
+	 * @return the log-likelihood of the samples under the parameters before
+	 * the update
+	 */
+	double update(const DiscreteObservations& samples);
+
+	/**update
+	 *
+	 * @param samples, discretised samples in compact storage
+	 * @param begin, first sample of the batch
+	 * @param end, one past the last sample of the batch
+	 *
+	 * @return the log-likelihood of the batch under the parameters before
+	 * the update
+	 */
+	double update(const DiscreteObservations& samples, size_t begin,
+	              size_t end);
+
+	/**update
+	 *
+	 * @param samples, discretised samples in compact storage
+	 * @param indices, indices of the samples forming the batch
+	 *
+	 * @return the log-likelihood of the batch under the parameters before
+	 * the update
+	 */
+	double update(const DiscreteObservations& samples,
+	              const std::vector<unsigned int>& indices);
+
+	/**getStepSize
+	 *
+	 * @param t, index of the update
+	 *
+	 * @return the step size used for the given update
+	 */
+	double getStepSize(unsigned int t) const;
+
+	/**getNumberOfUpdates
+	 *
+	 * @return the number of performed updates
+	 */
+	unsigned int getNumberOfUpdates() const;
+
+	/**getParameters
+	 *
+	 * @return the current CPT entries
+	 */
+	const NetworkPolynomial::Parameters& getParameters() const;
+
+	/**getDifference
+	 *
+	 * @return the mean absolute parameter change of the last update
+	 */
+	float getDifference() const;
+
+	/**getStatistics
+	 *
+	 * @return the running sufficient statistics per sample
+	 */
+	const NetworkPolynomial::Parameters& getStatistics() const;
+
+	private:
+	/**initialise
+	 *
+	 * Normalises the CPTs taken from the network and checks the settings
+	 */
+	void initialise();
+
+	/**step
+	 *
+	 * @param batch, expected sufficient statistics of a batch
+	 * @param count, number of samples in the batch
+	 *
+	 * Blends the batch statistics into the running statistics and maximises
+	 */
+	void step(const SufficientStatistics& batch, size_t count);
+
+	/**maximise
+	 *
+	 * Re-estimates the parameters from the running statistics and stores them
+	 * in the network
+	 */
+	void maximise();
+
+	//A reference to the network
+	Network& network_;
+	//Step size schedule and runtime options of the E-step
+	EMSettings settings_;
+	ExpectationStep expectation_;
+	NetworkPolynomial polynomial_;
+	NetworkPolynomial::Parameters parameters_;
+	//Running sufficient statistics per sample
+	NetworkPolynomial::Parameters statistics_;
+	unsigned int updates_;
+	//Mean absolute parameter change of the last update
+	float difference_;
+};
+
+#endif
@@ -0,0 +1,100 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+/**getNumberOfThreads
+ *
+ * @param requested, the number of threads requested by the user, 0 to use
+ * all available cores
+ *
+ * @return the number of threads that should be used, at least 1
+ */
+inline unsigned int getNumberOfThreads(unsigned int requested)
+{
+	if(requested == 0) {
+		requested = std::thread::hardware_concurrency();
+	}
+	return std::max(1u, requested);
+}
+
+/**getShardRange
+ *
+ * @param count, total number of items
+ * @param shards, number of shards the items are split into
+ * @param shard, index of the shard of interest
+ *
+ * @return the half open range [first, second) of items belonging to the shard
+ *
+ * The shard boundaries only depend on count and shards, never on the number
+ * of threads processing them.
+ */
+inline std::pair<size_t, size_t> getShardRange(size_t count, size_t shards,
+                                               size_t shard)
+{
+	size_t base = count / shards;
+	size_t rest = count % shards;
+	size_t begin = shard * base + std::min(shard, rest);
+	size_t end = begin + base + (shard < rest ? 1 : 0);
+	return std::make_pair(begin, end);
+}
+
+/**forEachShard
+ *
+ * @param shards, number of independent work items
+ * @param threads, number of threads to use, 0 for all available cores
+ * @param func, callable that is invoked once for every shard index
+ *
+ * Distributes the shards dynamically over a set of worker threads. The
+ * calling thread takes part in the work. The first exception thrown by func
+ * is rethrown after all workers have finished.
+ */
+template <typename F>
+void forEachShard(size_t shards, unsigned int threads, const F& func)
+{
+	threads = std::min<size_t>(getNumberOfThreads(threads), shards);
+	if(threads <= 1) {
+		for(size_t shard = 0; shard < shards; shard++) {
+			func(shard);
+		}
+		return;
+	}
+
+	std::atomic<size_t> next(0);
+	std::exception_ptr error;
+	std::mutex errorMutex;
+	auto worker = [&]() {
+		try {
+			for(size_t shard = next++; shard < shards; shard = next++) {
+				func(shard);
+			}
+		} catch(...) {
+			std::lock_guard<std::mutex> lock(errorMutex);
+			if(!error) {
+				error = std::current_exception();
+			}
+			next = shards;
+		}
+	};
+
+	std::vector<std::thread> workers;
+	workers.reserve(threads - 1);
+	for(unsigned int t = 1; t < threads; t++) {
+		workers.emplace_back(worker);
+	}
+	worker();
+	for(auto& w : workers) {
+		w.join();
+	}
+	if(error) {
+		std::rethrow_exception(error);
+	}
+}
+
+#endif
@@ -1,5 +1,10 @@
 #include "ProbabilityHandler.h"
 #include "Combinations.h"
+#include "NetworkPolynomial.h"
+#include "Parallel.h"
+
+#include <algorithm>
+#include <cmath>
 
 ProbabilityHandler::ProbabilityHandler(Network& network) : network_(network) {}
 
@@ -125,45 +130,193 @@ std::vector<std::vector<int>> ProbabilityHandler::enumerate(
 	return com.getResult();
 }
 
-int ProbabilityHandler::getParentValues(const Node& n, const Matrix<int>& obs,
-                                        unsigned int sample) const
+float ProbabilityHandler::calculateLikelihoodOfTheData(const Matrix<int>& obs)
+    const
 {
-	const auto& parents = n.getParents();
+	return calculateLikelihoodOfTheData(obs, {});
+}
 
-	int pos = 0;
-	for(unsigned int i = 0; i< parents.size(); i++) {
-		const Node& parent = network_.getNode(parents[i]);
-		pos += n.getFactor(i)*
-		       obs(sample, parent.getObservationRow());
-	}
+float ProbabilityHandler::calculateLikelihoodOfTheData(
+    const Matrix<int>& obs, const std::vector<unsigned int>& weights) const
+{
+	return calculateLikelihoodOfTheData(DiscreteObservations(obs), weights);
+}
 
-	return pos;
+float ProbabilityHandler::calculateLikelihoodOfTheData(
+    const DiscreteObservations& obs,
+    const std::vector<unsigned int>& weights) const
+{
+	if(obs.getColCount() == 0) {
+		throw std::invalid_argument("No samples provided");
+	}
+	if(obs.getCodeSize() == sizeof(uint8_t)) {
+		return log(computeLikelihoodOfTheData<uint8_t>(obs, weights));
+	}
+	return log(computeLikelihoodOfTheData<uint16_t>(obs, weights));
 }
 
-float ProbabilityHandler::calculateLikelihoodOfTheData(const Matrix<int>& obs)
-    const
+template <typename Code>
+float ProbabilityHandler::computeLikelihoodOfTheData(
+    const DiscreteObservations& obs,
+    const std::vector<unsigned int>& weights) const
 {
-	if (obs.getColCount() > 0){
-		float prob = 0.0f;
-		for(unsigned int sample = 0; sample < obs.getColCount(); sample++) {
-	
-			if(!obs.containsElement(0, sample, -1)) {
-				float intermediateResult = 1.0f;
-	
-				for(const Node& n : network_.getNodes()) {
-					int row = getParentValues(n, obs, sample);
-					intermediateResult *=
-					    n.getProbability(obs(sample, n.getObservationRow()), row);
-				}
+	// Samples with a missing value in any row are skipped
+	const uint64_t* incomplete = obs.getIncompleteSamples();
+
+	const auto& nodes = network_.getNodes();
+	std::vector<unsigned int> rows;
+	for(const Node& n : nodes) {
+		rows.push_back(n.getObservationRow());
+	}
 
-				prob += intermediateResult;
+	// Blocks of samples are scanned sample by sample in sample-major order
+	std::vector<Code> codes;
+	std::vector<uint64_t> missing;
+	float prob = 0.0f;
+	for(size_t block = 0; block < obs.getColCount();
+	    block += DiscreteObservations::SAMPLE_BLOCK_SIZE) {
+		const size_t blockEnd = std::min(
+		    obs.getColCount(), block + DiscreteObservations::SAMPLE_BLOCK_SIZE);
+		obs.transpose(rows, nullptr, block, blockEnd, codes, missing);
+		for(size_t sample = block; sample < blockEnd; sample++) {
+			if(DiscreteObservations::isSet(incomplete, sample)) {
+				continue;
 			}
+			const Code* values = codes.data() + (sample - block) * rows.size();
+			float intermediateResult = 1.0f;
+			for(unsigned int i = 0; i < nodes.size(); i++) {
+				const auto& parents = nodes[i].getParents();
+				int row = 0;
+				for(unsigned int j = 0; j < parents.size(); j++) {
+					row += nodes[i].getFactor(j) * values[parents[j]];
+				}
+				intermediateResult *= nodes[i].getProbability(values[i], row);
+			}
+			prob += weights.empty() ? intermediateResult
+			                        : weights[sample] * intermediateResult;
 		}
-		return log(prob);
 	}
-	else {
+	return prob;
+}
+
+std::vector<double> ProbabilityHandler::calculateLogLikelihoodOfSamples(
+    const Matrix<int>& obs, unsigned int threads) const
+{
+	return calculateLogLikelihoodOfSamples(DiscreteObservations(obs), threads);
+}
+
+std::vector<double> ProbabilityHandler::calculateLogLikelihoodOfSamples(
+    const DiscreteObservations& obs, unsigned int threads) const
+{
+	if(obs.getColCount() == 0) {
 		throw std::invalid_argument("No samples provided");
 	}
+	if(obs.getCodeSize() == sizeof(uint8_t)) {
+		return computeLogLikelihoodOfSamples<uint8_t>(obs, threads);
+	}
+	return computeLogLikelihoodOfSamples<uint16_t>(obs, threads);
+}
+
+template <typename Code>
+std::vector<double> ProbabilityHandler::computeLogLikelihoodOfSamples(
+    const DiscreteObservations& obs, unsigned int threads) const
+{
+	// Per node: observations, log CPT and the row factors of the parents
+	struct NodeScore
+	{
+		const Code* values;
+		const uint64_t* missing;
+		std::vector<const Code*> parentValues;
+		std::vector<unsigned int> factors;
+		unsigned int cardinality;
+		std::vector<double> logCPT;
+	};
+
+	const auto& nodes = network_.getNodes();
+	std::vector<NodeScore> scores(nodes.size());
+	for(const Node& n : nodes) {
+		NodeScore& score = scores[n.getID()];
+		const Matrix<float>& probMatrix = n.getProbabilityMatrix();
+		if(probMatrix.getColCount() == 0) {
+			throw std::invalid_argument("The network has not been trained");
+		}
+		score.values = obs.rowData<Code>(n.getObservationRow());
+		score.missing = obs.missingData(n.getObservationRow());
+		score.cardinality = probMatrix.getColCount();
+		score.logCPT.resize(probMatrix.getColCount() * probMatrix.getRowCount());
+		for(unsigned int row = 0; row < probMatrix.getRowCount(); row++) {
+			for(unsigned int col = 0; col < probMatrix.getColCount(); col++) {
+				score.logCPT[col + row * score.cardinality] =
+				    std::log(static_cast<double>(probMatrix(col, row)));
+			}
+		}
+		for(unsigned int i = 0; i < n.getNumberOfParents(); i++) {
+			const Node& parent = network_.getNode(n.getParents()[i]);
+			score.parentValues.push_back(
+			    obs.rowData<Code>(parent.getObservationRow()));
+			score.factors.push_back(n.getFactor(i));
+		}
+	}
+	NetworkPolynomial polynomial(network_);
+
+	const size_t samples = obs.getColCount();
+	const size_t blockSize = DiscreteObservations::SAMPLE_BLOCK_SIZE;
+	const size_t blocks = (samples + blockSize - 1) / blockSize;
+	std::vector<double> result(samples, 0.0);
+
+	forEachShard(blocks, threads, [&](size_t block) {
+		size_t begin = block * blockSize;
+		size_t count = std::min(blockSize, samples - begin);
+		double* logLikelihood = result.data() + begin;
+		std::vector<unsigned char> missing(count, 0);
+		std::vector<unsigned int> index(count);
+
+		// Missingness of the nodes, blocks start at a bitmap word
+		std::vector<uint64_t> incomplete((count + 63) / 64, 0);
+		for(const auto& score : scores) {
+			const uint64_t* words = score.missing + begin / 64;
+			for(size_t word = 0; word < incomplete.size(); word++) {
+				incomplete[word] |= words[word];
+			}
+		}
+		for(size_t s = 0; s < count; s++) {
+			missing[s] = DiscreteObservations::isSet(incomplete.data(), s);
+		}
+
+		for(const auto& score : scores) {
+			const Code* values = score.values + begin;
+			for(size_t s = 0; s < count; s++) {
+				index[s] = missing[s] ? 0 : values[s];
+			}
+			for(unsigned int i = 0; i < score.factors.size(); i++) {
+				const Code* parentValues = score.parentValues[i] + begin;
+				unsigned int factor = score.factors[i] * score.cardinality;
+				for(size_t s = 0; s < count; s++) {
+					index[s] += missing[s] ? 0 : factor * parentValues[s];
+				}
+			}
+			const double* logCPT = score.logCPT.data();
+			for(size_t s = 0; s < count; s++) {
+				logLikelihood[s] += logCPT[index[s]];
+			}
+		}
+
+		// Samples with missing values are marginalised over the unobserved nodes
+		std::vector<int> evidence(scores.size());
+		for(size_t s = 0; s < count; s++) {
+			if(!missing[s]) {
+				continue;
+			}
+			for(unsigned int id = 0; id < scores.size(); id++) {
+				evidence[id] =
+				    DiscreteObservations::isSet(scores[id].missing, begin + s)
+				        ? DiscreteObservations::NA
+				        : scores[id].values[begin + s];
+			}
+			logLikelihood[s] = std::log(polynomial.evaluate(evidence));
+		}
+	});
+	return result;
 }
 
 std::vector<Factor> ProbabilityHandler::createFactorList(
@@ -1,6 +1,7 @@
 #ifndef PROBABILITYHANDLER_H
 #define PROBABILITYHANDLER_H
 
+#include "DiscreteObservations.h"
 #include "Network.h"
 #include "Factor.h"
 
@@ -104,6 +105,54 @@ class ProbabilityHandler
 	 */
 	float calculateLikelihoodOfTheData(const Matrix<int>& obs) const;
 
+	/**calculateLikelihoodOfTheData
+	 *
+	 * @param obs, the observation matrix containing distinct discretised observations
+	 * @param weights, the number of occurrences of every sample, empty if every sample occurs once
+	 *
+	 * @return the log likelihood of the data
+	 *
+	 */
+	float calculateLikelihoodOfTheData(const Matrix<int>& obs,
+	                                   const std::vector<unsigned int>& weights) const;
+
+	/**calculateLikelihoodOfTheData
+	 *
+	 * @param obs, the discretised observations in compact storage
+	 * @param weights, the number of occurrences of every sample, empty if every sample occurs once
+	 *
+	 * @return the log likelihood of the data
+	 *
+	 */
+	float calculateLikelihoodOfTheData(const DiscreteObservations& obs,
+	                                   const std::vector<unsigned int>& weights) const;
+
+	/**calculateLogLikelihoodOfSamples
+	 *
+	 * @param obs, the observation matrix containing the discretised observations
+	 * @param threads, number of threads used for scoring, 0 to use all cores
+	 *
+	 * @return the log likelihood of every sample, in the order of the columns of obs
+	 *
+	 * Complete samples are scored in blocks by summing the logarithms of the CPT
+	 * entries node by node. Unobserved values are marginalised out using the
+	 * network polynomial.
+	 */
+	std::vector<double>
+	calculateLogLikelihoodOfSamples(const Matrix<int>& obs,
+	                                unsigned int threads = 0) const;
+
+	/**calculateLogLikelihoodOfSamples
+	 *
+	 * @param obs, the discretised observations in compact storage
+	 * @param threads, number of threads used for scoring, 0 to use all cores
+	 *
+	 * @return the log likelihood of every sample, in the order of the columns of obs
+	 */
+	std::vector<double>
+	calculateLogLikelihoodOfSamples(const DiscreteObservations& obs,
+	                                unsigned int threads = 0) const;
+
 	private:
 
 	/**createFactorisation
@@ -144,18 +193,30 @@ class ProbabilityHandler
 	enumerate(const std::vector<unsigned int>& factorisation,
 	          const std::vector<std::vector<int>>& valueAssignment);
 
-	/**getParentValues
+	/**computeLikelihoodOfTheData
 	 *
-	 * @param n,
-	 * @param obs,
-	 * @param index,
+	 * @param obs, the discretised observations in compact storage
+	 * @param weights, the number of occurrences of every sample, empty if every sample occurs once
 	 *
-	 * @return
+	 * @return the likelihood of the complete samples. Code is the type of the
+	 * stored observations, see DiscreteObservations::getCodeSize.
+	 */
+	template <typename Code>
+	float computeLikelihoodOfTheData(const DiscreteObservations& obs,
+	                                 const std::vector<unsigned int>& weights) const;
+
+	/**computeLogLikelihoodOfSamples
 	 *
+	 * @param obs, the discretised observations in compact storage
+	 * @param threads, number of threads used for scoring
 	 *
+	 * @return the log likelihood of every sample. Code is the type of the
+	 * stored observations, see DiscreteObservations::getCodeSize.
 	 */
-	int getParentValues(const Node& n, const Matrix<int>& obs,
-	                    unsigned int index) const;
+	template <typename Code>
+	std::vector<double>
+	computeLogLikelihoodOfSamples(const DiscreteObservations& obs,
+	                              unsigned int threads) const;
 
 	/**getResult
 	 *
@@ -1,4 +1,5 @@
 #include "QueryExecuter.h"
+#include "NetworkPolynomial.h"
 
 QueryExecuter::QueryExecuter(NetworkController& c)
     : networkController_(c),
@@ -100,7 +101,17 @@ std::pair<float, std::vector<std::string>> QueryExecuter::execute()
 	if(hasInterventions()) {
 		executeInterventions();
 	}
-	probability = computeProbability();
+	try {
+		probability = computeProbability();
+	} catch(...) {
+		if(hasInterventions()) {
+			reverseInterventions();
+		}
+		if(cf) {
+			networkController_.getNetwork().removeHypoNodes();
+		}
+		throw;
+	}
 	if(hasInterventions()) {
 		reverseInterventions();
 	}
@@ -110,6 +121,41 @@ std::pair<float, std::vector<std::string>> QueryExecuter::execute()
 	return probability;
 }
 
+std::pair<float, std::vector<Matrix<float>>>
+QueryExecuter::computeParameterDerivatives()
+{
+	if(nonInterventionNodeID_.empty()) {
+		throw std::invalid_argument("Derivatives can only be computed for "
+		                            "probability queries");
+	}
+	if(!argmaxNodeIDs_.empty()) {
+		throw std::invalid_argument(
+		    "Derivatives are not defined for argmax queries");
+	}
+	if(isCounterfactual()) {
+		throw std::invalid_argument(
+		    "Derivatives are not supported for counterfactuals");
+	}
+	if(hasInterventions()) {
+		executeInterventions();
+	}
+	std::pair<float, std::vector<Matrix<float>>> result;
+	try {
+		result = executeParameterDerivatives();
+	} catch(...) {
+		// The network must not stay intervened, e.g. for a zero probability
+		// condition
+		if(hasInterventions()) {
+			reverseInterventions();
+		}
+		throw;
+	}
+	if(hasInterventions()) {
+		reverseInterventions();
+	}
+	return result;
+}
+
 std::pair<float, std::vector<std::string>> QueryExecuter::computeProbability()
 {
 	std::vector<std::string> temp;
@@ -235,6 +281,59 @@ float QueryExecuter::executeProbability()
 	}
 }
 
+std::pair<float, std::vector<Matrix<float>>>
+QueryExecuter::executeParameterDerivatives()
+{
+	const Network& network = networkController_.getNetwork();
+	NetworkPolynomial polynomial(network);
+
+	std::vector<int> evidence = conditionValues_;
+	for(auto& id : nonInterventionNodeID_) {
+		evidence[id] = nonInterventionValues_[id];
+	}
+	NetworkPolynomial::Parameters jointDerivatives;
+	double joint = polynomial.differentiate(evidence, jointDerivatives);
+
+	// Quotient rule for P(q|e) = P(q,e) / P(e)
+	double probability = joint;
+	NetworkPolynomial::Parameters derivatives = jointDerivatives;
+	if(!conditionNodeID_.empty()) {
+		NetworkPolynomial::Parameters conditionDerivatives;
+		double condition =
+		    polynomial.differentiate(conditionValues_, conditionDerivatives);
+		if(condition <= 0.0) {
+			throw std::invalid_argument(
+			    "The condition has a probability of zero");
+		}
+		probability = joint / condition;
+		for(unsigned int id = 0; id < derivatives.size(); id++) {
+			for(unsigned int i = 0; i < derivatives[id].size(); i++) {
+				derivatives[id][i] =
+				    (jointDerivatives[id][i] -
+				     probability * conditionDerivatives[id][i]) /
+				    condition;
+			}
+		}
+	}
+
+	std::vector<Matrix<float>> result;
+	result.reserve(network.size());
+	for(const Node& n : network.getNodes()) {
+		const Matrix<float>& probMatrix = n.getProbabilityMatrix();
+		Matrix<float> derivative(probMatrix.getColNames(),
+		                         probMatrix.getRowNames(), 0.0f);
+		const auto& values = derivatives[n.getID()];
+		for(unsigned int row = 0; row < probMatrix.getRowCount(); row++) {
+			for(unsigned int col = 0; col < probMatrix.getColCount(); col++) {
+				derivative.setData(values[col + row * probMatrix.getColCount()],
+				                   col, row);
+			}
+		}
+		result.push_back(std::move(derivative));
+	}
+	return std::make_pair(float(probability), result);
+}
+
 void QueryExecuter::setNonIntervention(const unsigned int nodeID,
                                        const unsigned int valueID)
 {
@@ -40,6 +40,20 @@ class QueryExecuter{
 	 */
 	std::pair<float,std::vector<std::string>> execute();
 
+	/**computeParameterDerivatives
+	 *
+	 * @return pair of
+	 * (1) probability of the query
+	 * (2) partial derivatives of this probability with respect to every CPT
+	 * entry. The i-th matrix has the layout of the probability matrix of the
+	 * node with identifier i.
+	 *
+	 * All derivatives are obtained using a single forward and backward pass
+	 * through the network polynomial (two for conditional queries). MAP queries
+	 * and counterfactuals are not supported.
+	 */
+	std::pair<float,std::vector<Matrix<float>>> computeParameterDerivatives();
+
 	/**
 	 * Stores a pair of nodeID and value reflecting a nonIntervention
 	 *
@@ -225,6 +239,16 @@ class QueryExecuter{
 	 */
 	float executeProbability();
 
+	/**executeParameterDerivatives
+	 *
+	 * @return a pair of the query probability and its derivatives with
+	 * respect to all CPT entries
+	 *
+	 * Uses the NetworkPolynomial to differentiate a total-, joint- or
+	 * conditional probability
+	 */
+	std::pair<float,std::vector<Matrix<float>>> executeParameterDerivatives();
+
 	//Reference to the network controller
 	NetworkController& networkController_;	
 	//Instance of a ProbabilityHandler class to calculate the requested probabilities
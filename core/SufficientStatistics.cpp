@@ -0,0 +1,88 @@
+#include "SufficientStatistics.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+SufficientStatistics::SufficientStatistics() : offsets_(1, 0) {}
+
+SufficientStatistics::SufficientStatistics(
+    const std::vector<unsigned int>& cardinalities,
+    const std::vector<size_t>& sizes)
+    : offsets_(1, 0), cardinalities_(cardinalities)
+{
+	if(cardinalities.size() != sizes.size()) {
+		throw std::invalid_argument(
+		    "The cardinalities do not match the number of nodes");
+	}
+	for(auto size : sizes) {
+		offsets_.push_back(offsets_.back() + size);
+	}
+	values_.assign(offsets_.back(), 0.0);
+}
+
+size_t SufficientStatistics::getNumberOfNodes() const
+{
+	return cardinalities_.size();
+}
+
+size_t SufficientStatistics::size(unsigned int id) const
+{
+	return offsets_[id + 1] - offsets_[id];
+}
+
+double* SufficientStatistics::data(unsigned int id)
+{
+	return values_.data() + offsets_[id];
+}
+
+const double* SufficientStatistics::data(unsigned int id) const
+{
+	return values_.data() + offsets_[id];
+}
+
+void SufficientStatistics::clear()
+{
+	std::fill(values_.begin(), values_.end(), 0.0);
+}
+
+void SufficientStatistics::add(const SufficientStatistics& other)
+{
+	if(other.values_.size() != values_.size()) {
+		throw std::invalid_argument("The statistics have different layouts");
+	}
+	double* values = values_.data();
+	const double* others = other.values_.data();
+	for(size_t i = 0; i < values_.size(); i++) {
+		values[i] += others[i];
+	}
+}
+
+double SufficientStatistics::maximise(unsigned int id,
+                                      std::vector<double>& parameters) const
+{
+	const unsigned int cardinality = cardinalities_[id];
+	const double* counts = data(id);
+	double* parameter = parameters.data();
+	double difference = 0.0;
+	for(size_t row = 0; row < size(id); row += cardinality) {
+		double rowsum = 0.0;
+		for(unsigned int col = 0; col < cardinality; col++) {
+			rowsum += counts[row + col];
+		}
+		// Branch once per row so that the inner loops vectorise
+		if(rowsum > 0.0) {
+			for(unsigned int col = 0; col < cardinality; col++) {
+				double probability = counts[row + col] / rowsum;
+				difference += std::fabs(parameter[row + col] - probability);
+				parameter[row + col] = probability;
+			}
+		} else {
+			for(unsigned int col = 0; col < cardinality; col++) {
+				difference += std::fabs(parameter[row + col] - 1.0 / cardinality);
+				parameter[row + col] = 1.0 / cardinality;
+			}
+		}
+	}
+	return difference;
+}
@@ -0,0 +1,97 @@
+#ifndef SUFFICIENTSTATISTICS_H
+#define SUFFICIENTSTATISTICS_H
+
+#include <cstddef>
+#include <vector>
+
+/**
+ * Expected counts of the CPT entries of all nodes, stored in one contiguous
+ * buffer of doubles. The counts of a node follow the layout of its CPT, i.e.
+ * the entries of a parent configuration are adjacent, and the nodes are stored
+ * one after another. Reductions and the normalisation of the rows therefore
+ * run over contiguous memory without any indirection.
+ */
+class SufficientStatistics
+{
+	public:
+	/**SufficientStatistics
+	 *
+	 * @return SufficientStatistics object without any nodes
+	 */
+	SufficientStatistics();
+
+	/**SufficientStatistics
+	 *
+	 * @param cardinalities, the number of values of every node
+	 * @param sizes, the number of CPT entries of every node
+	 *
+	 * @return SufficientStatistics object filled with zeros
+	 */
+	SufficientStatistics(const std::vector<unsigned int>& cardinalities,
+	                     const std::vector<size_t>& sizes);
+
+	/**getNumberOfNodes
+	 *
+	 * @return the number of nodes
+	 */
+	size_t getNumberOfNodes() const;
+
+	/**size
+	 *
+	 * @param id, the node identifier
+	 *
+	 * @return the number of CPT entries of the node
+	 */
+	size_t size(unsigned int id) const;
+
+	/**data
+	 *
+	 * @param id, the node identifier
+	 *
+	 * @return pointer to the first count of the node
+	 */
+	double* data(unsigned int id);
+
+	/**data
+	 *
+	 * @param id, the node identifier
+	 *
+	 * @return pointer to the first count of the node
+	 */
+	const double* data(unsigned int id) const;
+
+	/**clear
+	 *
+	 * Sets all counts to zero
+	 */
+	void clear();
+
+	/**add
+	 *
+	 * @param other, statistics with the same layout
+	 *
+	 * Adds the counts of other element-wise
+	 */
+	void add(const SufficientStatistics& other);
+
+	/**maximise
+	 *
+	 * @param id, the node identifier
+	 * @param parameters, the CPT entries of the node, replaced by the
+	 * normalised counts. Parent configurations without any counts get a
+	 * uniform distribution.
+	 *
+	 * @return the sum of the absolute changes of the parameters
+	 */
+	double maximise(unsigned int id, std::vector<double>& parameters) const;
+
+	private:
+	//Counts of all nodes
+	std::vector<double> values_;
+	//Position of the first count of every node, followed by the total size
+	std::vector<size_t> offsets_;
+	//Number of values of every node
+	std::vector<unsigned int> cardinalities_;
+};
+
+#endif
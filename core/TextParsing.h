@@ -0,0 +1,449 @@
+#ifndef TEXTPARSING_H
+#define TEXTPARSING_H
+
+#include "Parallel.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/**
+ * A token of a line, given as half open range [first, second) of characters.
+ */
+using TextToken = std::pair<const char*, const char*>;
+
+/**
+ * Parallel parsers split their input into chunks of whole lines. Every chunk
+ * holds at least MINIMUM_CHUNK_SIZE bytes, every thread gets up to
+ * CHUNKS_PER_THREAD chunks to balance lines of different lengths.
+ */
+constexpr size_t MINIMUM_CHUNK_SIZE = 1 << 20;
+constexpr size_t CHUNKS_PER_THREAD = 4;
+
+/**findLineEnd
+ *
+ * @param begin, first character of the remaining text
+ * @param end, one past the last character of the text
+ *
+ * @return the position of the next line feed, end if there is none
+ */
+inline const char* findLineEnd(const char* begin, const char* end)
+{
+	const void* lineEnd = std::memchr(begin, '\n', end - begin);
+	return lineEnd == nullptr ? end : static_cast<const char*>(lineEnd);
+}
+
+/**isBlankLine
+ *
+ * @param begin, first character of the line
+ * @param end, one past the last character of the line, excluding the line feed
+ *
+ * @return true, if the line consists of tabs, spaces and carriage returns only
+ */
+inline bool isBlankLine(const char* begin, const char* end)
+{
+	for(; begin != end; begin++) {
+		if(*begin != '\t' && *begin != ' ' && *begin != '\r') {
+			return false;
+		}
+	}
+	return true;
+}
+
+/**splitIntoChunks
+ *
+ * @param begin, first character of the text
+ * @param end, one past the last character of the text
+ * @param chunks, the desired number of chunks
+ *
+ * @return the boundaries of up to chunks non-empty ranges of whole lines.
+ * Chunk i spans [boundaries[i], boundaries[i + 1]).
+ */
+inline std::vector<const char*> splitIntoChunks(const char* begin,
+                                                const char* end, size_t chunks)
+{
+	std::vector<const char*> boundaries {begin};
+	const size_t size = end - begin;
+	for(size_t chunk = 1; chunk < chunks; chunk++) {
+		const char* position = begin + size * chunk / chunks;
+		if(position <= boundaries.back()) {
+			continue;
+		}
+		// Move the boundary behind the line feed ending the current line
+		position = findLineEnd(position - 1, end);
+		if(position == end) {
+			break;
+		}
+		boundaries.push_back(position + 1);
+	}
+	if(boundaries.back() != end) {
+		boundaries.push_back(end);
+	}
+	return boundaries;
+}
+
+/**forEachLine
+ *
+ * @param begin, first character of the text
+ * @param end, one past the last character of the text
+ * @param func, callable invoked with the begin and end of every line,
+ * excluding the line feed
+ */
+template <typename F>
+void forEachLine(const char* begin, const char* end, const F& func)
+{
+	while(begin < end) {
+		const char* lineEnd = findLineEnd(begin, end);
+		func(begin, lineEnd);
+		begin = lineEnd < end ? lineEnd + 1 : end;
+	}
+}
+
+/**
+ * A text split into chunks of whole lines. Rows are the non-blank lines.
+ */
+struct TextChunks
+{
+	//Chunk i spans [boundaries[i], boundaries[i + 1])
+	std::vector<const char*> boundaries;
+	//Index of the first row of every chunk, followed by the number of rows
+	std::vector<size_t> firstRow;
+	//Line number of the first line of every chunk
+	std::vector<size_t> firstLine;
+
+	size_t size() const { return boundaries.size() - 1; }
+};
+
+/**indexChunks
+ *
+ * @param begin, first character of the text
+ * @param end, one past the last character of the text
+ * @param firstLine, line number of the line starting at begin
+ * @param threads, number of threads to use
+ *
+ * @return the text split into chunks for parallel parsing. The rows and lines
+ * of the chunks are counted in parallel, so every chunk knows where its rows
+ * belong before any of them is parsed.
+ */
+inline TextChunks indexChunks(const char* begin, const char* end,
+                              size_t firstLine, unsigned int threads)
+{
+	TextChunks chunks;
+	threads = getNumberOfThreads(threads);
+	chunks.boundaries = splitIntoChunks(
+	    begin, end,
+	    std::min<size_t>(threads * CHUNKS_PER_THREAD,
+	                     std::max<size_t>(1, (end - begin) / MINIMUM_CHUNK_SIZE)));
+	chunks.firstRow.assign(chunks.size() + 1, 0);
+	chunks.firstLine.assign(chunks.size() + 1, firstLine);
+	forEachShard(chunks.size(), threads, [&](size_t chunk) {
+		size_t rows = 0;
+		size_t lines = 0;
+		forEachLine(chunks.boundaries[chunk], chunks.boundaries[chunk + 1],
+		            [&](const char* lineBegin, const char* lineEnd) {
+			            rows += isBlankLine(lineBegin, lineEnd) ? 0 : 1;
+			            lines++;
+		            });
+		chunks.firstRow[chunk + 1] = rows;
+		chunks.firstLine[chunk + 1] = lines;
+	});
+	for(size_t chunk = 0; chunk < chunks.size(); chunk++) {
+		chunks.firstRow[chunk + 1] += chunks.firstRow[chunk];
+		chunks.firstLine[chunk + 1] += chunks.firstLine[chunk];
+	}
+	return chunks;
+}
+
+/**splitLine
+ *
+ * @param begin, first character of the line
+ * @param end, one past the last character of the line, excluding the line feed
+ * @param tokens, receives the tokens of the line
+ *
+ * Splits a line at tabs and spaces. Consecutive delimiters are merged and a
+ * trailing carriage return is ignored.
+ */
+inline void splitLine(const char* begin, const char* end,
+                      std::vector<TextToken>& tokens)
+{
+	tokens.clear();
+	if(begin != end && *(end - 1) == '\r') {
+		end--;
+	}
+	const char* position = begin;
+	while(position != end) {
+		while(position != end && (*position == '\t' || *position == ' ')) {
+			position++;
+		}
+		const char* token = position;
+		while(position != end && *position != '\t' && *position != ' ') {
+			position++;
+		}
+		if(token != position) {
+			tokens.emplace_back(token, position);
+		}
+	}
+}
+
+/**parseValue
+ *
+ * @param begin, first character of the token
+ * @param end, one past the last character of the token
+ * @param value, receives the token
+ */
+inline void parseValue(const char* begin, const char* end, std::string& value)
+{
+	value.assign(begin, end);
+}
+
+/**parseValue
+ *
+ * @param begin, first character of the token
+ * @param end, one past the last character of the token
+ * @param value, receives the decimal integer stored in the token
+ *
+ * Converts the token without allocating or consulting the locale. Tokens
+ * that are not completely numeric or exceed the range of T are rejected with
+ * a std::invalid_argument exception.
+ */
+template <typename T>
+typename std::enable_if<std::is_integral<T>::value>::type
+parseValue(const char* begin, const char* end, T& value)
+{
+	const char* position = begin;
+	bool negative = false;
+	if(position != end && (*position == '-' || *position == '+')) {
+		negative = *position == '-';
+		position++;
+	}
+	if(position == end || (negative && std::is_unsigned<T>::value)) {
+		throw std::invalid_argument("Cannot convert '" +
+		                            std::string(begin, end) + "'");
+	}
+	const unsigned long long limit =
+	    static_cast<unsigned long long>(std::numeric_limits<T>::max()) +
+	    (negative ? 1 : 0);
+	unsigned long long result = 0;
+	for(; position != end; position++) {
+		unsigned int digit = static_cast<unsigned char>(*position) - '0';
+		if(digit > 9 || result > (limit - digit) / 10) {
+			throw std::invalid_argument("Cannot convert '" +
+			                            std::string(begin, end) + "'");
+		}
+		result = result * 10 + digit;
+	}
+	value = static_cast<T>(negative ? 0 - result : result);
+}
+
+/**equalsIgnoringCase
+ *
+ * @param begin, first character of the token
+ * @param end, one past the last character of the token
+ * @param word, lower case ASCII word
+ *
+ * @return true, if the token equals the word in any case
+ */
+inline bool equalsIgnoringCase(const char* begin, const char* end,
+                               const char* word)
+{
+	for(; begin != end; begin++, word++) {
+		char c = *begin >= 'A' && *begin <= 'Z' ? *begin - 'A' + 'a' : *begin;
+		if(*word == '\0' || c != *word) {
+			return false;
+		}
+	}
+	return *word == '\0';
+}
+
+/**parseSpecialNumber
+ *
+ * @param begin, first character of the token
+ * @param end, one past the last character of the token
+ * @param value, receives the number stored in the token
+ *
+ * @return true, if the token is an optionally signed "inf", "infinity" or
+ * "nan" in any case
+ */
+inline bool parseSpecialNumber(const char* begin, const char* end,
+                               double& value)
+{
+	bool negative = begin != end && *begin == '-';
+	if(begin != end && (*begin == '-' || *begin == '+')) {
+		begin++;
+	}
+	if(equalsIgnoringCase(begin, end, "inf") ||
+	   equalsIgnoringCase(begin, end, "infinity")) {
+		value = std::numeric_limits<double>::infinity();
+	} else if(equalsIgnoringCase(begin, end, "nan")) {
+		value = std::numeric_limits<double>::quiet_NaN();
+	} else {
+		return false;
+	}
+	value = negative ? -value : value;
+	return true;
+}
+
+/**parseLeadingNumber
+ *
+ * @param begin, first character of the token
+ * @param end, one past the last character of the token
+ * @param value, receives the decimal number at the beginning of the token
+ *
+ * @return one past the last character of the number, begin if the token does
+ * not start with a finite decimal number
+ *
+ * Reads an optionally signed decimal number with a decimal point and an
+ * optional exponent, regardless of the locale set by the application. Up to
+ * 19 significant digits with a small exponent are converted exactly without
+ * a library call. Other numbers are passed to strtod as their digits and
+ * exponent, which do not depend on the locale either. Only numbers with more
+ * than 96 significant digits need to allocate.
+ */
+inline const char* parseLeadingNumber(const char* begin, const char* end,
+                                      double& value)
+{
+	const char* position = begin;
+	bool negative = position != end && *position == '-';
+	if(position != end && (*position == '-' || *position == '+')) {
+		position++;
+	}
+	auto isDigit = [](char c) { return c >= '0' && c <= '9'; };
+	const char* integer = position;
+	while(position != end && isDigit(*position)) {
+		position++;
+	}
+	const char* integerEnd = position;
+	const char* fraction = position;
+	if(position != end && *position == '.') {
+		fraction = ++position;
+		while(position != end && isDigit(*position)) {
+			position++;
+		}
+	}
+	const char* fractionEnd = position;
+	if(integer == integerEnd && fraction == fractionEnd) {
+		return begin;
+	}
+
+	// The exponent belongs to the number only if it has digits
+	long exponent = 0;
+	if(position != end && (*position == 'e' || *position == 'E')) {
+		const char* exponentBegin = position + 1;
+		bool negativeExponent = exponentBegin != end && *exponentBegin == '-';
+		if(exponentBegin != end &&
+		   (*exponentBegin == '-' || *exponentBegin == '+')) {
+			exponentBegin++;
+		}
+		const char* exponentEnd = exponentBegin;
+		for(; exponentEnd != end && isDigit(*exponentEnd); exponentEnd++) {
+			// Larger exponents over- or underflow anyway
+			if(exponent < 100000) {
+				exponent = exponent * 10 + (*exponentEnd - '0');
+			}
+		}
+		if(exponentEnd != exponentBegin) {
+			exponent = negativeExponent ? -exponent : exponent;
+			position = exponentEnd;
+		}
+	}
+	exponent -= static_cast<long>(fractionEnd - fraction);
+
+	// The significant digits form an integer scaled by 10^exponent
+	const TextToken parts[] = {{integer, integerEnd}, {fraction, fractionEnd}};
+	unsigned long long mantissa = 0;
+	size_t significant = 0;
+	for(const auto& part : parts) {
+		for(const char* c = part.first; c != part.second; c++) {
+			if(significant != 0 || *c != '0') {
+				mantissa = significant < 19 ? mantissa * 10 + (*c - '0') : mantissa;
+				significant++;
+			}
+		}
+	}
+
+	if(significant == 0) {
+		value = 0.0;
+	} else if(significant <= 19 && mantissa <= (1ull << 53) &&
+	          exponent >= -22 && exponent <= 22) {
+		// Both factors are exact, so the result is correctly rounded
+		static const double powers[] = {
+		    1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+		    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+		value = exponent < 0 ? mantissa / powers[-exponent]
+		                     : mantissa * powers[exponent];
+	} else {
+		char local[128];
+		std::string allocated;
+		char* buffer = local;
+		if(significant + 32 > sizeof(local)) {
+			allocated.resize(significant + 32);
+			buffer = &allocated[0];
+		}
+		char* out = buffer;
+		for(const auto& part : parts) {
+			for(const char* c = part.first; c != part.second; c++) {
+				if(out != buffer || *c != '0') {
+					*out++ = *c;
+				}
+			}
+		}
+		std::snprintf(out, 32, "e%ld", exponent);
+		value = std::strtod(buffer, nullptr);
+		if(std::isinf(value)) {
+			return begin;
+		}
+	}
+	value = negative ? -value : value;
+	return position;
+}
+
+/**parseNumber
+ *
+ * @param begin, first character of the token
+ * @param end, one past the last character of the token
+ * @param value, receives the floating point number stored in the token
+ *
+ * @return true, if the whole token is a number
+ *
+ * Finite numbers are read by parseLeadingNumber, so a decimal point is
+ * expected regardless of the locale set by the application. Numbers too
+ * large for a double are rejected, too small ones become 0 or subnormal.
+ */
+inline bool parseNumber(const char* begin, const char* end, double& value)
+{
+	if(begin != end && parseLeadingNumber(begin, end, value) == end) {
+		return true;
+	}
+	return parseSpecialNumber(begin, end, value);
+}
+
+/**parseValue
+ *
+ * @param begin, first character of the token
+ * @param end, one past the last character of the token
+ * @param value, receives the floating point number stored in the token
+ *
+ * Tokens that are not completely numeric are rejected with a
+ * std::invalid_argument exception.
+ */
+template <typename T>
+typename std::enable_if<std::is_floating_point<T>::value>::type
+parseValue(const char* begin, const char* end, T& value)
+{
+	double result;
+	if(!parseNumber(begin, end, result)) {
+		throw std::invalid_argument("Cannot convert '" +
+		                            std::string(begin, end) + "'");
+	}
+	value = static_cast<T>(result);
+}
+
+#endif
@@ -1,39 +1,92 @@
 #include "NetworkController.h"
 #include "Parser.h"
+#include <fstream>
 #include <iostream>
 
 int main(int argc, char* argv[])
 {
 	NetworkController c;
-	if(argc < 4) {
-		std::cout
-		    << "Insufficient number of parameters\n\n"
-		    << "Usage:\n\t" << argv[0]
-		    << " observations.txt discretisation_control.json network.tgf\n\n"
-		    << "or:\n\t" << argv[0]
-		    << " observations.txt discretisation_control.json network.sif "
-		       "network.na\n";
-
-		return -1;
-	}
+	if(argc == 3 && std::string(argv[1]) == "--snapshot") {
+		c.loadSnapshot(argv[2]);
+	} else {
+		// Options may follow the positional arguments
+		std::string snapshot = "";
+		std::string telemetry = "";
+		std::string cache = "";
+		bool accelerate = false;
+		std::vector<std::string> arguments;
+		for(int i = 1; i < argc; i++) {
+			std::string argument = argv[i];
+			if(argument == "--save-snapshot" && i + 1 < argc) {
+				snapshot = argv[++i];
+			} else if(argument == "--telemetry" && i + 1 < argc) {
+				telemetry = argv[++i];
+			} else if(argument == "--discretisation-cache" && i + 1 < argc) {
+				cache = argv[++i];
+			} else if(argument == "--accelerate") {
+				accelerate = true;
+			} else {
+				arguments.push_back(argument);
+			}
+		}
 
-	std::string datafile = argv[1];
-	std::string controlfile = argv[2];
-	std::string networkfile = argv[3];
+		if(arguments.size() < 3) {
+			std::cout
+			    << "Insufficient number of parameters\n\n"
+			    << "Usage:\n\t" << argv[0]
+			    << " observations.txt discretisation_control.json network.tgf"
+			       " [options]\n\n"
+			    << "or:\n\t" << argv[0]
+			    << " observations.txt discretisation_control.json network.sif "
+			       "network.na [options]\n\n"
+			    << "or:\n\t" << argv[0] << " --snapshot model.snapshot\n\n"
+			    << "Options:\n"
+			    << "\t--save-snapshot model.snapshot\tstore the trained network\n"
+			    << "\t--telemetry em.json\t\twrite the EM telemetry as JSON, - for stdout\n"
+			    << "\t--discretisation-cache directory\treuse the discretised observations of earlier runs\n"
+			    << "\t--accelerate\t\t\taccelerate EM and report the iterations saved\n";
 
-	if(argc == 5) {
-		std::string nodefile = argv[4];
-		c.loadNetwork(nodefile);
-	}
+			return -1;
+		}
+
+		std::string datafile = arguments[0];
+		std::string controlfile = arguments[1];
+		std::string networkfile = arguments[2];
 
-	c.loadNetwork(networkfile);
-	c.loadObservations(datafile, controlfile);
-	c.trainNetwork();
+		if(arguments.size() == 4) {
+			std::string nodefile = arguments[3];
+			c.loadNetwork(nodefile);
+		}
 
-	std::cout << c.getNetwork()
-	          << "\nNumber of EM runs: " << c.getNumberOfEMRuns()
-	          << "\nTime used for training: " << c.getTimeInMicroSeconds()
-	          << "µs" << std::endl;
+		c.loadNetwork(networkfile);
+		if(accelerate) {
+			EMSettings settings = c.getEMSettings();
+			settings.accelerate = true;
+			settings.measureIterationsSaved = true;
+			c.setEMSettings(settings);
+		}
+		c.setDiscretisationCache(cache);
+		c.loadObservations(datafile, controlfile);
+		c.trainNetwork();
+		if(!snapshot.empty()) {
+			c.saveSnapshot(snapshot);
+		}
+		if(telemetry == "-") {
+			c.writeEMTelemetry(std::cout);
+		} else if(!telemetry.empty()) {
+			std::ofstream file(telemetry);
+			c.writeEMTelemetry(file);
+		}
+
+		std::cout << c.getNetwork()
+		          << "\nNumber of EM runs: " << c.getNumberOfEMRuns();
+		if(accelerate) {
+			std::cout << "\nEM iterations saved by the acceleration: "
+			          << c.getEMIterationsSaved();
+		}
+		std::cout << "\nTime used for training: " << c.getTimeInMicroSeconds()
+		          << "µs" << std::endl;
+	}
 
 	std::string input = "";
 	std::cout << "Please enter a query" << std::endl;
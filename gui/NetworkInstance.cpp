@@ -54,7 +54,10 @@ void NetworkInstance::loadSamples(const QString& samples, const DiscretisationSe
 	discretisationSettings_ = settings;
 
 	try {
-		nc_.loadObservations(dataFile_.toStdString(), settings, deselectedSamples_);
+		// All samples are kept, so the selection can change without reloading.
+		// The discretisation is therefore computed from all samples of the file.
+		nc_.loadObservations(dataFile_.toStdString(), settings);
+		nc_.setDeselectedSamples(deselectedSamples_);
 	} catch(const boost::property_tree::ptree_bad_data&) {
 		emit newLogMessage("Error in discretisation control. Could not convert parameter to required type.");
 		return;
@@ -384,6 +387,18 @@ void NetworkInstance::setDiscretisationSettings(const DiscretisationSettings& se
 void NetworkInstance::discretise(const QString& samples,
                                  const std::vector<uint>& deselected)
 {
+	if(trained_ && samples == dataFile_) {
+		// The loaded samples are reselected without discretising them again
+		try {
+			nc_.setDeselectedSamples(deselected);
+			nc_.retrainNetwork();
+			setDeselectedSamples(deselected);
+			emit samplesLoaded(this);
+		} catch(const std::invalid_argument& e) {
+			emit newLogMessage(QString("Error while training the network: ") + e.what());
+		}
+		return;
+	}
 	setDeselectedSamples(deselected);
 	discretisationSelection_->show(samples);
 }
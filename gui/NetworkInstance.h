@@ -521,7 +521,7 @@ private:
     /**
      * @brief deselectedSamples_
      * Vector of samples that are not used for training. The vector contains the
-     * index of the deselected columns in the original matrix. Counting starts at 1.
+     * index of the deselected columns in the original matrix. Counting starts at 0.
      */
     std::vector<unsigned int > deselectedSamples_;
 
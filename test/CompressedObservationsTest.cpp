@@ -0,0 +1,119 @@
+#include "gtest/gtest.h"
+
+#include "../core/CompressedObservations.h"
+#include "../core/DataDistribution.h"
+#include "../core/Discretiser.h"
+#include "../core/EM.h"
+
+#include "config.h"
+
+class CompressedObservationsTest : public ::testing::Test{
+	protected:
+	CompressedObservationsTest()
+	{
+
+	}
+
+	void loadData(Network& n, Matrix<int>& observations, const std::string& data){
+		n.readNetwork(TEST_DATA_PATH("Student.na"));
+		n.readNetwork(TEST_DATA_PATH("Student.sif"));
+		Matrix<std::string> originalObservations (data,false,true);
+		Discretiser disc(originalObservations,TEST_DATA_PATH("controlStudent.json"), observations, n);
+	}
+};
+
+TEST_F(CompressedObservationsTest, Empty){
+	Matrix<int> ob (0,0,0);
+	CompressedObservations c(ob);
+	ASSERT_EQ(0u, c.getSamples().getColCount());
+	ASSERT_TRUE(c.getWeights().empty());
+	ASSERT_TRUE(c.getIndices().empty());
+}
+
+TEST_F(CompressedObservationsTest, DistinctSamples){
+	Matrix<int> ob (5,2,0,{"a","b","c","d","e"},{"X","Y"});
+	std::vector<int> x {0, 1, 0, -1, 0};
+	std::vector<int> y {1, 1, 1, 1, -1};
+	for(unsigned int col = 0; col < 5; col++){
+		ob.setData(x[col], col, 0);
+		ob.setData(y[col], col, 1);
+	}
+	CompressedObservations c(ob);
+	const Matrix<int>& samples = c.getSamples();
+	ASSERT_EQ(4u, samples.getColCount());
+	ASSERT_EQ(2u, samples.getRowCount());
+	ASSERT_EQ(1, samples.findRow("Y"));
+	std::vector<std::string> names {"a","b","d","e"};
+	ASSERT_EQ(names, samples.getColNames());
+	std::vector<unsigned int> weights {2, 1, 1, 1};
+	ASSERT_EQ(weights, c.getWeights());
+	std::vector<unsigned int> indices {0, 1, 0, 2, 3};
+	ASSERT_EQ(indices, c.getIndices());
+	ASSERT_EQ(-1, samples(2, 0));
+	ASSERT_EQ(-1, samples(3, 1));
+}
+
+TEST_F(CompressedObservationsTest, WeightedCounts){
+	Network n;
+	Matrix<int> observations (0,0,-1);
+	loadData(n, observations, TEST_DATA_PATH("StudentData.txt"));
+	CompressedObservations c(observations);
+	ASSERT_LT(c.getSamples().getColCount(), observations.getColCount());
+
+	Network m = n;
+	DataDistribution full (n, observations);
+	full.assignObservationsToNodes();
+	full.distributeObservations();
+	DataDistribution weighted (m, c.getSamples(), c.getWeights());
+	weighted.assignObservationsToNodes();
+	weighted.distributeObservations();
+	for(unsigned int id = 0; id < n.size(); id++){
+		const Matrix<int>& a = n.getNode(id).getObservationMatrix();
+		const Matrix<int>& b = m.getNode(id).getObservationMatrix();
+		ASSERT_EQ(a.getRowCount(), b.getRowCount());
+		ASSERT_EQ(a.getColCount(), b.getColCount());
+		for(unsigned int row = 0; row < a.getRowCount(); row++){
+			for(unsigned int col = 0; col < a.getColCount(); col++){
+				ASSERT_EQ(a(col,row), b(col,row));
+			}
+		}
+	}
+}
+
+TEST_F(CompressedObservationsTest, WeightedEM){
+	Network n;
+	Matrix<int> observations (0,0,-1);
+	loadData(n, observations, TEST_DATA_PATH("dataStudent60.txt"));
+	CompressedObservations c(observations);
+	ASSERT_LT(c.getSamples().getColCount(), observations.getColCount());
+
+	Network m = n;
+	DataDistribution full (n, observations);
+	full.assignObservationsToNodes();
+	full.distributeObservations();
+	DataDistribution weighted (m, c.getSamples(), c.getWeights());
+	weighted.assignObservationsToNodes();
+	weighted.distributeObservations();
+
+	EMSettings settings;
+	settings.randomRestarts = 0;
+	EM a(n, observations, 0.0001f, 100000, settings);
+	EM b(m, c.getSamples(), 0.0001f, 100000, settings, c.getWeights());
+	ASSERT_EQ(a.getNumberOfRuns(), b.getNumberOfRuns());
+	ASSERT_NEAR(a.getLogLikelihood(), b.getLogLikelihood(), 1e-6 * std::fabs(a.getLogLikelihood()));
+	auto pa = NetworkPolynomial::extractParameters(n);
+	auto pb = NetworkPolynomial::extractParameters(m);
+	for(size_t id = 0; id < pa.size(); id++){
+		for(size_t k = 0; k < pa[id].size(); k++){
+			ASSERT_NEAR(pa[id][k], pb[id][k], 1e-5);
+		}
+	}
+}
+
+TEST_F(CompressedObservationsTest, InvalidWeights){
+	Network n;
+	Matrix<int> observations (0,0,-1);
+	loadData(n, observations, TEST_DATA_PATH("StudentData.txt"));
+	std::vector<unsigned int> weights (3, 1);
+	ASSERT_THROW(DataDistribution(n, observations, weights), std::invalid_argument);
+}
@@ -0,0 +1,121 @@
+#include "gtest/gtest.h"
+
+#include "../core/DiscreteObservations.h"
+
+#include <stdexcept>
+
+class DiscreteObservationsTest : public ::testing::Test{
+	protected:
+	DiscreteObservationsTest()
+	: matrix_(70, 2, 0, std::vector<std::string>(), {"A", "B"})
+	{
+		for(unsigned int col = 0; col < 70; col++){
+			matrix_.setData(col % 3, col, 0);
+			matrix_.setData(col % 5 == 0 ? -1 : 1, col, 1);
+		}
+	}
+
+	Matrix<int> matrix_;
+};
+
+TEST_F(DiscreteObservationsTest, Empty){
+	DiscreteObservations obs;
+	ASSERT_EQ(0u, obs.getRowCount());
+	ASSERT_EQ(0u, obs.getColCount());
+	ASSERT_FALSE(obs.containsMissing());
+	ASSERT_EQ(0u, obs.getMemoryUsage());
+}
+
+TEST_F(DiscreteObservationsTest, MatchesMatrix){
+	DiscreteObservations obs(matrix_);
+	ASSERT_EQ(2u, obs.getRowCount());
+	ASSERT_EQ(70u, obs.getColCount());
+	ASSERT_EQ(1, obs.findRow("B"));
+	ASSERT_EQ(-1, obs.findRow("C"));
+	ASSERT_EQ(1u, obs.getCodeSize());
+	ASSERT_TRUE(obs.containsMissing());
+	for(unsigned int row = 0; row < 2; row++){
+		for(unsigned int col = 0; col < 70; col++){
+			ASSERT_EQ(matrix_(col, row), obs(col, row));
+			ASSERT_EQ(matrix_(col, row) == -1, obs.isMissing(col, row));
+		}
+	}
+	ASSERT_EQ(std::vector<int>({0, 1, 2}), obs.getUniqueRowValues(0));
+	ASSERT_EQ(std::vector<int>({-1, 1}), obs.getUniqueRowValues(1));
+	ASSERT_EQ(std::vector<int>({1}), obs.getUniqueRowValues(1, false));
+}
+
+TEST_F(DiscreteObservationsTest, Masks){
+	DiscreteObservations obs(matrix_);
+	ASSERT_EQ(0u, obs.countMissing(0));
+	ASSERT_EQ(14u, obs.countMissing(1));
+	ASSERT_EQ(14u, obs.countIncompleteSamples());
+	for(unsigned int col = 0; col < 70; col++){
+		ASSERT_EQ(col % 5 == 0, DiscreteObservations::isSet(obs.getIncompleteSamples(), col));
+	}
+	ASSERT_EQ(64u, DiscreteObservations::popcount(~uint64_t(0)));
+	ASSERT_EQ(3u, DiscreteObservations::popcount(0x8000000000000101ull));
+
+	for(unsigned int col = 0; col < 70; col++){
+		matrix_.setData(1, col, 1);
+	}
+	DiscreteObservations complete(matrix_);
+	ASSERT_FALSE(complete.containsMissing());
+	ASSERT_EQ(0u, complete.countIncompleteSamples());
+}
+
+TEST_F(DiscreteObservationsTest, CompactStorage){
+	DiscreteObservations obs(matrix_);
+	// One byte per value and one bit per value for the missingness
+	ASSERT_EQ(2u, obs.getWordCount());
+	ASSERT_EQ(2 * 70 + 3 * 2 * sizeof(uint64_t), obs.getMemoryUsage());
+	const uint8_t* codes = obs.rowData<uint8_t>(1);
+	const uint64_t* missing = obs.missingData(1);
+	ASSERT_EQ(0, codes[0]);
+	ASSERT_EQ(1, codes[1]);
+	ASSERT_TRUE(DiscreteObservations::isSet(missing, 65));
+	ASSERT_FALSE(DiscreteObservations::isSet(missing, 66));
+	ASSERT_THROW(obs.rowData<uint16_t>(0), std::invalid_argument);
+}
+
+TEST_F(DiscreteObservationsTest, WideCodes){
+	matrix_.setData(300, 4, 0);
+	DiscreteObservations obs(matrix_);
+	ASSERT_EQ(2u, obs.getCodeSize());
+	ASSERT_EQ(300, obs(4, 0));
+	ASSERT_EQ(300, obs.rowData<uint16_t>(0)[4]);
+	ASSERT_EQ(-1, obs(0, 1));
+	ASSERT_EQ(std::vector<int>({0, 1, 2, 300}), obs.getUniqueRowValues(0));
+	ASSERT_THROW(obs.rowData<uint8_t>(0), std::invalid_argument);
+}
+
+TEST_F(DiscreteObservationsTest, InvalidValues){
+	matrix_.setData(-2, 0, 0);
+	ASSERT_THROW(DiscreteObservations obs(matrix_), std::invalid_argument);
+	matrix_.setData(70000, 0, 0);
+	ASSERT_THROW(DiscreteObservations obs(matrix_), std::invalid_argument);
+}
+
+TEST_F(DiscreteObservationsTest, Transpose){
+	DiscreteObservations obs(matrix_);
+	std::vector<uint8_t> codes;
+	std::vector<uint64_t> incomplete;
+	obs.transpose({1, 0}, nullptr, 3, 70, codes, incomplete);
+	ASSERT_EQ(2u * 67u, codes.size());
+	ASSERT_EQ(2u, incomplete.size());
+	for(unsigned int s = 0; s < 67; s++){
+		unsigned int col = s + 3;
+		ASSERT_EQ(matrix_(col, 0), codes[2 * s + 1]);
+		ASSERT_EQ(col % 5 == 0, DiscreteObservations::isSet(incomplete.data(), s));
+		if(col % 5 != 0){
+			ASSERT_EQ(matrix_(col, 1), codes[2 * s]);
+		}
+	}
+
+	std::vector<unsigned int> indices = {69, 5, 2};
+	obs.transpose({0}, indices.data(), 1, 3, codes, incomplete);
+	ASSERT_EQ(std::vector<uint8_t>({2, 2}), codes);
+	ASSERT_EQ(0u, incomplete[0]);
+	obs.transpose({1}, indices.data(), 0, 2, codes, incomplete);
+	ASSERT_EQ(2u, incomplete[0]);
+}
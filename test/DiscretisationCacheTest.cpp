@@ -0,0 +1,191 @@
+#include "gtest/gtest.h"
+#include "../core/DiscretisationCache.h"
+#include "config.h"
+
+#include <cstdio>
+#include <fstream>
+
+class DiscretisationCacheTest : public ::testing::Test{
+	protected:
+	DiscretisationCacheTest()
+	    : settings_(TEST_DATA_PATH("jsonDiscretiserTest.json"))
+	{
+	}
+
+	~DiscretisationCacheTest()
+	{
+		for(const auto& file : cacheFiles_) {
+			std::remove(file.c_str());
+		}
+	}
+
+	void store(const std::vector<unsigned int>& deleted = {})
+	{
+		DiscretisationCache cache(".");
+		uint64_t hash = 0;
+		uint64_t size = 0;
+		ASSERT_TRUE(DiscretisationCache::computeContentHash(dataFile_, hash, size));
+		Discretiser d(dataFile_, settings_, observations_, network_, deleted);
+		cache.store(dataFile_, hash, size, settings_, deleted, observations_, d);
+		cache.wait();
+		cacheFiles_.push_back(cache.getCacheFile(dataFile_, settings_, deleted));
+		ASSERT_TRUE(std::ifstream(cacheFiles_.back()).good());
+	}
+
+	const std::string dataFile_ = TEST_DATA_PATH("testObservationsIncludingNA.txt");
+	std::vector<std::string> cacheFiles_;
+	DiscretisationSettings settings_;
+	Matrix<int> observations_;
+	Network network_;
+};
+
+TEST_F(DiscretisationCacheTest, RoundTrip){
+	store();
+	DiscretisationCache cache(".");
+	Matrix<int> restored;
+	Network n;
+	ASSERT_TRUE(cache.load(dataFile_, settings_, {}, restored, n));
+	ASSERT_EQ(observations_.getRowNames(), restored.getRowNames());
+	ASSERT_EQ(observations_.getColCount(), restored.getColCount());
+	ASSERT_EQ(observations_.getRowCount(), restored.getRowCount());
+	for(unsigned int row = 0; row < observations_.getRowCount(); row++) {
+		for(unsigned int col = 0; col < observations_.getColCount(); col++) {
+			ASSERT_EQ(observations_(col,row), restored(col,row));
+		}
+	}
+	ASSERT_EQ(network_.getObservationsMap(), n.getObservationsMap());
+	ASSERT_EQ(network_.getObservationsMapR(), n.getObservationsMapR());
+}
+
+TEST_F(DiscretisationCacheTest, DeletedSamples){
+	store({1});
+	DiscretisationCache cache(".");
+	Matrix<int> restored;
+	Network n;
+	ASSERT_FALSE(cache.load(dataFile_, settings_, {}, restored, n));
+	ASSERT_TRUE(cache.load(dataFile_, settings_, {1}, restored, n));
+	ASSERT_EQ(observations_.getColCount(), restored.getColCount());
+	ASSERT_TRUE(cache.load(dataFile_, settings_, {1, 1}, restored, n));
+}
+
+TEST_F(DiscretisationCacheTest, ContentAddressed){
+	store();
+	// A copy of the data file has the same contents
+	const std::string copy = "DiscretisationCacheTestCopy.txt";
+	{
+		std::ifstream input(dataFile_, std::ios::binary);
+		std::ofstream output(copy, std::ios::binary);
+		output << input.rdbuf();
+	}
+	DiscretisationCache cache(".");
+	ASSERT_EQ(cacheFiles_[0], cache.getCacheFile(copy, settings_, {}));
+	Matrix<int> restored;
+	Network n;
+	ASSERT_TRUE(cache.load(copy, settings_, {}, restored, n));
+	ASSERT_EQ(network_.getObservationsMapR(), n.getObservationsMapR());
+
+	// Changing the contents without changing the size is noticed
+	{
+		std::fstream file(copy, std::ios::in | std::ios::out | std::ios::binary);
+		file.seekp(-2, std::ios::end);
+		file.put('9');
+	}
+	ASSERT_NE(cacheFiles_[0], cache.getCacheFile(copy, settings_, {}));
+	ASSERT_FALSE(cache.load(copy, settings_, {}, restored, n));
+	std::remove(copy.c_str());
+}
+
+TEST_F(DiscretisationCacheTest, ChangedWhileParsing){
+	const std::string copy = "DiscretisationCacheTestChanged.txt";
+	{
+		std::ifstream input(dataFile_, std::ios::binary);
+		std::ofstream output(copy, std::ios::binary);
+		output << input.rdbuf();
+	}
+	DiscretisationCache cache(".");
+	uint64_t hash = 0;
+	uint64_t size = 0;
+	ASSERT_TRUE(DiscretisationCache::computeContentHash(copy, hash, size));
+	const std::string original = cache.getCacheFile(copy, settings_, {});
+
+	// The file is rewritten between hashing and parsing
+	{
+		std::fstream file(copy, std::ios::in | std::ios::out | std::ios::binary);
+		file.seekp(-2, std::ios::end);
+		file.put('9');
+	}
+	const std::string changed = cache.getCacheFile(copy, settings_, {});
+	Discretiser d(copy, settings_, observations_, network_);
+	cache.store(copy, hash, size, settings_, {}, observations_, d);
+	cache.wait();
+	cacheFiles_.push_back(original);
+	cacheFiles_.push_back(changed);
+	ASSERT_FALSE(std::ifstream(original).good());
+	ASSERT_FALSE(std::ifstream(changed).good());
+	Matrix<int> restored;
+	Network n;
+	ASSERT_FALSE(cache.load(hash, size, settings_, {}, restored, n));
+	ASSERT_FALSE(cache.load(copy, settings_, {}, restored, n));
+
+	// The parsed contents are stored under their own hash
+	ASSERT_TRUE(DiscretisationCache::computeContentHash(copy, hash, size));
+	cache.store(copy, hash, size, settings_, {}, observations_, d);
+	cache.wait();
+	ASSERT_TRUE(cache.load(copy, settings_, {}, restored, n));
+	std::remove(copy.c_str());
+}
+
+TEST_F(DiscretisationCacheTest, SettingsHash){
+	DiscretisationSettings forward;
+	forward.addToTree("A", "floor");
+	forward.addToTree("B", "ceil");
+	DiscretisationSettings backward;
+	backward.addToTree("B", "ceil");
+	backward.addToTree("A", "floor");
+	ASSERT_EQ(DiscretisationCache::computeSettingsHash(forward),
+	          DiscretisationCache::computeSettingsHash(backward));
+	backward.addToTree("A", "round");
+	ASSERT_NE(DiscretisationCache::computeSettingsHash(forward),
+	          DiscretisationCache::computeSettingsHash(backward));
+}
+
+TEST_F(DiscretisationCacheTest, Mismatch){
+	store();
+	DiscretisationCache cache(".");
+	Matrix<int> restored(1, 1, 7);
+	Network n;
+	DiscretisationSettings changed(settings_);
+	changed.addToTree("Floor", "ceil");
+	ASSERT_NE(DiscretisationCache::computeSettingsHash(settings_),
+	          DiscretisationCache::computeSettingsHash(changed));
+	ASSERT_FALSE(cache.load(dataFile_, changed, {}, restored, n));
+	ASSERT_FALSE(cache.load(TEST_DATA_PATH("testObservations.txt"), settings_, {}, restored, n));
+	ASSERT_FALSE(cache.load("nonexistent.txt", settings_, {}, restored, n));
+	ASSERT_EQ(1u, restored.getRowCount());
+	ASSERT_EQ(7, restored(0,0));
+	ASSERT_TRUE(n.getObservationsMap().empty());
+}
+
+TEST_F(DiscretisationCacheTest, Damaged){
+	store();
+	std::fstream file(cacheFiles_[0], std::ios::in | std::ios::out | std::ios::binary);
+	file.seekp(-1, std::ios::end);
+	file.put('\x7f');
+	file.close();
+	DiscretisationCache cache(".");
+	Matrix<int> restored;
+	Network n;
+	ASSERT_FALSE(cache.load(dataFile_, settings_, {}, restored, n));
+
+	std::ofstream garbage(cacheFiles_[0], std::ios::trunc);
+	garbage << "not a cache";
+	garbage.close();
+	ASSERT_FALSE(cache.load(dataFile_, settings_, {}, restored, n));
+}
+
+TEST_F(DiscretisationCacheTest, Missing){
+	DiscretisationCache cache(".");
+	Matrix<int> restored;
+	Network n;
+	ASSERT_FALSE(cache.load(dataFile_, settings_, {}, restored, n));
+}
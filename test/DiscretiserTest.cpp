@@ -2,6 +2,12 @@
 #include "../core/Discretiser.h"
 #include "config.h"
 
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
 class DiscretiserTest : public ::testing::Test{
 	protected:
 	DiscretiserTest()
@@ -299,3 +305,143 @@ TEST_F(DiscretiserTest, ZIncludingNA){
 	ASSERT_EQ(0,dObs(4,10));
 	ASSERT_EQ(-1,dObs(5,10));
 }
+
+TEST_F(DiscretiserTest, Streaming){
+	for(auto file : {TEST_DATA_PATH("testObservations.txt"),
+	                 TEST_DATA_PATH("testObservationsIncludingNA.txt")}) {
+		Matrix<std::string> oriObs (file,false,true);
+		Matrix<int> dObs (oriObs.getColCount(), oriObs.getRowCount(),0);
+		Network n;
+		Discretiser d (oriObs,TEST_DATA_PATH("jsonDiscretiserTest.json"),dObs,n);
+
+		for(unsigned int threads : {1, 4}) {
+			Matrix<int> streamed;
+			Network m;
+			DiscretisationSettings settings(TEST_DATA_PATH("jsonDiscretiserTest.json"));
+			Discretiser s (file,settings,streamed,m,{},threads);
+			ASSERT_EQ(dObs.getRowNames(), streamed.getRowNames());
+			ASSERT_EQ(dObs.getColCount(), streamed.getColCount());
+			ASSERT_EQ(dObs.getRowCount(), streamed.getRowCount());
+			for(unsigned int row = 0; row < dObs.getRowCount(); row++) {
+				for(unsigned int col = 0; col < dObs.getColCount(); col++) {
+					ASSERT_EQ(dObs(col,row), streamed(col,row));
+				}
+			}
+			ASSERT_EQ(n.getObservationsMap(), m.getObservationsMap());
+			ASSERT_EQ(n.getObservationsMapR(), m.getObservationsMapR());
+		}
+	}
+}
+
+TEST_F(DiscretiserTest, StreamingKeepsTokensOfMappedFeatures){
+	// Both features have too many distinct values for a dictionary
+	const std::string file = "discretiserTestTokens.txt";
+	{
+		std::ofstream out(file);
+		for(auto name : {"Mapped", "Median"}) {
+			out << name;
+			for(unsigned int col = 0; col < 2000; col++) {
+				out << "\t" << 1000001 + col;
+			}
+			out << "\n";
+		}
+	}
+	boost::property_tree::ptree pt;
+	pt.put("Mapped.method", "None");
+	pt.put("Median.method", "Median");
+	Matrix<int> streamed;
+	Network n;
+	Discretiser d (file,DiscretisationSettings(pt),streamed,n,{},2);
+	std::remove(file.c_str());
+	ASSERT_EQ(0, n.getObservationsMap().at("1000001"));
+	ASSERT_EQ(1, n.getObservationsMap().at("1000002"));
+	ASSERT_EQ("1002000", n.getObservationsMapR().at(std::make_pair(1999, 0)));
+	for(unsigned int col = 0; col < 2000; col++) {
+		ASSERT_EQ((int)col, streamed(col,0));
+		ASSERT_EQ(col >= 1000 ? 1 : 0, streamed(col,1));
+	}
+}
+
+TEST_F(DiscretiserTest, StreamingDeletion){
+	Matrix<std::string> oriObs (TEST_DATA_PATH("testObservations.txt"),false,true);
+	Matrix<int> dObs;
+	Network n;
+	Discretiser d (oriObs,TEST_DATA_PATH("jsonDiscretiserTest.json"),dObs,n);
+
+	Matrix<int> streamed;
+	Network m;
+	DiscretisationSettings settings(TEST_DATA_PATH("jsonDiscretiserTest.json"));
+	Discretiser s (TEST_DATA_PATH("testObservations.txt"),settings,streamed,m,{1});
+	ASSERT_EQ(dObs.getColCount() - 1, streamed.getColCount());
+	ASSERT_EQ(dObs(0,0), streamed(0,0));
+	ASSERT_EQ(3,streamed(3,0));
+}
+
+TEST_F(DiscretiserTest, QuantilesOfLargeFeatures){
+	// Several distinct values with duplicates and missing values
+	const unsigned int samples = 1001;
+	Matrix<std::string> oriObs (samples, 3, "NA");
+	oriObs.setRowNames({"Median", "BracketMedians", "PersonTukey"});
+	std::vector<float> numbers;
+	unsigned int state = 17;
+	for(unsigned int col = 0; col < samples; col++) {
+		state = state * 1103515245u + 12345u;
+		if(col % 10 == 3) {
+			continue;
+		}
+		float value = ((state >> 16) % 500 + 1) / 4.0f;
+		numbers.push_back(value);
+		for(unsigned int row = 0; row < 3; row++) {
+			std::ostringstream os;
+			os << value;
+			oriObs(col, row) = os.str();
+		}
+	}
+	std::vector<float> sorted = numbers;
+	std::sort(sorted.begin(), sorted.end());
+	const size_t size = sorted.size();
+	const float median = size % 2 != 0 ? sorted[size / 2]
+	                                    : (sorted[size / 2 - 1] + sorted[size / 2]) / 2.0f;
+	const float bracket = sorted[size / 2];
+	const float lower = sorted[std::ceil(0.185 * size) - 1];
+	const float upper = sorted[std::ceil(0.815 * size) - 1];
+
+	Matrix<int> dObs;
+	Network n;
+	Discretiser d (oriObs,dObs,n);
+	d.setJsonTree(DiscretisationSettings(TEST_DATA_PATH("jsonDiscretiserTest.json")));
+	d.discretise();
+	size_t index = 0;
+	for(unsigned int col = 0; col < samples; col++) {
+		if(col % 10 == 3) {
+			for(unsigned int row = 0; row < 3; row++) {
+				ASSERT_EQ(-1, dObs(col,row));
+			}
+			continue;
+		}
+		float value = numbers[index++];
+		ASSERT_EQ(value > median ? 1 : 0, dObs(col,0));
+		ASSERT_EQ(value >= bracket ? 1 : 0, dObs(col,1));
+		ASSERT_EQ(value < lower ? 0 : (value < upper ? 1 : 2), dObs(col,2));
+	}
+}
+
+TEST_F(DiscretiserTest,ParallelEqualsSequential){
+	Matrix<std::string> oriObs (TEST_DATA_PATH("testObservationsIncludingNA.txt"),false,true);
+	Matrix<int> sequentialObs;
+	Network sequential;
+	Discretiser s (oriObs,sequentialObs,sequential);
+	s.discretise(TEST_DATA_PATH("jsonDiscretiserTest.json"),1);
+	Matrix<int> parallelObs;
+	Network parallel;
+	Discretiser p (oriObs,parallelObs,parallel);
+	p.discretise(TEST_DATA_PATH("jsonDiscretiserTest.json"),4);
+	ASSERT_EQ(sequentialObs.getRowNames(), parallelObs.getRowNames());
+	for(unsigned int row = 0; row < sequentialObs.getRowCount(); row++) {
+		for(unsigned int col = 0; col < sequentialObs.getColCount(); col++) {
+			ASSERT_EQ(sequentialObs(col,row), parallelObs(col,row));
+		}
+	}
+	ASSERT_EQ(sequential.getObservationsMap(), parallel.getObservationsMap());
+	ASSERT_EQ(sequential.getObservationsMapR(), parallel.getObservationsMapR());
+}
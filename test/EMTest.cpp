@@ -1,8 +1,16 @@
 #include "gtest/gtest.h"
 #include "../core/NetworkController.h"
 #include "../core/EM.h"
+#include "../core/DataDistribution.h"
+#include "../core/Discretiser.h"
+#include "../core/ExpectationStep.h"
 #include "config.h"
 
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
 class EMTest : public ::testing::Test{
 	protected:
 	EMTest()
@@ -11,6 +19,16 @@ class EMTest : public ::testing::Test{
 	}
 
 
+	void loadIncompleteData(Network& n, Matrix<int>& observations){
+		n.readNetwork(TEST_DATA_PATH("Student.na"));
+		n.readNetwork(TEST_DATA_PATH("Student.sif"));
+		Matrix<std::string> originalObservations (TEST_DATA_PATH("dataStudent60.txt"),false,true);
+		Discretiser disc(originalObservations,TEST_DATA_PATH("controlStudent.json"), observations, n);
+		DataDistribution db (n, observations);
+		db.assignObservationsToNodes();
+		db.distributeObservations();
+	}
+
 	public:
 	NetworkController c;
 	
@@ -94,3 +112,332 @@ TEST_F(EMTest,UnComplete){
 	ASSERT_NEAR(0.2f,sat.getProbability(0,1),0.2);
 	ASSERT_NEAR(0.8f,sat.getProbability(1,1),0.2);
 }
+
+TEST_F(EMTest,DeterministicAcrossThreads){
+	NetworkController c2;
+	for(auto* controller : {&c, &c2}) {
+		controller->loadNetwork(TEST_DATA_PATH("Student.na"));
+		controller->loadNetwork(TEST_DATA_PATH("Student.sif"));
+		controller->loadObservations(TEST_DATA_PATH("dataStudent60.txt"),TEST_DATA_PATH("controlStudent.json"));
+	}
+	EMSettings settings;
+	settings.threads = 1;
+	c.setEMSettings(settings);
+	c.trainNetwork();
+	settings.threads = 4;
+	c2.setEMSettings(settings);
+	c2.trainNetwork();
+
+	ASSERT_EQ(c.getNumberOfEMRuns(), c2.getNumberOfEMRuns());
+	ASSERT_EQ(c.getParameterDifference(), c2.getParameterDifference());
+	for(const auto& n : c.getNetwork().getNodes()) {
+		const Matrix<float>& m1 = n.getProbabilityMatrix();
+		const Matrix<float>& m2 = c2.getNetwork().getNode(n.getID()).getProbabilityMatrix();
+		for(unsigned int row = 0; row < m1.getRowCount(); row++) {
+			for(unsigned int col = 0; col < m1.getColCount(); col++) {
+				ASSERT_EQ(m1(col, row), m2(col, row));
+			}
+		}
+	}
+}
+
+TEST_F(EMTest,NonDeterministicMode){
+	c.loadNetwork(TEST_DATA_PATH("Student.na"));
+	c.loadNetwork(TEST_DATA_PATH("Student.sif"));
+	c.loadObservations(TEST_DATA_PATH("dataStudent60.txt"),TEST_DATA_PATH("controlStudent.json"));
+	EMSettings settings;
+	settings.threads = 3;
+	settings.deterministic = false;
+	c.setEMSettings(settings);
+	c.trainNetwork();
+	Network n = c.getNetwork();
+	Node intelligence = n.getNode("Intelligence");
+	ASSERT_NEAR(0.7, intelligence.getProbability(0,0),0.2);
+	ASSERT_NEAR(1.0, intelligence.getProbability(0,0) + intelligence.getProbability(1,0),0.0001);
+}
+
+TEST_F(EMTest,AbandonLosingRuns){
+	Network n;
+	Matrix<int> observations (0,0,-1);
+	loadIncompleteData(n, observations);
+
+	EMSettings settings;
+	settings.randomRestarts = 2;
+	settings.abandonFactor = std::numeric_limits<double>::infinity();
+	EM all(n, observations, 0.001f, 100000, settings);
+	ASSERT_EQ(0u, all.getNumberOfAbandonedRuns());
+
+	settings.abandonFactor = 1.0;
+	EM early(n, observations, 0.001f, 100000, settings);
+	ASSERT_LT(0u, early.getNumberOfAbandonedRuns());
+	ASSERT_EQ(all.getSelectedMethod(), early.getSelectedMethod());
+	ASSERT_EQ(all.getNumberOfRuns(), early.getNumberOfRuns());
+	ASSERT_DOUBLE_EQ(all.getLogLikelihood(), early.getLogLikelihood());
+}
+
+TEST_F(EMTest,Acceleration){
+	Network n;
+	Matrix<int> observations (0,0,-1);
+	loadIncompleteData(n, observations);
+
+	EMSettings settings;
+	settings.randomRestarts = 0;
+	EM plain(n, observations, 0.00001f, 100000, settings);
+	ASSERT_EQ(0u, plain.getNumberOfAcceptedExtrapolations());
+	ASSERT_EQ(0, plain.getIterationsSaved());
+
+	settings.accelerate = true;
+	settings.measureIterationsSaved = true;
+	EM accelerated(n, observations, 0.00001f, 100000, settings);
+	ASSERT_LT(accelerated.getNumberOfRuns(), plain.getNumberOfRuns());
+	ASSERT_LT(0u, accelerated.getNumberOfAcceptedExtrapolations());
+	// Measured against a plain run with the same initialisation
+	ASSERT_EQ(plain.getSelectedMethod(), accelerated.getSelectedMethod());
+	ASSERT_EQ(plain.getNumberOfRuns() - accelerated.getNumberOfRuns(),
+	          accelerated.getIterationsSaved());
+	ASSERT_NEAR(plain.getLogLikelihood(), accelerated.getLogLikelihood(), 1.0);
+
+	// Rejected extrapolations never decrease the log-likelihood of a run
+	const EMTrace& trace = accelerated.getTrace();
+	for(size_t i = 1; i < trace.size(); i++) {
+		if(trace[i].method == trace[i - 1].method) {
+			ASSERT_GE(trace[i].logLikelihood,
+			          trace[i - 1].logLikelihood - 1e-9 * std::fabs(trace[i - 1].logLikelihood));
+		}
+	}
+}
+
+TEST_F(EMTest,ExactPosteriors){
+	Network n;
+	Matrix<int> observations (0,0,-1);
+	loadIncompleteData(n, observations);
+	ExpectationStep expectation(n);
+	const auto& cardinalities = expectation.getCardinalities();
+
+	// Distinct parameters, every CPT row sums to 1
+	NetworkPolynomial polynomial(n);
+	NetworkPolynomial::Parameters parameters = polynomial.getParameters();
+	for(unsigned int id = 0; id < parameters.size(); id++) {
+		unsigned int cardinality = cardinalities[id];
+		for(size_t row = 0; row < parameters[id].size() / cardinality; row++) {
+			double rowsum = 0.0;
+			for(unsigned int col = 0; col < cardinality; col++) {
+				parameters[id][col + row * cardinality] = 1.0 + col * (row + 2);
+				rowsum += 1.0 + col * (row + 2);
+			}
+			for(unsigned int col = 0; col < cardinality; col++) {
+				parameters[id][col + row * cardinality] /= rowsum;
+			}
+		}
+	}
+	polynomial.setParameters(parameters);
+
+	// The CPT entry of a node given the values of all nodes
+	auto parameter = [&](const Node& node, const std::vector<int>& values) {
+		unsigned int row = 0;
+		for(unsigned int i = 0; i < node.getParents().size(); i++) {
+			row += node.getFactor(i) * values[node.getParents()[i]];
+		}
+		return parameters[node.getID()][values[node.getID()] + row * cardinalities[node.getID()]];
+	};
+	auto expectedCounts = [&](const std::string& name) {
+		Matrix<int> sample (1, observations.getRowCount(), 0, {"sample"}, observations.getRowNames());
+		const Node& node = n.getNode(name);
+		sample.setData(DiscreteObservations::NA, 0, node.getObservationRow());
+		SufficientStatistics statistics = expectation.createEmptyStatistics();
+		expectation.compute(polynomial, DiscreteObservations(sample), EMSettings(), 1, statistics);
+		return std::vector<double>(statistics.data(node.getID()), statistics.data(node.getID()) + cardinalities[node.getID()]);
+	};
+
+	// The previous E-step distributed the missing values of a node by its own
+	// CPT row. This equals the posterior if only a leaf is missing.
+	const Node& letter = n.getNode("Letter");
+	std::vector<double> letterCounts = expectedCounts("Letter");
+	std::vector<int> values(parameters.size(), 0);
+	for(unsigned int value = 0; value < cardinalities[letter.getID()]; value++) {
+		values[letter.getID()] = value;
+		ASSERT_NEAR(parameter(letter, values), letterCounts[value], 1e-12);
+	}
+
+	// Intelligence is also informed by its observed children Grade and SAT,
+	// which the previous E-step ignored
+	const Node& intelligence = n.getNode("Intelligence");
+	std::vector<double> intelligenceCounts = expectedCounts("Intelligence");
+	values.assign(parameters.size(), 0);
+	std::vector<double> joint;
+	double evidence = 0.0;
+	for(unsigned int value = 0; value < cardinalities[intelligence.getID()]; value++) {
+		values[intelligence.getID()] = value;
+		joint.push_back(parameter(intelligence, values) *
+		                parameter(n.getNode("Grade"), values) *
+		                parameter(n.getNode("SAT"), values));
+		evidence += joint.back();
+	}
+	for(unsigned int value = 0; value < cardinalities[intelligence.getID()]; value++) {
+		values[intelligence.getID()] = value;
+		ASSERT_NEAR(joint[value] / evidence, intelligenceCounts[value], 1e-12);
+		ASSERT_GT(std::fabs(parameter(intelligence, values) - intelligenceCounts[value]), 0.01);
+	}
+}
+
+TEST_F(EMTest,LikelihoodTolerance){
+	Network n;
+	Matrix<int> observations (0,0,-1);
+	loadIncompleteData(n, observations);
+
+	EMSettings settings;
+	settings.randomRestarts = 0;
+	EM plain(n, observations, 0.00001f, 100000, settings);
+	settings.likelihoodTolerance = 0.0001;
+	EM tolerance(n, observations, 0.00001f, 100000, settings);
+	ASSERT_LT(tolerance.getNumberOfRuns(), plain.getNumberOfRuns());
+	ASSERT_NEAR(plain.getLogLikelihood(), tolerance.getLogLikelihood(), 0.001 * std::fabs(plain.getLogLikelihood()));
+}
+
+TEST_F(EMTest,MiniBatch){
+	Network n;
+	Matrix<int> observations (0,0,-1);
+	n.readNetwork(TEST_DATA_PATH("Student.na"));
+	n.readNetwork(TEST_DATA_PATH("Student.sif"));
+	Matrix<std::string> originalObservations (TEST_DATA_PATH("StudentData.txt"),false,true);
+	Discretiser disc(originalObservations,TEST_DATA_PATH("controlStudent.json"), observations, n);
+	DataDistribution db (n, observations);
+	db.assignObservationsToNodes();
+	db.distributeObservations();
+
+	EMSettings settings;
+	settings.batchSize = 1000;
+	settings.epochs = 0.5;
+	EM em(n, observations, 0.001f, 100000, settings);
+	unsigned int batches = std::ceil(0.5 * observations.getColCount() / 1000);
+	ASSERT_EQ(batches, em.getNumberOfRuns());
+	ASSERT_EQ(1, em.getSelectedMethod());
+	Node intelligence = n.getNode("Intelligence");
+	ASSERT_NEAR(0.7, intelligence.getProbability(0,0),0.02);
+	Node grade = n.getNode("Grade");
+	ASSERT_NEAR(0.9f,grade.getProbability(0,1),0.02);
+	ASSERT_GT(0.0, em.getLogLikelihood());
+}
+
+TEST_F(EMTest,WarmStart){
+	Network n;
+	Matrix<int> observations (0,0,-1);
+	loadIncompleteData(n, observations);
+
+	EMSettings settings;
+	settings.randomRestarts = 0;
+	EM cold(n, observations, 0.00001f, 100000, settings);
+	NetworkPolynomial::Parameters parameters = NetworkPolynomial::extractParameters(n);
+	EM warm(n, observations, parameters, 0.00001f, 100000, settings);
+	ASSERT_EQ(EM::WARM_START, warm.getSelectedMethod());
+	ASSERT_LT(warm.getNumberOfRuns(), cold.getNumberOfRuns());
+	ASSERT_NEAR(cold.getLogLikelihood(), warm.getLogLikelihood(), 1.0);
+
+	parameters.pop_back();
+	ASSERT_THROW(EM(n, observations, parameters, 0.00001f, 100000, settings), std::invalid_argument);
+}
+
+TEST_F(EMTest,RetrainNetwork){
+	c.loadNetwork(TEST_DATA_PATH("Student.na"));
+	c.loadNetwork(TEST_DATA_PATH("Student.sif"));
+	c.loadObservations(TEST_DATA_PATH("dataStudent60.txt"),TEST_DATA_PATH("controlStudent.json"));
+	c.trainNetwork();
+	int coldRuns = c.getNumberOfEMRuns();
+	NetworkPolynomial::Parameters parameters = c.getParameters();
+	c.retrainNetwork();
+	ASSERT_LT(c.getNumberOfEMRuns(), coldRuns);
+	NetworkPolynomial::Parameters retrained = c.getParameters();
+	ASSERT_EQ(parameters.size(), retrained.size());
+	for(size_t id = 0; id < parameters.size(); id++){
+		for(size_t i = 0; i < parameters[id].size(); i++){
+			ASSERT_NEAR(parameters[id][i], retrained[id][i], 0.01);
+		}
+	}
+}
+
+TEST_F(EMTest,RetrainRenamedValues){
+	c.loadNetwork(TEST_DATA_PATH("Student.na"));
+	c.loadNetwork(TEST_DATA_PATH("Student.sif"));
+	c.loadObservations(TEST_DATA_PATH("dataStudent60.txt"),TEST_DATA_PATH("controlStudent.json"));
+	c.trainNetwork();
+	c.retrainNetwork();
+	ASSERT_EQ(EM::WARM_START, c.getEMTrace().front().method);
+
+	// Same number of values, but i1 is called i2 now
+	std::ifstream original(TEST_DATA_PATH("dataStudent60.txt"));
+	std::stringstream content;
+	content << original.rdbuf();
+	std::string data = content.str();
+	for(size_t pos = data.find("\ti1"); pos != std::string::npos; pos = data.find("\ti1", pos)) {
+		data.replace(pos, 3, "\ti2");
+	}
+	const std::string renamed = "EMTestRenamed.txt";
+	std::ofstream(renamed) << data;
+	c.loadObservations(renamed,TEST_DATA_PATH("controlStudent.json"));
+	c.retrainNetwork();
+	std::remove(renamed.c_str());
+	ASSERT_NE(EM::WARM_START, c.getEMTrace().front().method);
+}
+
+TEST_F(EMTest,Checkpoint){
+	Network n;
+	Matrix<int> observations (0,0,-1);
+	loadIncompleteData(n, observations);
+
+	EMSettings settings;
+	EM uninterrupted(n, observations, 0.0001f, 100000, settings);
+	NetworkPolynomial::Parameters expected = NetworkPolynomial::extractParameters(n);
+
+	settings.checkpointFile = "EMTest.checkpoint";
+	settings.checkpointInterval = 1;
+	std::remove(settings.checkpointFile.c_str());
+	EM interrupted(n, observations, 0.0001f, 4, settings);
+	ASSERT_EQ(0u, interrupted.getResumedIterations());
+	ASSERT_TRUE(std::ifstream(settings.checkpointFile).good());
+
+	EM resumed(n, observations, 0.0001f, 100000, settings);
+	ASSERT_EQ(4u, resumed.getResumedIterations());
+	ASSERT_EQ(uninterrupted.getNumberOfRuns(), resumed.getNumberOfRuns());
+	ASSERT_EQ(uninterrupted.getLogLikelihood(), resumed.getLogLikelihood());
+	ASSERT_EQ(expected, NetworkPolynomial::extractParameters(n));
+	ASSERT_FALSE(std::ifstream(settings.checkpointFile).good());
+}
+
+TEST_F(EMTest,InvalidCheckpoint){
+	Network n;
+	Matrix<int> observations (0,0,-1);
+	loadIncompleteData(n, observations);
+
+	EMSettings settings;
+	settings.checkpointFile = "EMTest.invalid.checkpoint";
+	std::ofstream file(settings.checkpointFile);
+	file << "CTEMCKPT truncated";
+	file.close();
+	EM em(n, observations, 0.0001f, 100000, settings);
+	ASSERT_EQ(0u, em.getResumedIterations());
+	ASSERT_FALSE(std::ifstream(settings.checkpointFile).good());
+}
+
+TEST_F(EMTest,Trace){
+	Network n;
+	Matrix<int> observations (0,0,-1);
+	loadIncompleteData(n, observations);
+
+	EM em(n, observations);
+	const EMTrace& trace = em.getTrace();
+	ASSERT_FALSE(trace.empty());
+	unsigned int last = 0;
+	for(size_t i = 0; i < trace.size(); i++){
+		ASSERT_FALSE(trace[i].accelerated);
+		ASSERT_LE(0.0, trace[i].eTimeInMicroSeconds);
+		ASSERT_LE(0.0, trace[i].mTimeInMicroSeconds);
+		if(i > 0 && trace[i].method == trace[i-1].method){
+			ASSERT_EQ(trace[i-1].iteration + 1, trace[i].iteration);
+			ASSERT_LE(trace[i-1].logLikelihood, trace[i].logLikelihood);
+		}
+		if(trace[i].method == em.getSelectedMethod()){
+			last = trace[i].iteration;
+		}
+	}
+	ASSERT_EQ(em.getNumberOfRuns(), (int)last);
+}
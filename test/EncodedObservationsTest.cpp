@@ -0,0 +1,157 @@
+#include "gtest/gtest.h"
+
+#include "../core/EncodedObservations.h"
+
+#include "config.h"
+
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+
+// Inspects the features while they are streamed, they are released afterwards
+class NumericHandler : public EncodedObservations::FeatureHandler
+{
+	public:
+	void initialise(const EncodedObservations& observations) override
+	{
+		numeric.assign(observations.getRowCount(), false);
+	}
+
+	bool needsTokens(const EncodedObservations&, unsigned int) override
+	{
+		return false;
+	}
+
+	void process(const EncodedObservations& observations, unsigned int row) override
+	{
+		numeric[row] = observations.isNumeric(row);
+		if(row == 0) {
+			dictionaryEmpty = observations.getDictionary(0).empty();
+			number = observations.getNumber(0, 0).get();
+			missing = !observations.getNumber(6, 0);
+			countNA = observations.countNA(0);
+			missingValue = observations.getValue(6, 0);
+			value = observations.getValue(1, 0);
+			uniqueValues = observations.getUniqueRowValues(0).size();
+		} else {
+			discreteDictionarySize = observations.getDictionary(1).size();
+			discreteNumber = observations.getNumber(1, 1).get();
+		}
+	}
+
+	std::vector<bool> numeric;
+	bool dictionaryEmpty = false;
+	float number = 0.0f;
+	bool missing = false;
+	size_t countNA = 0;
+	std::string missingValue;
+	std::string value;
+	size_t uniqueValues = 0;
+	size_t discreteDictionarySize = 0;
+	float discreteNumber = 0.0f;
+};
+
+class EncodedObservationsTest : public ::testing::Test{
+	protected:
+	EncodedObservationsTest()
+	{
+
+	}
+};
+
+TEST_F(EncodedObservationsTest, MatchesMatrix){
+	Matrix<std::string> matrix (TEST_DATA_PATH("dataStudent60.txt"),false,true);
+	EncodedObservations fromFile (TEST_DATA_PATH("dataStudent60.txt"));
+	EncodedObservations fromMatrix (matrix);
+	ASSERT_EQ(matrix.getRowCount(), fromFile.getRowCount());
+	ASSERT_EQ(matrix.getColCount(), fromFile.getColCount());
+	ASSERT_EQ(matrix.getRowNames(), fromFile.getRowNames());
+	for(unsigned int row = 0; row < matrix.getRowCount(); row++){
+		ASSERT_FALSE(fromFile.isNumeric(row));
+		ASSERT_EQ(matrix.getUniqueRowValues(row), fromFile.getUniqueRowValues(row));
+		ASSERT_EQ(matrix.countElement(1, row, "NA"), fromFile.countNA(row));
+		ASSERT_EQ(fromMatrix.getCodes(row), fromFile.getCodes(row));
+		for(unsigned int col = 0; col < matrix.getColCount(); col++){
+			ASSERT_EQ(matrix(col, row), fromFile.getValue(col, row));
+		}
+	}
+}
+
+TEST_F(EncodedObservationsTest, Dictionary){
+	Matrix<std::string> matrix (4,2,"",{},{"Letter","Score"});
+	std::vector<std::string> letters {"l1","na","l0","l1"};
+	std::vector<std::string> scores {"1.5","-","/","2"};
+	for(unsigned int col = 0; col < 4; col++){
+		matrix.setData(letters[col], col, 0);
+		matrix.setData(scores[col], col, 1);
+	}
+	EncodedObservations observations (matrix);
+	std::vector<std::string> dictionary {"l1","l0"};
+	ASSERT_EQ(dictionary, observations.getDictionary(0));
+	std::vector<uint32_t> codes {0, EncodedObservations::NA_CODE, 1, 0};
+	ASSERT_EQ(codes, observations.getCodes(0));
+	ASSERT_EQ("NA", observations.getValue(1, 0));
+	std::vector<std::string> unique {"NA","l0","l1"};
+	ASSERT_EQ(unique, observations.getUniqueRowValues(0));
+	// The leading number of a token is used, 0 if there is none
+	ASSERT_EQ(0.0f, observations.getNumber(0, 0).get());
+	ASSERT_FALSE(observations.getNumber(1, 0));
+	ASSERT_FLOAT_EQ(1.5f, observations.getNumber(0, 1).get());
+	ASSERT_EQ(2u, observations.countNA(1));
+	ASSERT_TRUE(observations.isNA(2, 1));
+
+	Matrix<std::string> units (2,1,"",{},{"Weight"});
+	units.setData("2.5kg", 0, 0);
+	units.setData("-3e1", 1, 0);
+	EncodedObservations prefixes (units);
+	ASSERT_FLOAT_EQ(2.5f, prefixes.getNumber(0, 0).get());
+	ASSERT_FLOAT_EQ(-30.0f, prefixes.getNumber(1, 0).get());
+}
+
+TEST_F(EncodedObservationsTest, NumericColumn){
+	const std::string file = "encodedObservationsTest.txt";
+	{
+		std::ofstream out(file);
+		out << "Continuous";
+		for(unsigned int col = 0; col < 2000; col++){
+			out << "\t" << (col == 7 ? std::string("NA") : std::to_string(col * 0.25));
+		}
+		out << "\nDiscrete";
+		for(unsigned int col = 0; col < 2000; col++){
+			out << "\t" << col % 3;
+		}
+		out << "\n";
+	}
+	// Without a handler every feature keeps its tokens
+	EncodedObservations observations (file, {0}, 2);
+	ASSERT_EQ(1999u, observations.getColCount());
+	ASSERT_FALSE(observations.isNumeric(0));
+	ASSERT_EQ(1998u, observations.getDictionary(0).size());
+	ASSERT_EQ("0.500000", observations.getValue(1, 0));
+
+	// A handler that does not need the tokens gets a float column
+	NumericHandler handler;
+	EncodedObservations streamed (file, handler, {0}, 2);
+	std::remove(file.c_str());
+	ASSERT_EQ(1999u, streamed.getColCount());
+	ASSERT_TRUE(handler.numeric[0]);
+	ASSERT_TRUE(handler.dictionaryEmpty);
+	ASSERT_FALSE(handler.numeric[1]);
+	ASSERT_EQ(3u, handler.discreteDictionarySize);
+	ASSERT_FLOAT_EQ(0.25f, handler.number);
+	ASSERT_TRUE(handler.missing);
+	ASSERT_EQ(1u, handler.countNA);
+	ASSERT_EQ("NA", handler.missingValue);
+	ASSERT_EQ("0.5", handler.value);
+	ASSERT_EQ(1999u, handler.uniqueValues);
+	ASSERT_EQ(2.0f, handler.discreteNumber);
+}
+
+TEST_F(EncodedObservationsTest, InvalidFile){
+	const std::string file = "encodedObservationsInvalid.txt";
+	std::ofstream(file) << "A 1 2\nB 3\n";
+	ASSERT_THROW(EncodedObservations observations (file), std::invalid_argument);
+	std::remove(file.c_str());
+	ASSERT_THROW(EncodedObservations observations (TEST_DATA_PATH("StudentData.txt"), {100000}), std::invalid_argument);
+	ASSERT_THROW(EncodedObservations observations ("doesNotExist.txt"), std::invalid_argument);
+}
@@ -1,4 +1,7 @@
 #include "gtest/gtest.h"
+#include <clocale>
+#include <cstdio>
+#include <fstream>
 #include "../core/Matrix.h"
 #include "config.h"
 
@@ -216,3 +219,129 @@ TEST_F(MatrixTest,readMatrix){
 	ASSERT_EQ(12,m_(7,0));
 	ASSERT_EQ(3,m_(2,3));
 }
+
+TEST_F(MatrixTest,readMatrixHeader){
+	const std::string file = "matrixTestHeader.txt";
+	std::ofstream(file) << "id\tx\ty\r\nA\t-1\t2\r\n\r\nB 3  -4\r\n";
+	m_.readMatrix(file,true,true);
+	std::remove(file.c_str());
+	ASSERT_EQ(2u,m_.getRowCount());
+	ASSERT_EQ(2u,m_.getColCount());
+	ASSERT_EQ(std::vector<std::string>({"x","y"}),m_.getColNames());
+	ASSERT_EQ(std::vector<std::string>({"A","B"}),m_.getRowNames());
+	ASSERT_EQ(-1,m_(0,0));
+	ASSERT_EQ(-4,m_(1,1));
+	ASSERT_EQ(1,m_.findCol("y"));
+}
+
+TEST_F(MatrixTest,readMatrixDeletion){
+	m_.readMatrixDeletion(TEST_DATA_PATH("testObservations2.txt"),false,true,{0,7});
+	ASSERT_EQ(5u,m_.getRowCount());
+	ASSERT_EQ(6u,m_.getColCount());
+	ASSERT_EQ(6,m_(0,0));
+	ASSERT_EQ(11,m_(5,0));
+	ASSERT_EQ(7,m_(5,4));
+	ASSERT_THROW(m_.readMatrixDeletion(TEST_DATA_PATH("testObservations2.txt"),false,true,{8}),std::invalid_argument);
+}
+
+TEST_F(MatrixTest,readMatrixFloat){
+	const std::string file = "matrixTestFloat.txt";
+	std::ofstream(file) << "A 0.5 -1e-3 7";
+	Matrix<float> m(file,false,true);
+	std::remove(file.c_str());
+	ASSERT_EQ(3u,m.getColCount());
+	ASSERT_FLOAT_EQ(0.5f,m(0,0));
+	ASSERT_FLOAT_EQ(-0.001f,m(1,0));
+	ASSERT_FLOAT_EQ(7.0f,m(2,0));
+}
+
+TEST_F(MatrixTest,parseNumber){
+	// The C locale of the application must not change the decimal point
+	const std::string previous = std::setlocale(LC_NUMERIC, nullptr);
+	std::setlocale(LC_NUMERIC, "de_DE.UTF-8");
+	double value = 0.0;
+	const std::string half = "0.5";
+	ASSERT_TRUE(parseNumber(half.data(), half.data() + half.size(), value));
+	ASSERT_DOUBLE_EQ(0.5, value);
+	std::setlocale(LC_NUMERIC, previous.c_str());
+
+	const std::string longToken = "0." + std::string(100, '0') + "1";
+	ASSERT_TRUE(parseNumber(longToken.data(), longToken.data() + longToken.size(), value));
+	ASSERT_DOUBLE_EQ(1e-101, value);
+	const std::string infinity = "-Inf";
+	ASSERT_TRUE(parseNumber(infinity.data(), infinity.data() + infinity.size(), value));
+	ASSERT_EQ(-std::numeric_limits<double>::infinity(), value);
+	// Exact conversions and those passed on to strtod
+	const std::vector<std::pair<std::string, double>> numbers = {
+	    {"-12.5e-1", -1.25}, {".5", 0.5}, {"+7.", 7.0}, {"1E3", 1000.0},
+	    {"0.1", 0.1}, {"123456789012345678901234", 123456789012345678901234.0},
+	    {"2.2250738585072014e-308", 2.2250738585072014e-308}, {"1e-400", 0.0}};
+	for(const auto& number : numbers){
+		ASSERT_TRUE(parseNumber(number.first.data(), number.first.data() + number.first.size(), value)) << number.first;
+		ASSERT_EQ(number.second, value) << number.first;
+	}
+	const std::string prefix = "2.5e+3x";
+	ASSERT_EQ(prefix.data() + 6, parseLeadingNumber(prefix.data(), prefix.data() + prefix.size(), value));
+	ASSERT_EQ(2500.0, value);
+	for(const std::string token : {"", "1,5", " 1", "1 ", "x", "1e", "1e999", ".", "-", "0x10"}){
+		ASSERT_FALSE(parseNumber(token.data(), token.data() + token.size(), value)) << token;
+	}
+}
+
+TEST_F(MatrixTest,readMatrixInvalid){
+	const std::string file = "matrixTestInvalid.txt";
+	std::ofstream(file) << "A 1 2\nB 3 x\n";
+	ASSERT_THROW(m_.readMatrix(file,false,true),std::invalid_argument);
+	std::ofstream(file) << "A 1 2\nB 3\n";
+	ASSERT_THROW(m_.readMatrix(file,false,true),std::invalid_argument);
+	std::ofstream(file) << "A 1 99999999999\n";
+	ASSERT_THROW(m_.readMatrix(file,false,true),std::invalid_argument);
+	std::ofstream(file) << "";
+	m_.readMatrix(file,false,true);
+	ASSERT_EQ(0u,m_.getRowCount());
+	std::remove(file.c_str());
+	ASSERT_THROW(m_.readMatrix("doesNotExist.txt",false,true),std::invalid_argument);
+}
+
+TEST_F(MatrixTest,readMatrixParallel){
+	// Large enough to be split into several chunks
+	const std::string file = "matrixTestParallel.txt";
+	{
+		std::ofstream out(file);
+		for(unsigned int row = 0; row < 400; row++){
+			out << "F" << row;
+			for(unsigned int col = 0; col < 1000; col++){
+				out << "\t" << (row * 7919 + col * 104729) % 100000;
+			}
+			out << (row == 200 ? "\n\n" : "\n");
+		}
+	}
+	Matrix<int> parallel(0,0,0);
+	parallel.readMatrixDeletion(file,false,true,{3},4);
+	Matrix<int> sequential(0,0,0);
+	sequential.readMatrixDeletion(file,false,true,{3},1);
+	ASSERT_EQ(400u,parallel.getRowCount());
+	ASSERT_EQ(999u,parallel.getColCount());
+	ASSERT_EQ(sequential.getRowNames(),parallel.getRowNames());
+	ASSERT_EQ(399,parallel.findRow("F399"));
+	for(unsigned int row = 0; row < 400; row++){
+		for(unsigned int col = 0; col < 999; col++){
+			unsigned int original = col < 3 ? col : col + 1;
+			ASSERT_EQ(int((row * 7919 + original * 104729) % 100000),parallel(col,row));
+			ASSERT_EQ(sequential(col,row),parallel(col,row));
+		}
+	}
+
+	{
+		std::ofstream out(file, std::ofstream::app);
+		out << "F400\t1\t2\n";
+	}
+	try{
+		parallel.readMatrix(file,false,true,4);
+		FAIL();
+	}
+	catch(const std::invalid_argument& e){
+		ASSERT_EQ(std::string("Row 402 does not contain the specified number of samples"),e.what());
+	}
+	std::remove(file.c_str());
+}
@@ -1,5 +1,12 @@
 #include "gtest/gtest.h"
 #include "../core/NetworkController.h"
+#include "../core/DiscretisationCache.h"
+#include "../core/Parser.h"
+
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
 #include "config.h"
 
 class NetworkControllerTest : public ::testing::Test{
@@ -226,3 +233,206 @@ TEST_F(NetworkControllerTest, EdgeAdditionPossibility){
 }
 
 
+
+TEST_F(NetworkControllerTest, Snapshot){
+	NetworkController n;
+	n.loadNetwork(TEST_DATA_PATH("Student.na"));
+	n.loadNetwork(TEST_DATA_PATH("Student.sif"));
+	n.loadObservations(TEST_DATA_PATH("StudentData.txt"),TEST_DATA_PATH("controlStudent.json"));
+	n.trainNetwork();
+	n.saveSnapshot("Student.snapshot");
+
+	NetworkController m;
+	m.loadSnapshot("Student.snapshot");
+	std::remove("Student.snapshot");
+	const Network& original = n.getNetwork();
+	const Network& loaded = m.getNetwork();
+	ASSERT_EQ(original.size(), loaded.size());
+	for(unsigned int id = 0; id < original.size(); id++){
+		const Node& a = original.getNode(id);
+		const Node& b = loaded.getNode(id);
+		ASSERT_EQ(a.getName(), b.getName());
+		ASSERT_EQ(a.getParents(), b.getParents());
+		ASSERT_EQ(a.getValueNamesProb(), b.getValueNamesProb());
+		ASSERT_EQ(a.getParentValueNames(), b.getParentValueNames());
+		for(unsigned int row = 0; row < a.getProbabilityMatrix().getRowCount(); row++){
+			for(unsigned int col = 0; col < a.getProbabilityMatrix().getColCount(); col++){
+				ASSERT_EQ(a.getProbability(col,row), b.getProbability(col,row));
+			}
+		}
+	}
+
+	Parser p1("? Grade = g1 | Intelligence = i0", n);
+	Parser p2("? Grade = g1 | Intelligence = i0", m);
+	ASSERT_FLOAT_EQ(p1.parseQuery().execute().first, p2.parseQuery().execute().first);
+}
+
+TEST_F(NetworkControllerTest, InvalidSnapshot){
+	NetworkController n;
+	ASSERT_THROW(n.loadSnapshot("missing.snapshot"), std::invalid_argument);
+	std::ofstream file("invalid.snapshot");
+	file << "not a snapshot";
+	file.close();
+	ASSERT_THROW(n.loadSnapshot("invalid.snapshot"), std::invalid_argument);
+	std::remove("invalid.snapshot");
+}
+
+TEST_F(NetworkControllerTest, EMTelemetry){
+	NetworkController n;
+	n.loadNetwork(TEST_DATA_PATH("Student.na"));
+	n.loadNetwork(TEST_DATA_PATH("Student.sif"));
+	n.loadObservations(TEST_DATA_PATH("StudentData.txt"),TEST_DATA_PATH("controlStudent.json"));
+	n.trainNetwork();
+	ASSERT_EQ(1u, n.getEMTrace().size());
+	std::ostringstream os;
+	n.writeEMTelemetry(os);
+	std::string json = os.str();
+	ASSERT_NE(std::string::npos, json.find("\"runs\": 1,"));
+	ASSERT_NE(std::string::npos, json.find("{\"method\": 0, \"iteration\": 1, \"accelerated\": false"));
+	ASSERT_EQ('}', json[json.size() - 2]);
+	ASSERT_EQ(std::string::npos, json.find("iterationsSaved"));
+
+	// Complete data is not iterated, so nothing is saved
+	EMSettings settings;
+	settings.accelerate = true;
+	settings.measureIterationsSaved = true;
+	n.setEMSettings(settings);
+	n.trainNetwork();
+	ASSERT_EQ(0, n.getEMIterationsSaved());
+	os.str("");
+	n.writeEMTelemetry(os);
+	ASSERT_NE(std::string::npos, os.str().find("\"iterationsSaved\": 0,"));
+}
+
+TEST_F(NetworkControllerTest, SampleSelection){
+	std::vector<unsigned int> deselected;
+	for(unsigned int sample = 0; sample < 100000; sample += 3) {
+		deselected.push_back(sample);
+	}
+	NetworkController deleted;
+	deleted.loadNetwork(TEST_DATA_PATH("Student.na"));
+	deleted.loadNetwork(TEST_DATA_PATH("Student.sif"));
+	deleted.loadObservations(TEST_DATA_PATH("StudentData.txt"),TEST_DATA_PATH("controlStudent.json"),deselected);
+	deleted.trainNetwork();
+	NetworkController selected;
+	selected.loadNetwork(TEST_DATA_PATH("Student.na"));
+	selected.loadNetwork(TEST_DATA_PATH("Student.sif"));
+	selected.loadObservations(TEST_DATA_PATH("StudentData.txt"),TEST_DATA_PATH("controlStudent.json"));
+	selected.trainNetwork();
+	NetworkPolynomial::Parameters all = selected.getParameters();
+	std::vector<Matrix<int>> allCounts;
+	for(const auto& n : selected.getNetwork().getNodes()) {
+		allCounts.push_back(n.getObservationMatrix());
+	}
+
+	// The counts are updated in place of reading and counting the data again
+	selected.setDeselectedSamples(deselected);
+	ASSERT_EQ(deselected, selected.getDeselectedSamples());
+	selected.retrainNetwork();
+	for(const auto& n : deleted.getNetwork().getNodes()) {
+		const Matrix<int>& expected = n.getObservationMatrix();
+		const Matrix<int>& counts =
+		    selected.getNetwork().getNode(n.getName()).getObservationMatrix();
+		ASSERT_EQ(expected.getColNames(), counts.getColNames());
+		ASSERT_EQ(expected.getRowNames(), counts.getRowNames());
+		for(unsigned int row = 0; row < expected.getRowCount(); row++) {
+			for(unsigned int col = 0; col < expected.getColCount(); col++) {
+				ASSERT_EQ(expected(col, row), counts(col, row));
+			}
+		}
+	}
+	NetworkPolynomial::Parameters expected = deleted.getParameters();
+	NetworkPolynomial::Parameters parameters = selected.getParameters();
+	ASSERT_EQ(expected.size(), parameters.size());
+	for(size_t id = 0; id < expected.size(); id++) {
+		ASSERT_EQ(expected[id].size(), parameters[id].size());
+		for(size_t i = 0; i < expected[id].size(); i++) {
+			ASSERT_NEAR(expected[id][i], parameters[id][i], 0.001);
+		}
+	}
+	ASSERT_NEAR(deleted.getLikelihoodOfTheData(), selected.getLikelihoodOfTheData(), 1.0);
+
+	// Reselecting all samples restores the counts of the complete data
+	selected.setDeselectedSamples({});
+	selected.retrainNetwork();
+	for(size_t id = 0; id < allCounts.size(); id++) {
+		const Matrix<int>& counts = selected.getNetwork().getNode(id).getObservationMatrix();
+		for(unsigned int row = 0; row < counts.getRowCount(); row++) {
+			for(unsigned int col = 0; col < counts.getColCount(); col++) {
+				ASSERT_EQ(allCounts[id](col, row), counts(col, row));
+			}
+		}
+	}
+	parameters = selected.getParameters();
+	for(size_t id = 0; id < all.size(); id++) {
+		for(size_t i = 0; i < all[id].size(); i++) {
+			ASSERT_NEAR(all[id][i], parameters[id][i], 0.001);
+		}
+	}
+}
+
+TEST_F(NetworkControllerTest, SampleSelectionKeepsDiscretisation){
+	std::ofstream("selection.tgf") << "1\tX\n2\tY\n#\n1 2\n";
+	std::ofstream("selection.txt") << "X\t1\t2\t3\t4\t5\t6\t7\t8\t9\t10\n"
+	                                 << "Y\ta\tb\ta\tb\ta\tb\ta\tb\ta\tb\n";
+	DiscretisationSettings settings;
+	settings.addToTree("X", "median");
+	settings.addToTree("Y", "none");
+	const std::vector<unsigned int> deselected {7, 8, 9};
+
+	// Deselected samples are only excluded from training, the median is still
+	// computed from all loaded samples: 5 of the 7 selected values are below
+	NetworkController masked;
+	masked.loadNetwork("selection.tgf");
+	masked.loadObservations("selection.txt", settings);
+	masked.setDeselectedSamples(deselected);
+	masked.trainNetwork();
+	ASSERT_NEAR(5.0 / 7.0, masked.getNetwork().getNode("X").getProbability(0, 0), 1e-6);
+
+	// Samples deleted while loading do not take part in the discretisation
+	NetworkController deleted;
+	deleted.loadNetwork("selection.tgf");
+	deleted.loadObservations("selection.txt", settings, deselected);
+	deleted.trainNetwork();
+	ASSERT_GT(std::fabs(5.0 / 7.0 - deleted.getNetwork().getNode("X").getProbability(0, 0)), 0.1);
+	std::remove("selection.tgf");
+	std::remove("selection.txt");
+}
+
+TEST_F(NetworkControllerTest, InvalidSampleSelection){
+	NetworkController n;
+	n.loadNetwork(TEST_DATA_PATH("Student.na"));
+	n.loadNetwork(TEST_DATA_PATH("Student.sif"));
+	n.loadObservations(TEST_DATA_PATH("StudentData.txt"),TEST_DATA_PATH("controlStudent.json"));
+	ASSERT_THROW(n.setDeselectedSamples({100000}), std::invalid_argument);
+	ASSERT_TRUE(n.getDeselectedSamples().empty());
+}
+
+TEST_F(NetworkControllerTest, DiscretisationCache){
+	NetworkPolynomial::Parameters expected;
+	std::vector<std::string> grades;
+	{
+		NetworkController n;
+		n.loadNetwork(TEST_DATA_PATH("Student.na"));
+		n.loadNetwork(TEST_DATA_PATH("Student.sif"));
+		n.setDiscretisationCache(".");
+		n.loadObservations(TEST_DATA_PATH("StudentData.txt"),TEST_DATA_PATH("controlStudent.json"));
+		n.trainNetwork();
+		expected = n.getParameters();
+		grades = n.getNetwork().getNode("Grade").getValueNames();
+	}
+	DiscretisationCache cache(".");
+	const std::string cacheFile =
+	    cache.getCacheFile(TEST_DATA_PATH("StudentData.txt"),
+	                       DiscretisationSettings(TEST_DATA_PATH("controlStudent.json")), {});
+	ASSERT_TRUE(std::ifstream(cacheFile).good());
+	NetworkController n;
+	n.loadNetwork(TEST_DATA_PATH("Student.na"));
+	n.loadNetwork(TEST_DATA_PATH("Student.sif"));
+	n.setDiscretisationCache(".");
+	n.loadObservations(TEST_DATA_PATH("StudentData.txt"),TEST_DATA_PATH("controlStudent.json"));
+	n.trainNetwork();
+	ASSERT_EQ(expected, n.getParameters());
+	ASSERT_EQ(grades, n.getNetwork().getNode("Grade").getValueNames());
+	std::remove(cacheFile.c_str());
+}
@@ -0,0 +1,77 @@
+#include "gtest/gtest.h"
+#include "../core/NetworkController.h"
+#include "../core/NetworkPolynomial.h"
+#include "config.h"
+
+class NetworkPolynomialTest : public ::testing::Test{
+	protected:
+	NetworkPolynomialTest()
+		:c(NetworkController())
+	{
+	}
+
+	void virtual SetUp(){
+		c.loadNetwork(TEST_DATA_PATH("Student.na"));
+		c.loadNetwork(TEST_DATA_PATH("Student.sif"));
+		c.loadObservations(TEST_DATA_PATH("StudentData.txt"),TEST_DATA_PATH("controlStudent.json"));
+		c.trainNetwork();
+	}
+
+	public:
+	NetworkController c;
+};
+
+TEST_F(NetworkPolynomialTest, NoEvidence){
+	NetworkPolynomial p(c.getNetwork());
+	std::vector<int> evidence(5,-1);
+	ASSERT_NEAR(1.0, p.evaluate(evidence), 0.0001);
+}
+
+TEST_F(NetworkPolynomialTest, Evaluate){
+	NetworkPolynomial p(c.getNetwork());
+	std::vector<int> evidence(5,-1);
+	evidence[1]=0;
+	ASSERT_NEAR(0.362, p.evaluate(evidence), 0.001);
+	evidence[0]=0;
+	ASSERT_NEAR(0.288, p.evaluate(evidence), 0.001);
+	std::vector<int> complete(5,0);
+	ASSERT_NEAR(0.01197, p.evaluate(complete), 0.0001);
+}
+
+TEST_F(NetworkPolynomialTest, DerivativesMatchFiniteDifferences){
+	const Network& n = c.getNetwork();
+	NetworkPolynomial p(n);
+	std::vector<int> evidence(5,-1);
+	evidence[4]=0;
+	evidence[2]=1;
+	NetworkPolynomial::Parameters derivatives;
+	double probability = p.differentiate(evidence, derivatives);
+	ASSERT_NEAR(p.evaluate(evidence), probability, 1e-12);
+
+	// The polynomial is linear in every single parameter
+	const double h = 0.01;
+	for(unsigned int id = 0; id < n.size(); id++){
+		for(unsigned int i = 0; i < derivatives[id].size(); i++){
+			auto parameters = p.getParameters();
+			parameters[id][i] += h;
+			NetworkPolynomial perturbed(n, parameters);
+			ASSERT_NEAR((perturbed.evaluate(evidence) - probability) / h,
+			            derivatives[id][i], 1e-6);
+		}
+	}
+}
+
+TEST_F(NetworkPolynomialTest, InconsistentEntriesHaveNoDerivative){
+	NetworkPolynomial p(c.getNetwork());
+	std::vector<int> evidence(5,-1);
+	evidence[2]=0;
+	NetworkPolynomial::Parameters derivatives;
+	p.differentiate(evidence, derivatives);
+	ASSERT_NEAR(1.0, derivatives[2][0], 0.0001);
+	ASSERT_NEAR(0.0, derivatives[2][1], 0.0001);
+}
+
+TEST_F(NetworkPolynomialTest, ParameterMismatch){
+	NetworkPolynomial::Parameters parameters(3);
+	ASSERT_THROW(NetworkPolynomial(c.getNetwork(), parameters), std::invalid_argument);
+}
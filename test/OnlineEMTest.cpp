@@ -0,0 +1,126 @@
+#include "gtest/gtest.h"
+#include "../core/DataDistribution.h"
+#include "../core/Discretiser.h"
+#include "../core/NetworkController.h"
+#include "../core/OnlineEM.h"
+#include "config.h"
+
+#include <algorithm>
+#include <numeric>
+#include <random>
+
+class OnlineEMTest : public ::testing::Test{
+	protected:
+	OnlineEMTest()
+	{
+	}
+
+	void loadData(Network& n, Matrix<int>& observations){
+		n.readNetwork(TEST_DATA_PATH("Student.na"));
+		n.readNetwork(TEST_DATA_PATH("Student.sif"));
+		Matrix<std::string> originalObservations (TEST_DATA_PATH("StudentData.txt"),false,true);
+		Discretiser disc(originalObservations,TEST_DATA_PATH("controlStudent.json"), observations, n);
+		DataDistribution db (n, observations);
+		db.assignObservationsToNodes();
+		db.distributeObservations();
+	}
+
+	// The samples in the data file are sorted, online EM needs them in random order
+	Matrix<int> shuffle(const Matrix<int>& observations){
+		std::vector<unsigned int> order(observations.getColCount());
+		std::iota(order.begin(), order.end(), 0);
+		std::mt19937 generator(0);
+		std::shuffle(order.begin(), order.end(), generator);
+		Matrix<int> shuffled(observations.getColCount(), observations.getRowCount(), -1);
+		for(unsigned int row = 0; row < observations.getRowCount(); row++) {
+			for(unsigned int col = 0; col < order.size(); col++) {
+				shuffled(col, row) = observations(order[col], row);
+			}
+		}
+		return shuffled;
+	}
+};
+
+TEST_F(OnlineEMTest, StepSize){
+	Network n;
+	Matrix<int> observations (0,0,-1);
+	loadData(n, observations);
+	EMSettings settings;
+	settings.stepSizeDecay = 0.5;
+	settings.stepSizeOffset = 4.0;
+	OnlineEM online(n, settings);
+	ASSERT_DOUBLE_EQ(0.5, online.getStepSize(0));
+	ASSERT_DOUBLE_EQ(1.0 / 3.0, online.getStepSize(5));
+
+	settings.stepSizeDecay = 1.5;
+	ASSERT_THROW(OnlineEM(n, settings), std::invalid_argument);
+	settings.stepSizeDecay = 0.7;
+	settings.stepSizeOffset = 0.5;
+	ASSERT_THROW(OnlineEM(n, settings), std::invalid_argument);
+}
+
+TEST_F(OnlineEMTest, Batches){
+	Network n;
+	Matrix<int> observations (0,0,-1);
+	loadData(n, observations);
+	Matrix<int> shuffled = shuffle(observations);
+	OnlineEM online(n);
+	for(size_t begin = 0; begin < shuffled.getColCount(); begin += 2000) {
+		online.update(shuffled, begin, begin + 2000);
+	}
+	ASSERT_EQ(50u, online.getNumberOfUpdates());
+	Node intelligence = n.getNode("Intelligence");
+	ASSERT_NEAR(0.7, intelligence.getProbability(0,0),0.02);
+	Node grade = n.getNode("Grade");
+	ASSERT_NEAR(0.3f,grade.getProbability(0,0),0.02);
+	ASSERT_NEAR(0.9f,grade.getProbability(0,1),0.02);
+	Node letter = n.getNode("Letter");
+	ASSERT_NEAR(0.1f,letter.getProbability(0,0),0.02);
+
+	ASSERT_THROW(online.update(observations, 10, 10), std::invalid_argument);
+}
+
+TEST_F(OnlineEMTest, Resume){
+	Network n1;
+	Network n2;
+	Matrix<int> observations1 (0,0,-1);
+	Matrix<int> observations2 (0,0,-1);
+	loadData(n1, observations1);
+	loadData(n2, observations2);
+
+	OnlineEM online(n1);
+	online.update(observations1, 0, 1000);
+	online.update(observations1, 1000, 2000);
+
+	NetworkPolynomial::Parameters statistics;
+	{
+		OnlineEM first(n2);
+		first.update(observations2, 0, 1000);
+		statistics = first.getStatistics();
+	}
+	OnlineEM second(n2, statistics, 1);
+	second.update(observations2, 1000, 2000);
+
+	ASSERT_EQ(online.getParameters(), second.getParameters());
+	ASSERT_EQ(2u, second.getNumberOfUpdates());
+}
+
+TEST_F(OnlineEMTest, NetworkController){
+	NetworkController c;
+	c.loadNetwork(TEST_DATA_PATH("Student.na"));
+	c.loadNetwork(TEST_DATA_PATH("Student.sif"));
+	c.loadObservations(TEST_DATA_PATH("StudentData.txt"),TEST_DATA_PATH("controlStudent.json"));
+	c.trainNetwork();
+	float before = c.getNetwork().getNode("Intelligence").getProbability(0,0);
+
+	Matrix<int> samples(100,5,0);
+	double logLikelihood = c.updateNetwork(samples);
+	ASSERT_NEAR(100 * std::log(0.01197), logLikelihood, 0.1);
+	float after = c.getNetwork().getNode("Intelligence").getProbability(0,0);
+	ASSERT_LT(before, after);
+	// The statistics of the 100000 training samples keep the first step small
+	double eta = OnlineEM(c.getNetwork()).getStepSize(100000);
+	ASSERT_NEAR(before + eta * (1.0 - before), after, 1e-5);
+	c.updateNetwork(samples);
+	ASSERT_LT(after, c.getNetwork().getNode("Intelligence").getProbability(0,0));
+}
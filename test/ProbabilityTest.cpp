@@ -191,3 +191,39 @@ TEST_F(ProbabilityTest, computeLikelihodOfTheData){
 	ASSERT_THROW(p.calculateLikelihoodOfTheData(testObservations2),std::invalid_argument);
 
 }
+
+TEST_F(ProbabilityTest, computeLogLikelihoodOfSamples){
+	Network n = c.getNetwork();
+	ProbabilityHandler p (n);
+	Matrix<int> testObservations(2,5,0);
+	std::vector<double> result = p.calculateLogLikelihoodOfSamples(testObservations);
+	ASSERT_EQ(2u, result.size());
+	ASSERT_NEAR(std::log(0.01197), result[0], 0.001);
+	ASSERT_NEAR(std::log(0.01197), result[1], 0.001);
+
+	Matrix<int> testObservations2(0,0,0);
+	ASSERT_THROW(p.calculateLogLikelihoodOfSamples(testObservations2),std::invalid_argument);
+}
+
+TEST_F(ProbabilityTest, computeLogLikelihoodOfSamplesMissingValues){
+	Network n = c.getNetwork();
+	ProbabilityHandler p (n);
+	Matrix<int> testObservations(3,5,-1);
+	testObservations(1, n.getNode(2).getObservationRow()) = 0;
+	for(unsigned int row = 0; row < 5; row++) {
+		testObservations(2, row) = 0;
+	}
+	testObservations(2, n.getNode(4).getObservationRow()) = -1;
+	std::vector<double> result = p.calculateLogLikelihoodOfSamples(testObservations);
+	ASSERT_NEAR(0.0, result[0], 0.0001);
+	ASSERT_NEAR(std::log(0.7), result[1], 0.001);
+	std::vector<int> evidence {0, 0, 0, 0, -1};
+	ASSERT_NEAR(std::log(p.computeJointProbabilityUsingVariableElimination({0, 1, 2, 3}, evidence)), result[2], 0.001);
+}
+
+TEST_F(ProbabilityTest, computeLogLikelihoodOfSamplesThreads){
+	std::vector<double> single = c.getLogLikelihoodOfSamples(1);
+	std::vector<double> multi = c.getLogLikelihoodOfSamples(4);
+	ASSERT_EQ(100000u, single.size());
+	ASSERT_EQ(single, multi);
+}
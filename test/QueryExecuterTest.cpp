@@ -156,3 +156,66 @@ TEST_F(QueryExecuterTest, QECheck21){
 	qe.setCondition(0,0);	
 	ASSERT_NEAR(0.48f, qe.execute().first, 0.001);	
 }
+
+TEST_F(QueryExecuterTest, ParameterDerivativesJoint){
+	QueryExecuter qe (c);
+	qe.setNonIntervention(1,0);
+	qe.setNonIntervention(0,0);
+	auto result = qe.computeParameterDerivatives();
+	ASSERT_NEAR(0.288f, result.first, 0.001);
+	ASSERT_EQ(5u, result.second.size());
+	// d P(g1,d0) / d P(d0) = P(g1|d0)
+	ASSERT_NEAR(0.48f, result.second[0](0,0), 0.001);
+	ASSERT_NEAR(0.0f, result.second[0](1,0), 0.001);
+	// Unobserved descendants contribute through the sum of their CPT rows
+	ASSERT_NEAR(0.288f, result.second[4](0,0), 0.001);
+	ASSERT_NEAR(0.288f, result.second[4](1,0), 0.001);
+	ASSERT_NEAR(0.0f, result.second[4](0,1), 0.001);
+}
+
+TEST_F(QueryExecuterTest, ParameterDerivativesConditional){
+	QueryExecuter qe (c);
+	qe.setNonIntervention(0,0);
+	qe.setCondition(1,0);
+	auto result = qe.computeParameterDerivatives();
+	ASSERT_NEAR(0.795f, result.first, 0.001);
+
+	Node& difficulty = c.getNetwork().getNode(0);
+	const float h = 0.001f;
+	float original = difficulty.getProbability(0,0);
+	difficulty.setProbability(original + h, 0, 0);
+	QueryExecuter perturbed (c);
+	perturbed.setNonIntervention(0,0);
+	perturbed.setCondition(1,0);
+	float shifted = perturbed.execute().first;
+	difficulty.setProbability(original, 0, 0);
+	ASSERT_NEAR((shifted - result.first) / h, result.second[0](0,0), 0.01);
+}
+
+TEST_F(QueryExecuterTest, ParameterDerivativesRevertInterventions){
+	// The first grade never leads to the first letter
+	Node& letter = c.getNetwork().getNode("Letter");
+	letter.setProbability(0.0f, 0, 0);
+	letter.setProbability(1.0f, 1, 0);
+	QueryExecuter before (c);
+	before.setNonIntervention(1,0);
+	const float grade = before.execute().first;
+	const std::vector<unsigned int> parents = c.getNetwork().getNode(1).getParents();
+
+	// The condition is impossible given the intervention
+	QueryExecuter qe (c);
+	qe.setNonIntervention(0,0);
+	qe.setDoIntervention(1,0);
+	qe.setCondition(letter.getID(),0);
+	ASSERT_THROW(qe.computeParameterDerivatives(), std::invalid_argument);
+	ASSERT_EQ(parents, c.getNetwork().getNode(1).getParents());
+	QueryExecuter after (c);
+	after.setNonIntervention(1,0);
+	ASSERT_FLOAT_EQ(grade, after.execute().first);
+}
+
+TEST_F(QueryExecuterTest, ParameterDerivativesArgMax){
+	QueryExecuter qe (c);
+	qe.setArgMax(1);
+	ASSERT_THROW(qe.computeParameterDerivatives(), std::invalid_argument);
+}
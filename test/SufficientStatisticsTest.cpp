@@ -0,0 +1,62 @@
+#include "gtest/gtest.h"
+
+#include "../core/SufficientStatistics.h"
+
+#include <stdexcept>
+
+class SufficientStatisticsTest : public ::testing::Test{
+	protected:
+	SufficientStatisticsTest()
+	: statistics_({2, 3}, {4, 3})
+	{
+
+	}
+
+	SufficientStatistics statistics_;
+};
+
+TEST_F(SufficientStatisticsTest, Layout){
+	ASSERT_EQ(2u, statistics_.getNumberOfNodes());
+	ASSERT_EQ(4u, statistics_.size(0));
+	ASSERT_EQ(3u, statistics_.size(1));
+	// The nodes are stored back to back in one buffer
+	ASSERT_EQ(statistics_.data(0) + 4, statistics_.data(1));
+	for(unsigned int id = 0; id < 2; id++){
+		for(unsigned int k = 0; k < statistics_.size(id); k++){
+			ASSERT_EQ(0.0, statistics_.data(id)[k]);
+		}
+	}
+}
+
+TEST_F(SufficientStatisticsTest, Add){
+	SufficientStatistics other({2, 3}, {4, 3});
+	for(unsigned int k = 0; k < 4; k++){
+		statistics_.data(0)[k] = k;
+		other.data(0)[k] = 0.5;
+	}
+	other.data(1)[2] = 2.25;
+	statistics_.add(other);
+	ASSERT_DOUBLE_EQ(0.5, statistics_.data(0)[0]);
+	ASSERT_DOUBLE_EQ(3.5, statistics_.data(0)[3]);
+	ASSERT_DOUBLE_EQ(2.25, statistics_.data(1)[2]);
+	statistics_.clear();
+	ASSERT_EQ(0.0, statistics_.data(0)[3]);
+	ASSERT_THROW(statistics_.add(SufficientStatistics({2}, {4})), std::invalid_argument);
+}
+
+TEST_F(SufficientStatisticsTest, Maximise){
+	statistics_.data(0)[0] = 0.25;
+	statistics_.data(0)[1] = 0.75;
+	std::vector<double> parameters {0.5, 0.5, 1.0, 0.0};
+	double difference = statistics_.maximise(0, parameters);
+	ASSERT_DOUBLE_EQ(0.25, parameters[0]);
+	ASSERT_DOUBLE_EQ(0.75, parameters[1]);
+	// Parent configurations without counts become uniform
+	ASSERT_DOUBLE_EQ(0.5, parameters[2]);
+	ASSERT_DOUBLE_EQ(0.5, parameters[3]);
+	ASSERT_DOUBLE_EQ(1.5, difference);
+}
+
+TEST_F(SufficientStatisticsTest, InvalidLayout){
+	ASSERT_THROW(SufficientStatistics({2, 3}, {4}), std::invalid_argument);
+}